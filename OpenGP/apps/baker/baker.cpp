@@ -2,6 +2,7 @@
 #include <iomanip> ///< precision
 #include <OpenGP/SurfaceMesh/SurfaceMesh.h>
 #include <OpenGP/SurfaceMesh/bounding_box.h>
+#include <OpenGP/SurfaceMesh/vertex_cache.h>
 
 #include "sort.h"
 
@@ -11,12 +12,25 @@ using namespace OpenGP;
 /// Takes a mesh and generates a source file representing that mesh
 /// Produces: vertices, normals, render indexes
 int main(int argc, char** argv){
-    if(argc!=3){
-        cout << "usage:" << endl << "baker icopill.obj icopill.h" << endl;
+    if(argc!=3 && argc!=4){
+        cout << "usage:" << endl << "baker icopill.obj icopill.h [forsyth|tipsify|none]" << endl;
         return EXIT_FAILURE;
     }
     std::string input(argv[1]);
     std::string output(argv[2]);
+
+    ///--- Triangle order for the vertex cache (default: forsyth)
+    VertexCacheOptimizer optimizer = VertexCacheOptimizer::Forsyth;
+    if(argc==4){
+        std::string name(argv[3]);
+        if(name=="forsyth") optimizer = VertexCacheOptimizer::Forsyth;
+        else if(name=="tipsify") optimizer = VertexCacheOptimizer::Tipsify;
+        else if(name=="none") optimizer = VertexCacheOptimizer::None;
+        else{
+            cout << "Unknown vertex cache optimizer " << name << endl;
+            return EXIT_FAILURE;
+        }
+    }
     
     ///--- Load mesh
     SurfaceMesh mesh;
@@ -43,6 +57,19 @@ int main(int argc, char** argv){
     for(auto f: mesh.faces())
         for(auto v: mesh.vertices(f))
             triangles.push_back(v.idx());
+
+    ///--- Reorder triangles for the vertex cache, then vertices in order of first use
+    std::vector<unsigned int> order;
+    if(optimizer!=VertexCacheOptimizer::None){
+        VertexCacheStatistics before = analyze_vertex_cache(triangles, mesh.n_vertices());
+        optimize_vertex_cache(triangles, mesh.n_vertices(), optimizer);
+        order = optimize_vertex_fetch(triangles, mesh.n_vertices());
+        VertexCacheStatistics after = analyze_vertex_cache(triangles, mesh.n_vertices());
+        cout << "ACMR " << before.acmr << " => " << after.acmr << ", ATVR " << before.atvr << " => " << after.atvr << endl;
+    }else{
+        for(auto v: mesh.vertices())
+            order.push_back(v.idx());
+    }
     
     ///--- Compute normals
     mesh.update_vertex_normals();
@@ -61,9 +88,9 @@ int main(int argc, char** argv){
         ///--- Vertex buffer
         auto vpoints = mesh.get_vertex_property<Vec3>("v:point");
         file << "const GLfloat vpoint[] = {" << endl;
-            for(auto v: mesh.vertices())
+            for(unsigned int v: order)
             {
-                Vec3 vp = vpoints[v];
+                Vec3 vp = vpoints[SurfaceMesh::Vertex(v)];
                 file << "    " << vp[0] << "," << vp[1] << "," << vp[2] << "," << endl;
             }
         file << "};" << endl;
@@ -72,8 +99,8 @@ int main(int argc, char** argv){
         ///--- Normal buffer   
         auto vnormals = mesh.get_vertex_property<Vec3>("v:normal");
         file << "const GLfloat vnormal[] = {" << endl;
-            for(auto v: mesh.vertices()){
-                Vec3 vp = vnormals[v];
+            for(unsigned int v: order){
+                Vec3 vp = vnormals[SurfaceMesh::Vertex(v)];
                 file << "    " << vp[0] << "," << vp[1] << "," << vp[2] << "," << endl;
             }
         file << "};" << endl;
@@ -81,10 +108,10 @@ int main(int argc, char** argv){
         ///--- Index buffer
         file << std::noshowpos;
         file << "const unsigned int findex[] = {" << endl;
-            for(auto f: mesh.faces()){
+            for(size_t i=0; i<triangles.size(); i+=3){
                 file << "    ";
-                for(auto v: mesh.vertices(f))
-                    file << v.idx() << ","; 
+                for(size_t j=0; j<3; j++)
+                    file << triangles[i+j] << ",";
                 file << endl;
             }
                     
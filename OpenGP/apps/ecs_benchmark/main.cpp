@@ -0,0 +1,199 @@
+#include <list>
+#include <memory>
+#include <vector>
+#include <cstdlib>
+#include <iostream>
+#include <typeindex>
+#include <unordered_map>
+
+#include <OpenGP/GL/Scene.h>
+#include <OpenGP/GL/Components/TransformComponent.h>
+#include <OpenGP/GL/Frustum.h>
+#include <OpenGP/GL/BoundingVolumeHierarchy.h>
+#include <OpenGP/GL/Eigen.h>
+#include <OpenGP/util/GenericIterable.h>
+#include <OpenGP/util/tictoc.h>
+
+using namespace std;
+using namespace OpenGP;
+
+/// Moves its entity a little every update
+class VelocityComponent : public Component {
+public:
+    Vec3 velocity = Vec3::Zero();
+    static void declare_update_access(UpdateAccess &access) {
+        access.write<TransformComponent>().instances_in_parallel();
+    }
+    void update() {
+        get<TransformComponent>().position += 0.01f * velocity;
+    }
+};
+
+/// A component only some of the entities have
+class TagComponent : public Component {
+public:
+    int tag = 0;
+};
+
+///--- The storage entities had before the component pools, as a reference
+
+struct LegacyComponent {
+    virtual ~LegacyComponent() {}
+};
+
+struct LegacyTransform : public LegacyComponent, public Transform {};
+
+struct LegacyVelocity : public LegacyComponent {
+    Vec3 velocity = Vec3::Zero();
+};
+
+struct LegacyTag : public LegacyComponent {
+    int tag = 0;
+};
+
+struct LegacyEntity {
+
+    unordered_map<type_index, unique_ptr<LegacyComponent>> components;
+
+    template <typename T>
+    T &require() {
+        auto &component = components[type_index(typeid(T))];
+        if (!component) component.reset(new T());
+        return dynamic_cast<T&>(*component);
+    }
+
+    template <typename T>
+    bool has() const {
+        return components.find(type_index(typeid(T))) != components.end();
+    }
+
+    template <typename T>
+    T &get() {
+        return dynamic_cast<T&>(*(components.at(type_index(typeid(T)))));
+    }
+
+};
+
+template <typename T>
+GenericIterable<T> legacy_all_of_type(list<LegacyEntity> &entities) {
+    auto filter_pred = [](LegacyEntity &e) { return e.has<T>(); };
+    auto map_pred = [](LegacyEntity &e) { return &(e.get<T>()); };
+    return GenericIterable<LegacyEntity>::adaptor(entities).filter(filter_pred).map(map_pred);
+}
+
+int main(int argc, char** argv) {
+
+    const int n_entities = (argc > 1) ? atoi(argv[1]) : 100000;
+    const int repetitions = 20;
+
+    cout << "--- " << n_entities << " entities, a tag on every 4th" << endl;
+
+    auto report = [&](const string &name, double ms) {
+        cout << name << ms << " ms, " << 1e6 * ms / n_entities << " ns per entity" << endl;
+    };
+
+    float checksum = 0;
+
+    {
+        list<LegacyEntity> entities;
+        tic(t);
+        for (int i = 0;i < n_entities;i++) {
+            entities.emplace_back();
+            entities.back().require<LegacyVelocity>().velocity = Vec3(1, 0, 0);
+            entities.back().require<LegacyTransform>();
+            if (i % 4 == 0) entities.back().require<LegacyTag>().tag = i;
+        }
+        report("hash map create:          ", toc(t));
+
+        tic(t_get);
+        for (int k = 0;k < repetitions;k++)
+            for (auto &entity : entities) checksum += entity.get<LegacyTransform>().position(0);
+        report("hash map get<T>:          ", toc(t_get) / repetitions);
+
+        tic(t_all);
+        for (int k = 0;k < repetitions;k++)
+            for (auto &velocity : legacy_all_of_type<LegacyVelocity>(entities)) checksum += velocity.velocity(0);
+        report("hash map all_of_type:     ", toc(t_all) / repetitions);
+
+        tic(t_sparse);
+        for (int k = 0;k < repetitions;k++)
+            for (auto &tag : legacy_all_of_type<LegacyTag>(entities)) checksum += tag.tag;
+        report("hash map all_of_type tag: ", toc(t_sparse) / repetitions);
+    }
+
+    {
+        Scene scene;
+        tic(t);
+        for (int i = 0;i < n_entities;i++) {
+            auto &velocity = scene.create_entity_with<VelocityComponent>();
+            velocity.velocity = Vec3(1, 0, 0);
+            velocity.require<TransformComponent>();
+            if (i % 4 == 0) velocity.require<TagComponent>().tag = i;
+        }
+        report("pools create:             ", toc(t));
+
+        tic(t_get);
+        for (int k = 0;k < repetitions;k++)
+            for (auto &velocity : scene.all_of_type<VelocityComponent>()) checksum += velocity.get<TransformComponent>().position(0);
+        report("pools get<T>:             ", toc(t_get) / repetitions);
+
+        tic(t_all);
+        for (int k = 0;k < repetitions;k++)
+            for (auto &velocity : scene.all_of_type<VelocityComponent>()) checksum += velocity.velocity(0);
+        report("pools all_of_type:        ", toc(t_all) / repetitions);
+
+        tic(t_sparse);
+        for (int k = 0;k < repetitions;k++)
+            for (auto &tag : scene.all_of_type<TagComponent>()) checksum += tag.tag;
+        report("pools all_of_type tag:    ", toc(t_sparse) / repetitions);
+
+        scene.set_update_threads(1);
+        tic(t_update);
+        for (int k = 0;k < repetitions;k++) scene.update();
+        report("Scene::update serial:     ", toc(t_update) / repetitions);
+
+        scene.set_update_threads(0);
+        tic(t_parallel);
+        for (int k = 0;k < repetitions;k++) scene.update();
+        report("Scene::update parallel:   ", toc(t_parallel) / repetitions);
+    }
+
+    {
+        // unit boxes spread in a cube, seen from its center by a 60 degrees frustum
+        vector<Box3> boxes;
+        srand(0);
+        for (int i = 0;i < n_entities;i++) {
+            Vec3 center = Vec3::Random() * 100;
+            boxes.push_back(Box3(center - Vec3::Ones(), center + Vec3::Ones()));
+        }
+        Frustum frustum(perspective(60, 1, 0.1f, 100) * look_at(Vec3(0, 0, 0), Vec3(0, 0, -1), Vec3(0, 1, 0)));
+
+        tic(t_each);
+        for (int k = 0;k < repetitions;k++)
+            for (auto &box : boxes) checksum += frustum.intersects(box);
+        report("cull box by box:          ", toc(t_each) / repetitions);
+
+        CullingBoxes culling_boxes;
+        for (auto &box : boxes) culling_boxes.push_back(box);
+        vector<uint8_t> visible(boxes.size());
+        tic(t_soa);
+        for (int k = 0;k < repetitions;k++) culling_boxes.cull(frustum, visible.data());
+        report("cull arrays of boxes:     ", toc(t_soa) / repetitions);
+
+        BoundingVolumeHierarchy hierarchy;
+        hierarchy.build(boxes);
+        vector<int> in_view;
+        tic(t_bvh);
+        for (int k = 0;k < repetitions;k++) {
+            in_view.clear();
+            hierarchy.query(frustum, in_view);
+        }
+        report("cull hierarchy:           ", toc(t_bvh) / repetitions);
+        checksum += in_view.size();
+    }
+
+    cout << "(checksum " << checksum << ")" << endl;
+
+    return 0;
+
+}
@@ -0,0 +1,122 @@
+#include <cmath>
+#include <vector>
+#include <cstdio>
+#include <iostream>
+
+#ifdef USE_PNG
+#include <png.h>
+#elif !defined(OPENGP_HEADERONLY)
+#include <OpenGP/external/LodePNG/lodepng.h>
+#endif
+
+#include <OpenGP/Image/PNGEncoder.h>
+#include <OpenGP/util/parallel_for.h>
+#include <OpenGP/util/tictoc.h>
+
+using namespace std;
+using namespace OpenGP;
+
+/// Smooth gradients with noisy patches, somewhere between a render and a photo
+vector<uint8_t> synthetic_rgba(int width, int height) {
+    vector<uint8_t> pixels(width * height * 4);
+    uint32_t noise = 12345;
+    for (int j = 0;j < height;j++) {
+        for (int i = 0;i < width;i++) {
+            uint8_t *p = &pixels[(j * width + i) * 4];
+            noise = noise * 1664525u + 1013904223u;
+            bool textured = ((i / 64 + j / 48) % 5) == 0;
+            int jitter = textured ? (int)(noise >> 27) : 0;
+            p[0] = (uint8_t)(128 + 100 * std::sin(i * 0.005) + jitter);
+            p[1] = (uint8_t)(128 + 100 * std::cos(j * 0.007) + jitter);
+            p[2] = (uint8_t)((i + j) / 16);
+            p[3] = 255;
+        }
+    }
+    return pixels;
+}
+
+/// Single threaded reference, the way PNGWriter wrote files before PNGEncoder
+size_t serial_write(const string &path, const vector<uint8_t> &pixels, int width, int height, int level) {
+#ifdef USE_PNG
+    FILE *fid = fopen(path.c_str(), "wb");
+    png_structp write_struct = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+    png_infop info_struct = png_create_info_struct(write_struct);
+    png_init_io(write_struct, fid);
+    png_set_compression_level(write_struct, level);
+    png_set_IHDR(write_struct, info_struct, width, height, 8, PNG_COLOR_TYPE_RGB_ALPHA, PNG_INTERLACE_NONE,
+                 PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
+    png_write_info(write_struct, info_struct);
+    vector<png_bytep> rows(height);
+    for (int j = 0;j < height;j++) rows[j] = (png_bytep)&pixels[j * width * 4];
+    png_write_image(write_struct, rows.data());
+    png_write_end(write_struct, nullptr);
+    png_destroy_write_struct(&write_struct, &info_struct);
+    long size = ftell(fid);
+    fclose(fid);
+    return (size_t)size;
+#elif !defined(OPENGP_HEADERONLY)
+    (void)level;
+    vector<unsigned char> png;
+    lodepng::encode(png, pixels, width, height);
+    lodepng::save_file(png, path);
+    return png.size();
+#else
+    // LodePNG is only compiled in the library, PNGEncoder needs libpng in header-only builds
+    (void)path; (void)pixels; (void)width; (void)height; (void)level;
+    return 0;
+#endif
+}
+
+int main(int argc, char** argv) {
+
+#if defined(OPENGP_HEADERONLY) && !defined(USE_PNG)
+    cout << "png_benchmark needs libpng in header-only builds (libpng was not found)" << endl;
+    return 1;
+#endif
+
+    int width = (argc > 1) ? atoi(argv[1]) : 3840;
+    int height = (argc > 2) ? atoi(argv[2]) : 2160;
+    int repetitions = 3;
+
+    vector<uint8_t> pixels = synthetic_rgba(width, height);
+    double megabytes = pixels.size() / 1e6;
+
+    cout << "--- " << width << "x" << height << " RGBA8, " << hardware_threads() << " hardware threads" << endl;
+
+    auto report = [&](const string &name, double ms, size_t size) {
+        cout << name << ms << " ms, " << megabytes / (ms / 1000) << " MB/s, " << size / 1024 << " KiB" << endl;
+    };
+
+    {
+        size_t size = 0;
+        tic(t);
+        for (int k = 0;k < repetitions;k++) size = serial_write("png_benchmark_serial.png", pixels, width, height, 6);
+        report("serial writer (level 6):      ", toc(t) / repetitions, size);
+    }
+
+    const PNGFilter filters[] = { PNGFilter::None, PNGFilter::Up, PNGFilter::Paeth, PNGFilter::Adaptive };
+    const char *filter_names[] = { "none", "up", "paeth", "adaptive" };
+
+    vector<int> thread_counts = { 1 };
+    if (hardware_threads() > 1) thread_counts.push_back(hardware_threads());
+
+    for (int level : { 1, 6, 9 }) {
+        for (int f = 0;f < 4;f++) {
+            for (int n_threads : thread_counts) {
+                PNGEncoder encoder;
+                encoder.compression_level = level;
+                encoder.filter = filters[f];
+                encoder.n_threads = n_threads;
+                vector<uint8_t> png;
+                tic(t);
+                for (int k = 0;k < repetitions;k++) encoder.encode(pixels.data(), width * 4, width, height, 4, 8, png);
+                char name[64];
+                snprintf(name, sizeof(name), "PNGEncoder level %d %-8s %2dT: ", level, filter_names[f], n_threads);
+                report(name, toc(t) / repetitions, png.size());
+            }
+        }
+    }
+
+    return 0;
+
+}
@@ -0,0 +1,129 @@
+#include <cmath>
+#include <vector>
+#include <iostream>
+
+#include <OpenGP/RGBD/DepthUnprojector.h>
+#include <OpenGP/RGBD/DepthMesher.h>
+#include <OpenGP/RGBD/DepthRegistration.h>
+#include <OpenGP/util/tictoc.h>
+
+using namespace std;
+using namespace OpenGP;
+
+/// Wavy surface with holes, roughly what a sensor sees of a cluttered room
+vector<uint16_t> synthetic_depth(int width, int height) {
+    vector<uint16_t> depth(width * height);
+    for (int j = 0;j < height;j++) {
+        for (int i = 0;i < width;i++) {
+            bool hole = ((i / 37 + j / 29) % 7) == 0;
+            depth[j * width + i] = hole ? 0 : (uint16_t)(1500 + 300 * std::sin(i * 0.01) + 400 * std::cos(j * 0.013));
+        }
+    }
+    return depth;
+}
+
+/// Per-pixel StreamIntrinsics::unproject and normals, as done before DepthUnprojector
+void scalar_unproject(const vector<uint16_t> &depth, const StreamIntrinsics &K, float depth_scale, vector<Vec3> &points, vector<Vec3> &normals) {
+    points.resize(depth.size());
+    normals.resize(depth.size());
+    for (int j = 0;j < K.height;j++) {
+        for (int i = 0;i < K.width;i++) {
+            Scalar d = depth[j * K.width + i] * depth_scale;
+            points[j * K.width + i] = (d >= 0.1f && d <= 4.0f) ? K.unproject(i, j, d) : Vec3::Constant(nan());
+        }
+    }
+    for (int j = 0;j < K.height;j++) {
+        for (int i = 0;i < K.width;i++) {
+            Vec3 &n = normals[j * K.width + i];
+            n = Vec3::Constant(nan());
+            if (i == K.width - 1 || j == K.height - 1) continue;
+            const Vec3 &p = points[j * K.width + i];
+            n = (points[(j + 1) * K.width + i] - p).cross(points[j * K.width + i + 1] - p).normalized();
+        }
+    }
+}
+
+// usage: rgbd_benchmark [repetitions]
+int main(int argc, char** argv) {
+
+    int repetitions = (argc > 1) ? atoi(argv[1]) : 50;
+    const float depth_scale = 0.001f;
+
+    int resolutions[2][2] = { { 640, 480 }, { 1280, 720 } };
+
+    for (auto &resolution : resolutions) {
+
+        StreamIntrinsics K;
+        K.width = resolution[0];
+        K.height = resolution[1];
+        K.pixel_center = Vec2(K.width / 2 - 0.5f, K.height / 2 - 0.5f);
+        K.focal_length = Vec2(0.8f * K.width, 0.8f * K.width);
+
+        vector<uint16_t> depth = synthetic_depth(K.width, K.height);
+        cout << "--- " << K.width << "x" << K.height << " (" << repetitions << " frames)" << endl;
+
+        vector<Vec3> points, normals;
+        {
+            tic(t);
+            for (int r = 0;r < repetitions;r++) scalar_unproject(depth, K, depth_scale, points, normals);
+            cout << "scalar points+normals:     " << toc(t) / repetitions << " ms/frame" << endl;
+        }
+
+        DepthUnprojector unprojector(K);
+        PointMap map;
+        {
+            tic(t);
+            for (int r = 0;r < repetitions;r++) unprojector.unproject(depth.data(), depth_scale, map, false);
+            cout << "DepthUnprojector points:   " << toc(t) / repetitions << " ms/frame" << endl;
+        }
+        {
+            tic(t);
+            for (int r = 0;r < repetitions;r++) unprojector.unproject(depth.data(), depth_scale, map);
+            cout << "DepthUnprojector +normals: " << toc(t) / repetitions << " ms/frame" << endl;
+        }
+        {
+            Mat3xN cloud;
+            tic(t);
+            for (int r = 0;r < repetitions;r++) map.valid_points(cloud);
+            cout << "PointMap::valid_points:    " << toc(t) / repetitions << " ms/frame (" << cloud.cols() << " points)" << endl;
+        }
+
+        DepthMesher mesher(K);
+        for (bool decimate : { false, true }) {
+            mesher.decimate = decimate;
+            mesher.triangulate(depth.data(), depth_scale);
+            tic(t);
+            for (int r = 0;r < repetitions;r++) mesher.triangulate(depth.data(), depth_scale);
+            cout << (decimate ? "DepthMesher decimated:     " : "DepthMesher:               ") << toc(t) / repetitions << " ms/frame ("
+                 << mesher.get_triangles().size() / 3 << " triangles)" << endl;
+        }
+        {
+            SurfaceMesh mesh;
+            tic(t);
+            mesher.triangulate(depth.data(), depth_scale, mesh);
+            cout << "DepthMesher to SurfaceMesh: " << toc(t) << " ms/frame" << endl;
+        }
+
+        // color camera of the same resolution, 2.5 cm to the side
+        StreamExtrinsics depth_pose = { Vec3::Zero(), Mat3x3::Identity() };
+        StreamExtrinsics color_pose = { Vec3(0.025f, 0, 0), Mat3x3::Identity() };
+        DepthRegistration registration;
+        registration.set_calibration(K, depth_pose, K, color_pose);
+        {
+            vector<uint16_t> aligned(K.width * K.height);
+            registration.align_depth_to_color(depth.data(), depth_scale, aligned.data());
+            tic(t);
+            for (int r = 0;r < repetitions;r++) registration.align_depth_to_color(depth.data(), depth_scale, aligned.data());
+            cout << "DepthRegistration d->c:    " << toc(t) / repetitions << " ms/frame" << endl;
+        }
+        {
+            vector<uint8_t> color(3 * K.width * K.height, 128), aligned(3 * K.width * K.height);
+            tic(t);
+            for (int r = 0;r < repetitions;r++) registration.align_color_to_depth(depth.data(), depth_scale, color.data(), 3, aligned.data());
+            cout << "DepthRegistration c->d:    " << toc(t) / repetitions << " ms/frame" << endl;
+        }
+
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -89,6 +89,14 @@ public:
         color->attach_depth_texture(depthmap->get_depth_texture());
     }
 
+    /// @brief Renders the scene through its camera, exclusive: drawing writes the culling and
+    /// batching state of the camera and the bounds of the renderables, and sends `GUIRenderEvent`
+    /// to any listener
+    static void declare_update_access(UpdateAccess &access) {
+        access.exclusive = true;
+        access.uses_gl = true;
+    }
+
     void update() {
 
         auto &transform = get<TransformComponent>();
@@ -152,12 +160,12 @@ public:
         streams.emplace(
             std::piecewise_construct,
             std::forward_as_tuple("COLOR"),
-            std::forward_as_tuple("COLOR", &color_data, color_intrinsics, color_extrinsics, framerate)
+            std::forward_as_tuple("COLOR", &color_data, color_intrinsics, color_extrinsics, framerate, StreamFormat::RGB8)
         );
         streams.emplace(
             std::piecewise_construct,
             std::forward_as_tuple("DEPTH"),
-            std::forward_as_tuple("DEPTH", &depth_data, depth_intrinsics, depth_extrinsics, framerate)
+            std::forward_as_tuple("DEPTH", &depth_data, depth_intrinsics, depth_extrinsics, framerate, StreamFormat::Z16)
         );
 
         return SensorDevice(depth_scale, streams, [this](bool block){
@@ -0,0 +1,102 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <algorithm>
+
+#include "BoundingVolumeHierarchy.h"
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+void BoundingVolumeHierarchy::build(const std::vector<Box3> &boxes) {
+
+    this->boxes = boxes;
+
+    const int n = (int)boxes.size();
+    order.resize(n);
+    for (int i = 0;i < n;i++) {
+        order[i] = i;
+    }
+
+    nodes.clear();
+    nodes.reserve(2 * (n / leaf_size + 1));
+    if (n > 0) build_node(0, n);
+
+}
+
+int BoundingVolumeHierarchy::build_node(int first, int count) {
+
+    int index = (int)nodes.size();
+    nodes.push_back(Node());
+
+    Box3 box, centers;
+    for (int i = first;i < first + count;i++) {
+        box.extend(boxes[order[i]]);
+        centers.extend(boxes[order[i]].center());
+    }
+
+    nodes[index].box = box;
+    nodes[index].first = first;
+    nodes[index].count = count;
+    nodes[index].right = -1;
+
+    if (count <= leaf_size) return index;
+
+    int axis;
+    centers.sizes().maxCoeff(&axis);
+
+    int half = count / 2;
+    std::nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count, [&](int a, int b) {
+        return boxes[a].center()(axis) < boxes[b].center()(axis);
+    });
+
+    // the left child is the next node; `nodes` may grow, so no references are kept
+    build_node(first, half);
+    int right = build_node(first + half, count - half);
+    nodes[index].right = right;
+
+    return index;
+
+}
+
+void BoundingVolumeHierarchy::query(const Frustum &frustum, std::vector<int> &visible) const {
+
+    if (nodes.empty()) return;
+
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top > 0) {
+
+        const Node &node = nodes[stack[--top]];
+
+        if (!frustum.intersects(node.box)) continue;
+
+        if (frustum.contains(node.box)) {
+            visible.insert(visible.end(), order.begin() + node.first, order.begin() + node.first + node.count);
+            continue;
+        }
+
+        if (node.right < 0) {
+            for (int i = node.first;i < node.first + node.count;i++) {
+                if (frustum.intersects(boxes[order[i]])) visible.push_back(order[i]);
+            }
+            continue;
+        }
+
+        // median splits keep the depth logarithmic, far below the stack size
+        int left = (int)(&node - nodes.data()) + 1;
+        stack[top++] = node.right;
+        stack[top++] = left;
+
+    }
+
+}
+
+//=============================================================================
+} // OpenGP::
+//=============================================================================
@@ -0,0 +1,75 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <vector>
+
+#include <OpenGP/headeronly.h>
+#include <OpenGP/types.h>
+#include <OpenGP/GL/Frustum.h>
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+/// @brief Binary tree of bounding boxes over boxes that do not move, to find those in a frustum
+/// without testing all of them: subtrees outside are skipped, subtrees inside taken whole
+/// @note Built top down by median splits along the longest axis of the box centers.
+class BoundingVolumeHierarchy {
+private:
+
+    /// The boxes `order[first, first + count)`, split in the next node and the node `right`
+    /// (-1 for leaves)
+    struct Node {
+        Box3 box;
+        int first;
+        int count;
+        int right;
+    };
+
+    std::vector<Node> nodes; ///< depth first, the root first
+    std::vector<int> order;  ///< box indices, those of every node contiguous
+    std::vector<Box3> boxes;
+
+    /// Boxes per leaf at most
+    static constexpr int leaf_size = 4;
+
+    /// Build the subtree of `order[first, first + count)`, returns its node
+    HEADERONLY_INLINE int build_node(int first, int count);
+
+public:
+
+    BoundingVolumeHierarchy() {}
+
+    /// Rebuild the tree over `boxes`, none of which may be empty (unknown bounds)
+    HEADERONLY_INLINE void build(const std::vector<Box3> &boxes);
+
+    void clear() {
+        nodes.clear();
+        order.clear();
+        boxes.clear();
+    }
+
+    bool empty() const {
+        return boxes.empty();
+    }
+
+    size_t size() const {
+        return boxes.size();
+    }
+
+    /// Append to `visible` the indices of the boxes that intersect `frustum`, as `Frustum::intersects`
+    HEADERONLY_INLINE void query(const Frustum &frustum, std::vector<int> &visible) const;
+
+};
+
+//=============================================================================
+} // OpenGP::
+//=============================================================================
+
+#ifdef HEADERONLY
+    #include "BoundingVolumeHierarchy.cpp"
+#endif
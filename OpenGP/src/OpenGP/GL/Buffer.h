@@ -7,6 +7,10 @@
 #include <OpenGP/GL/gl_types.h>
 #include <OpenGP/util/math_types.h>
 #include <vector>
+#include <cstring>
+#include <cstdint>
+#include <cassert>
+#include <algorithm>
 
 //=============================================================================
 namespace OpenGP {
@@ -58,6 +62,9 @@ public:
     virtual GLenum get_data_type() const = 0;
     virtual GLuint get_components() const = 0;
 
+    /// Byte offset of the current elements in the buffer (attribute pointers must follow it)
+    virtual GLintptr get_offset() const { return 0; }
+
     /// @note use the other upload functions whenever possible
     void upload_raw_block(const GLvoid* raw_data_ptr, GLsizeiptr block_size, GLenum usage=GL_STATIC_DRAW){
         num_elems = block_size / elem_size();
@@ -90,12 +97,177 @@ public:
         glBufferData(TARGET, this->num_elems * sizeof(T), raw_data_ptr, usage);
     }
 
+    /// Allocate storage for `num_elems` elements without initializing them
+    void allocate(GLsizeiptr num_elems, GLenum usage=GL_STATIC_DRAW){
+        upload_raw(nullptr, num_elems, usage);
+    }
+
+    /// @brief Overwrite the elements [first, first + count) of the uploaded ones
+    /// @note Rewriting all elements orphans the storage first, so the driver does not
+    /// wait for draws still reading the previous contents.
+    void update_raw(const GLvoid* raw_data_ptr, GLsizeiptr first, GLsizeiptr count, GLenum usage=GL_STATIC_DRAW){
+        assert(first >= 0 && first + count <= this->num_elems);
+        if (count <= 0) return;
+        glBindBuffer(TARGET, this->buffer);
+        if (first == 0 && count == this->num_elems)
+            glBufferData(TARGET, this->num_elems * sizeof(T), nullptr, usage);
+        glBufferSubData(TARGET, first * sizeof(T), count * sizeof(T), raw_data_ptr);
+    }
+
     GLsizeiptr elem_size() const { return sizeof(T); }
     GLenum get_data_type() const { return GLType<Scalar>(); }
     GLuint get_components() const { return ScalarComponents<T>(); }
 
 };
 
+/// @brief Array buffer for attributes rewritten every frame, cycling through a ring of regions
+/// @note Each upload goes to the next region, which the GPU finished reading (a fence is
+/// placed when moving on from a region). With GL 4.4 or ARB_buffer_storage the buffer stays
+/// persistently mapped, otherwise regions are mapped unsynchronized. Since the region moves,
+/// attribute pointers must be set again after each upload (`Shader::set_attribute` follows
+/// `get_offset`).
+template <class T>
+class StreamingArrayBuffer : public VectorBuffer<GL_ARRAY_BUFFER> {
+private:
+
+    using Scalar = UnderlyingScalar<T>;
+
+    const int n_regions;
+    const bool allow_persistent;
+
+    GLsizeiptr capacity = 0; ///< elements per region
+    int region = 0;
+    uint8_t *mapped = nullptr; ///< persistent mapping of the whole ring, if any
+    std::vector<GLsync> fences;
+
+    void release_storage() {
+        for (GLsync &fence : fences) {
+            if (fence) glDeleteSync(fence);
+            fence = nullptr;
+        }
+        if (mapped) {
+            glBindBuffer(GL_ARRAY_BUFFER, this->buffer);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+            mapped = nullptr;
+        }
+    }
+
+    /// Storage for `n_regions` regions of at least `num_elems` elements
+    void reserve(GLsizeiptr num_elems) {
+
+        if (num_elems <= capacity) return;
+
+        // immutable storage cannot grow, so a new buffer replaces it (draws in flight keep the old one)
+        release_storage();
+        glDeleteBuffers(1, &this->buffer);
+        glGenBuffers(1, &this->buffer);
+
+        capacity = std::max(num_elems, 2 * capacity);
+        GLsizeiptr bytes = n_regions * capacity * sizeof(T);
+        glBindBuffer(GL_ARRAY_BUFFER, this->buffer);
+
+        if (allow_persistent && GLEW_ARB_buffer_storage) {
+            const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_ARRAY_BUFFER, bytes, nullptr, flags);
+            mapped = (uint8_t*)glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes, flags);
+        } else {
+            glBufferData(GL_ARRAY_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+        }
+
+        region = n_regions - 1;
+
+    }
+
+public:
+
+    /// @param n_regions regions in the ring, i.e. frames the GPU may lag behind without stalling
+    /// @param allow_persistent use a persistent mapping when the context supports it
+    explicit StreamingArrayBuffer(int n_regions = 3, bool allow_persistent = true) :
+        n_regions(std::max(n_regions, 2)), allow_persistent(allow_persistent), fences(this->n_regions, nullptr) {}
+
+    StreamingArrayBuffer(const StreamingArrayBuffer&) = delete;
+    StreamingArrayBuffer &operator=(const StreamingArrayBuffer&) = delete;
+
+    ~StreamingArrayBuffer() { release_storage(); }
+
+    /// Write `num_elems` elements to the next region, which becomes the current one
+    void upload_raw(const GLvoid* raw_data_ptr, GLsizeiptr num_elems){
+
+        reserve(num_elems);
+
+        // the draws issued since the last upload read the current region
+        if (fences[region]) glDeleteSync(fences[region]);
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+        region = (region + 1) % n_regions;
+        if (fences[region]) {
+            while (glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {}
+            glDeleteSync(fences[region]);
+            fences[region] = nullptr;
+        }
+
+        this->num_elems = num_elems;
+        const GLsizeiptr bytes = num_elems * sizeof(T);
+        if (bytes == 0) return;
+
+        if (mapped) {
+            std::memcpy(mapped + get_offset(), raw_data_ptr, bytes);
+        } else {
+            glBindBuffer(GL_ARRAY_BUFFER, this->buffer);
+            const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+            void *target = glMapBufferRange(GL_ARRAY_BUFFER, get_offset(), bytes, flags);
+            std::memcpy(target, raw_data_ptr, bytes);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        }
+
+    }
+
+    void upload(const std::vector<T>& data){
+        upload_raw(data.data(), data.size());
+    }
+
+    /// The storage is persistently mapped
+    bool is_persistent() const { return mapped != nullptr; }
+
+    GLintptr get_offset() const { return region * capacity * sizeof(T); }
+
+    GLsizeiptr elem_size() const { return sizeof(T); }
+    GLenum get_data_type() const { return GLType<Scalar>(); }
+    GLuint get_components() const { return ScalarComponents<T>(); }
+
+};
+
+/// @brief Uniform buffer holding one `T`, laid out by the caller to match a std140 block
+/// @note Bind it to the binding point the programs attach their block to (see
+/// `Shader::bind_uniform_block`), so that one upload serves every program.
+template <class T>
+class UniformBuffer : public GenericBuffer<GL_UNIFORM_BUFFER> {
+private:
+
+    bool allocated = false;
+
+public:
+
+    UniformBuffer() = default;
+
+    UniformBuffer(const UniformBuffer&) = delete;
+    UniformBuffer &operator=(const UniformBuffer&) = delete;
+
+    /// Replace the contents, the storage is only allocated by the first upload
+    void upload(const T& block, GLenum usage=GL_DYNAMIC_DRAW){
+        glBindBuffer(GL_UNIFORM_BUFFER, this->buffer);
+        if (allocated) {
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &block);
+        } else {
+            glBufferData(GL_UNIFORM_BUFFER, sizeof(T), &block, usage);
+            allocated = true;
+        }
+    }
+
+    void bind_base(GLuint binding) { glBindBufferBase(GL_UNIFORM_BUFFER, binding, this->buffer); }
+
+};
+
 ///--- Specializations
 
 using GenericArrayBuffer = GenericBuffer<GL_ARRAY_BUFFER>;
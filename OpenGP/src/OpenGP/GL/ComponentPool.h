@@ -0,0 +1,235 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <new>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <atomic>
+#include <limits>
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+/// Small consecutive indices of the component types, assigned on first use
+class ComponentType {
+private:
+
+    /// Atomic, since a type may be used for the first time in a parallel update
+    static size_t next() {
+        static std::atomic<size_t> counter(0);
+        return counter++;
+    }
+
+public:
+
+    template <typename T>
+    static size_t id() {
+        static const size_t value = next();
+        return value;
+    }
+
+};
+
+/// @brief Stable reference to a component of type `T`: its index in the pool of its scene
+/// @note Resolve it with `Scene::get`
+template <typename T>
+struct ComponentHandle {
+
+    static constexpr uint32_t invalid = std::numeric_limits<uint32_t>::max();
+
+    uint32_t index = invalid;
+
+    bool is_valid() const { return index != invalid; }
+
+    bool operator==(const ComponentHandle &rhs) const { return index == rhs.index; }
+    bool operator!=(const ComponentHandle &rhs) const { return index != rhs.index; }
+
+};
+
+/// @brief What the `update()` of a component type touches, which decides what `Scene::update()`
+/// may run concurrently. Component types declare it in a static member:
+///
+///     static void declare_update_access(UpdateAccess &access) {
+///         access.read<CameraComponent>().write<TransformComponent>().instances_in_parallel();
+///     }
+///
+/// @note Types that do not declare it are `exclusive`: their update runs alone, on the thread
+/// that owns the GL context, in the order of a serial update. Only exclusive updates may create
+/// entities or components.
+struct UpdateAccess {
+
+    std::vector<size_t> reads;  ///< `ComponentType::id` of the types read
+    std::vector<size_t> writes; ///< `ComponentType::id` of the types written, including its own
+
+    bool exclusive = false;     ///< may touch anything
+    bool uses_gl = false;       ///< runs on the thread that owns the GL context
+    bool parallel_instances = false; ///< instances only touch their own entity, so can update concurrently
+
+    template <typename T>
+    UpdateAccess &read() { reads.push_back(ComponentType::id<T>()); return *this; }
+
+    template <typename T>
+    UpdateAccess &write() { writes.push_back(ComponentType::id<T>()); return *this; }
+
+    UpdateAccess &gl() { uses_gl = true; return *this; }
+
+    UpdateAccess &instances_in_parallel() { parallel_instances = true; return *this; }
+
+    /// Whether running both updates concurrently could race or change the result
+    bool conflicts_with(const UpdateAccess &other) const {
+        if (exclusive || other.exclusive) return true;
+        auto intersects = [](const std::vector<size_t> &a, const std::vector<size_t> &b) {
+            for (size_t x : a) {
+                if (std::find(b.begin(), b.end(), x) != b.end()) return true;
+            }
+            return false;
+        };
+        return intersects(writes, other.writes) || intersects(writes, other.reads) || intersects(reads, other.writes);
+    }
+
+};
+
+/// Type erased base of `ComponentPool`, owned by the scene
+class ComponentPoolBase {
+protected:
+
+    UpdateAccess access;
+
+    bool updates = false; ///< the type overrides `Component::update`
+
+public:
+
+    virtual ~ComponentPoolBase() {}
+
+    const UpdateAccess &get_update_access() const { return access; }
+
+    bool has_update() const { return updates; }
+
+    virtual size_t count() const = 0;
+
+    /// Call `update()` on the components [`begin`, `end`)
+    virtual void update(size_t begin, size_t end) = 0;
+
+};
+
+/// @brief Storage of all the components of type `T` of a scene, in creation order
+/// @note Components live in fixed size chunks that are never moved, so references and
+/// pointers to them stay valid; iterating the pool scans the chunks linearly.
+template <typename T>
+class ComponentPool : public ComponentPoolBase {
+private:
+
+    static constexpr size_t chunk_bits = 8;
+    static constexpr size_t chunk_size = size_t(1) << chunk_bits;
+
+    using Storage = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+    std::vector<std::unique_ptr<Storage[]>> chunks;
+
+    size_t n_components = 0;
+
+public:
+
+    template <typename Pool, typename Value>
+    class Iterator {
+    private:
+
+        Pool *pool;
+        size_t index;
+
+    public:
+
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = typename std::remove_const<Value>::type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = Value*;
+        using reference = Value&;
+
+        Iterator(Pool *pool, size_t index) : pool(pool), index(index) {}
+
+        Value &operator*() const { return (*pool)[index]; }
+        Value *operator->() const { return &(*pool)[index]; }
+
+        Iterator &operator++() { index++; return *this; }
+        Iterator operator++(int) { Iterator it = *this; index++; return it; }
+
+        bool operator==(const Iterator &rhs) const { return index == rhs.index; }
+        bool operator!=(const Iterator &rhs) const { return index != rhs.index; }
+
+    };
+
+    using iterator = Iterator<ComponentPool, T>;
+    using const_iterator = Iterator<const ComponentPool, const T>;
+
+    ComponentPool() {
+        // `Component` declares exclusive access, which types without a declaration inherit
+        T::declare_update_access(access);
+        access.write<T>();
+        updates = !std::is_same<decltype(&T::update), decltype(&T::Component::update)>::value;
+    }
+
+    ComponentPool(const ComponentPool&) = delete;
+    ComponentPool &operator=(const ComponentPool&) = delete;
+
+    ~ComponentPool() {
+        // the newest first, the reverse of construction
+        for (size_t i = n_components;i > 0;i--) {
+            (*this)[i - 1].~T();
+        }
+    }
+
+    /// Default construct a new component at the end of the pool
+    T *create() {
+        if (n_components == chunks.size() * chunk_size) {
+            chunks.emplace_back(new Storage[chunk_size]);
+        }
+        T *component = new (&chunks[n_components >> chunk_bits][n_components & (chunk_size - 1)]) T();
+        n_components++;
+        return component;
+    }
+
+    size_t size() const { return n_components; }
+
+    size_t count() const { return size(); }
+
+    void update(size_t begin, size_t end) {
+        for (size_t i = begin;i < end;i++) {
+            (*this)[i].T::update(); // the exact type is known, no virtual call
+        }
+    }
+
+    bool empty() const { return n_components == 0; }
+
+    T &operator[](size_t i) {
+        return *reinterpret_cast<T*>(&chunks[i >> chunk_bits][i & (chunk_size - 1)]);
+    }
+
+    const T &operator[](size_t i) const {
+        return *reinterpret_cast<const T*>(&chunks[i >> chunk_bits][i & (chunk_size - 1)]);
+    }
+
+    T &get(ComponentHandle<T> handle) { return (*this)[handle.index]; }
+    const T &get(ComponentHandle<T> handle) const { return (*this)[handle.index]; }
+
+    /// Components created while iterating are not visited
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, n_components); }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, n_components); }
+
+};
+
+//=============================================================================
+} // OpenGP::
+//=============================================================================
@@ -4,11 +4,21 @@
 
 #pragma once
 
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+
+#include <Eigen/StdVector>
+
 #include <OpenGP/GL/Scene.h>
 #include <OpenGP/GL/Entity.h>
 #include <OpenGP/GL/Components/WorldRenderComponent.h>
 #include <OpenGP/GL/Components/TransformComponent.h>
 #include <OpenGP/GL/MaterialRenderer.h>
+#include <OpenGP/GL/Frustum.h>
+#include <OpenGP/GL/BoundingVolumeHierarchy.h>
 #include <OpenGP/GL/Window.h>
 #include <OpenGP/MLogger.h>
 
@@ -20,12 +30,161 @@ namespace OpenGP {
 /// An event indicating that any canvases should draw their UI elements
 struct GUIRenderEvent {};
 
+/// Renderables of the last frame drawn by a camera, and the draws they took
+struct CullingStatistics {
+    size_t submitted = 0;  ///< drawn
+    size_t culled = 0;     ///< skipped as outside the view (not counting those not `visible`)
+    size_t draw_calls = 0; ///< `render` and `render_instanced` calls, a batch counting once
+};
+
 /// A component representing a camera in the scene
 class CameraComponent : public Component, public EventProvider {
 private:
 
     Window *window = nullptr;
 
+    /// Camera and light data shared by all the draws of a frame (created with the first frame)
+    std::unique_ptr<UniformBuffer<FrameUniforms>> frame_uniforms;
+
+    CullingStatistics statistics;
+
+    /// Per renderable (in pool order), whether it is drawn this frame
+    std::vector<uint8_t> drawn;
+
+    // renderables tested one by one, by pool index
+    CullingBoxes dynamic_boxes;
+    std::vector<size_t> dynamic_renderables;
+    std::vector<uint8_t> dynamic_visible;
+
+    // static renderables with known bounds, by pool index, culled through the hierarchy
+    BoundingVolumeHierarchy static_hierarchy;
+    std::vector<size_t> static_renderables;
+    std::vector<int> static_visible;
+    bool static_hierarchy_valid = false;
+
+    // drawn renderables that can be batched, by pool index, and the model matrices of a batch
+    std::vector<std::pair<InstanceBatchKey, size_t>> batched;
+    std::vector<Mat4x4, Eigen::aligned_allocator<Mat4x4>> instance_models;
+
+    void render(RenderContext &context, WorldRenderComponent &renderable) {
+
+        auto &transform = renderable.get<TransformComponent>();
+
+        context.translation = transform.position;
+        context.scale = transform.scale;
+        context.rotation = transform.rotation;
+
+        context.update_model(transform.world_matrix());
+
+        renderable.get_renderer().render(context);
+        statistics.draw_calls++;
+
+    }
+
+    /// Draw the renderables in `batched` with one `render_instanced` per key, and clear it
+    void render_batches(RenderContext &context) {
+
+        auto &renderables = get_scene().get_pool<WorldRenderComponent>();
+
+        // equal keys next to each other, each batch in pool order
+        std::stable_sort(batched.begin(), batched.end(), [](const std::pair<InstanceBatchKey, size_t> &a, const std::pair<InstanceBatchKey, size_t> &b) {
+            return a.first < b.first;
+        });
+
+        for (size_t first = 0, last = 0;first < batched.size();first = last) {
+
+            last = first + 1;
+            while (last < batched.size() && batched[last].first == batched[first].first)
+                last++;
+
+            auto &leader = renderables[batched[first].second];
+            if (last - first == 1) {
+                render(context, leader);
+                continue;
+            }
+
+            instance_models.clear();
+            for (size_t j = first;j < last;j++) {
+                instance_models.push_back(renderables[batched[j].second].get<TransformComponent>().world_matrix());
+            }
+
+            leader.get_renderer().render_instanced(context, instance_models.data(), instance_models.size());
+            statistics.draw_calls++;
+
+        }
+
+        batched.clear();
+
+    }
+
+    /// Fill `drawn` for the renderables of the scene seen through `view_projection`
+    void cull(const Mat4x4 &view_projection) {
+
+        auto &pool = get_scene().get_pool<WorldRenderComponent>();
+        const size_t n = pool.size();
+
+        drawn.assign(n, 0);
+
+        if (!frustum_culling) {
+            for (size_t i = 0;i < n;i++) drawn[i] = pool[i].visible;
+            return;
+        }
+
+        dynamic_boxes.clear();
+        dynamic_renderables.clear();
+
+        // the static set is compared in passing to the one the hierarchy was built over
+        size_t n_static = 0;
+        bool static_changed = !static_hierarchy_valid;
+
+        for (size_t i = 0;i < n;i++) {
+            auto &renderable = pool[i];
+            if (!renderable.visible) continue;
+            const Box3 &bounds = renderable.get_world_bounds();
+            if (renderable.is_static && !bounds.isEmpty()) {
+                static_changed = static_changed || n_static >= static_renderables.size() || static_renderables[n_static] != i;
+                n_static++;
+                continue;
+            }
+            dynamic_boxes.push_back(bounds);
+            dynamic_renderables.push_back(i);
+        }
+        static_changed = static_changed || n_static != static_renderables.size();
+
+        Frustum frustum(view_projection);
+
+        dynamic_visible.resize(dynamic_renderables.size());
+        dynamic_boxes.cull(frustum, dynamic_visible.data());
+        for (size_t j = 0;j < dynamic_renderables.size();j++) {
+            drawn[dynamic_renderables[j]] = dynamic_visible[j];
+        }
+
+        if (static_changed) {
+            static_renderables.clear();
+            std::vector<Box3> boxes;
+            for (size_t i = 0;i < n;i++) {
+                auto &renderable = pool[i];
+                if (!renderable.visible || !renderable.is_static) continue;
+                const Box3 &bounds = renderable.get_world_bounds();
+                if (bounds.isEmpty()) continue;
+                static_renderables.push_back(i);
+                boxes.push_back(bounds);
+            }
+            static_hierarchy.build(boxes);
+            static_hierarchy_valid = true;
+        }
+
+        static_visible.clear();
+        static_hierarchy.query(frustum, static_visible);
+        for (int j : static_visible) {
+            drawn[static_renderables[j]] = 1;
+        }
+
+        statistics.culled = dynamic_renderables.size() + static_renderables.size() - static_visible.size();
+        for (uint8_t visible : dynamic_visible) statistics.culled -= visible;
+
+    }
+
 public:
 
     /// The distance from the eye to the near clipping plane
@@ -37,6 +196,18 @@ public:
     /// The vertical field-of-view of the camera in degrees
     float vfov = 60;
 
+    /// The color of the directional light, which shines along the view direction
+    Vec3 light_color = Vec3(1, 1, 1);
+
+    /// Skip the renderables whose world bounds are outside the view
+    bool frustum_culling = true;
+
+    /// @brief Draw renderables of equal `InstanceBatchKey`s (copies of a mesh) together, with
+    /// one `render_instanced` per batch
+    /// @note Renderables that cannot be batched keep their place in pool order, batches are
+    /// drawn before the next of them.
+    bool instanced_batching = true;
+
     CameraComponent() {}
 
     void init() {
@@ -104,31 +275,63 @@ public:
         context.forward = get<TransformComponent>().forward();
         context.up = get<TransformComponent>().up();
 
+        context.light_color = light_color;
+
         context.update_view();
         context.update_projection();
 
-        for (auto &renderable : get_scene().all_of_type<WorldRenderComponent>()) {
+        if (!frame_uniforms)
+            frame_uniforms.reset(new UniformBuffer<FrameUniforms>());
+        context.upload_frame_uniforms(*frame_uniforms);
 
-            if (!renderable.visible)
-                continue;
+        statistics = CullingStatistics();
+        cull(context.VP);
 
-            auto &transform = renderable.get<TransformComponent>();
+        auto &renderables = get_scene().get_pool<WorldRenderComponent>();
 
-            context.translation = transform.position;
-            context.scale = transform.scale;
-            context.rotation = transform.rotation;
+        batched.clear();
+        for (size_t i = 0;i < drawn.size();i++) {
 
-            context.update_model();
+            if (!drawn[i])
+                continue;
 
-            renderable.get_renderer().render(context);
+            auto &renderable = renderables[i];
+            statistics.submitted++;
+
+            if (instanced_batching) {
+                InstanceBatchKey key = renderable.get_renderer().get_instance_batch_key();
+                if (key.geometry != nullptr) {
+                    batched.emplace_back(key, i);
+                    continue;
+                }
+            }
+
+            // the pending batches are drawn first, so that the order of the draws only changes
+            // among the batched ones (all depth tested)
+            render_batches(context);
+            render(context, renderable);
         }
 
+        render_batches(context);
+
         GUIRenderEvent event;
 
         send_event(event);
 
     }
 
+    /// Renderables drawn and culled by the last `draw`
+    const CullingStatistics &get_culling_statistics() const {
+        return statistics;
+    }
+
+    /// @brief Rebuild the hierarchy of the static renderables with the next `draw`, after some of
+    /// them moved or their bounds changed
+    /// @note Adding, removing (setting `is_static`) or hiding static renderables is noticed.
+    void invalidate_static_hierarchy() {
+        static_hierarchy_valid = false;
+    }
+
     /// Get the attached window assuming it exists
     Window &get_window() {
         return *window;
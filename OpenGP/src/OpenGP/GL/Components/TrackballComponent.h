@@ -35,6 +35,11 @@ public:
     /// Multiplier for zooming scroll input
     float scroll_sensitivity = -0.1;
 
+    /// Moves its own transform from the window input, which other threads may read
+    static void declare_update_access(UpdateAccess &access) {
+        access.read<CameraComponent>().write<TransformComponent>().instances_in_parallel();
+    }
+
     void init() {
         require<CameraComponent>();
 
@@ -0,0 +1,194 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <cstring>
+#include <algorithm>
+
+#include <OpenGP/GL/Scene.h>
+#include <OpenGP/MLogger.h>
+
+#include "TransformComponent.h"
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+namespace {
+
+    void get_local_state(const Transform &transform, float *values) {
+        std::memcpy(values, transform.position.data(), 3 * sizeof(float));
+        std::memcpy(values + 3, transform.scale.data(), 3 * sizeof(float));
+        std::memcpy(values + 6, transform.rotation.coeffs().data(), 4 * sizeof(float));
+    }
+
+}
+
+void TransformHierarchy::add(TransformComponent *node) {
+
+    /// @note A new node has no parent, so appending it keeps the order
+
+    node->hierarchy = this;
+    node->slot = (int)nodes.size();
+
+    nodes.push_back(node);
+    parents.push_back(-1);
+    changed.push_back(0);
+    world_passes.push_back(pass);
+
+    LocalState state;
+    get_local_state(*node, state.values);
+    states.push_back(state);
+
+    local_matrices.push_back(node->get_transformation_matrix());
+    world_matrices.push_back(local_matrices.back());
+
+}
+
+void TransformHierarchy::remove(TransformComponent *node) {
+
+    nodes[node->slot] = nullptr;
+    topology_changed = true;
+
+}
+
+void TransformHierarchy::sort() {
+
+    // breadth first from the roots: every node comes after its parent
+    std::vector<TransformComponent*> sorted;
+    sorted.reserve(nodes.size());
+    for (auto node : nodes) {
+        if (node != nullptr && node->parent == nullptr) {
+            sorted.push_back(node);
+        }
+    }
+    for (size_t i = 0;i < sorted.size();i++) {
+        for (auto child : sorted[i]->children) {
+            sorted.push_back(child);
+        }
+    }
+
+    nodes.swap(sorted);
+
+    const size_t n = nodes.size();
+    for (size_t i = 0;i < n;i++) {
+        nodes[i]->slot = (int)i;
+    }
+
+    parents.resize(n);
+    for (size_t i = 0;i < n;i++) {
+        parents[i] = (nodes[i]->parent == nullptr) ? -1 : nodes[i]->parent->slot;
+    }
+
+    // cached matrices moved around, all of them are rebuilt by the next pass
+    LocalState invalid;
+    std::memset(invalid.values, 0xff, sizeof(invalid.values));
+    states.assign(n, invalid);
+    changed.assign(n, 0);
+    world_passes.resize(n);
+    local_matrices.resize(n);
+    world_matrices.resize(n);
+
+    topology_changed = false;
+
+}
+
+void TransformHierarchy::update() {
+
+    if (topology_changed) {
+        sort();
+    }
+
+    pass++;
+
+    const size_t n = nodes.size();
+
+    for (size_t i = 0;i < n;i++) {
+
+        LocalState state;
+        get_local_state(*nodes[i], state.values);
+
+        bool local_changed = std::memcmp(state.values, states[i].values, sizeof(state.values)) != 0;
+        if (local_changed) {
+            states[i] = state;
+            local_matrices[i] = nodes[i]->get_transformation_matrix();
+        }
+
+        // the parent was handled earlier in this pass
+        int parent = parents[i];
+        bool world_changed = local_changed || (parent >= 0 && changed[parent]);
+        if (world_changed) {
+            if (parent < 0) {
+                world_matrices[i] = local_matrices[i];
+            } else {
+                world_matrices[i].noalias() = world_matrices[parent] * local_matrices[i];
+            }
+            world_passes[i] = pass;
+        }
+        changed[i] = world_changed;
+
+    }
+
+}
+
+TransformComponent::~TransformComponent() {
+
+    set_parent(nullptr);
+
+    for (auto child : children) {
+        child->parent = nullptr;
+    }
+
+    if (hierarchy != nullptr) {
+        if (!children.empty()) {
+            hierarchy->topology_changed = true;
+        }
+        hierarchy->remove(this);
+    }
+
+}
+
+void TransformComponent::init() {
+
+    get_scene().get_transform_hierarchy().add(this);
+
+}
+
+void TransformComponent::set_parent(TransformComponent *parent) {
+
+    if (parent == this->parent) {
+        return;
+    }
+
+    if (parent != nullptr) {
+        if (parent->hierarchy != hierarchy) {
+            mFatal() << "Transform parent is in another scene";
+        }
+        for (auto ancestor = parent;ancestor != nullptr;ancestor = ancestor->parent) {
+            if (ancestor == this) {
+                mFatal() << "Transform parent is one of its descendants";
+            }
+        }
+    }
+
+    if (this->parent != nullptr) {
+        auto &siblings = this->parent->children;
+        siblings.erase(std::find(siblings.begin(), siblings.end(), this));
+    }
+
+    this->parent = parent;
+
+    if (parent != nullptr) {
+        parent->children.push_back(this);
+    }
+
+    if (hierarchy != nullptr) {
+        hierarchy->topology_changed = true;
+    }
+
+}
+
+//=============================================================================
+} // OpenGP::
+//=============================================================================
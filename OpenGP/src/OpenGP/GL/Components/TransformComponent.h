@@ -6,33 +6,71 @@
 
 #include <vector>
 
+#include <OpenGP/headeronly.h>
 #include <OpenGP/util/Transform.h>
-#include <OpenGP/util/GenericIterable.h>
+#include <OpenGP/util/Range.h>
 #include <OpenGP/GL/Entity.h>
+#include <OpenGP/GL/TransformHierarchy.h>
 
 
 //=============================================================================
 namespace OpenGP {
 //=============================================================================
 
-/// A component representing the position, orientation and scale of an entity
+/// @brief A component representing the position, orientation and scale of an entity
+/// @note The local and world matrices are cached by the scene, and refreshed by `Scene::update()`.
 class TransformComponent : public Transform, public Component {
+
+    friend class TransformHierarchy;
+
 private:
 
     TransformComponent *parent = nullptr;
 
     std::vector<TransformComponent*> children;
 
+    TransformHierarchy *hierarchy = nullptr;
+
+    int slot = -1; ///< index in the hierarchy
+
 public:
 
-    Mat4x4 world_matrix() const {
+    TransformComponent() {}
+
+    HEADERONLY_INLINE ~TransformComponent();
+
+    HEADERONLY_INLINE void init();
+
+    /// The transformation to the parent space, as of the last `Scene::update()` (for updates
+    /// using GL, as of their start)
+    const Mat4x4 &local_matrix() const {
+        return hierarchy->local_matrices[slot];
+    }
+
+    /// The transformation to world space, as of the last `Scene::update()` (for updates using
+    /// GL, as of their start)
+    const Mat4x4 &world_matrix() const {
+        return hierarchy->world_matrices[slot];
+    }
+
+    /// @brief Changes whenever `world_matrix()` does, to validate what was derived from it
+    /// (e.g. world bounds)
+    uint32_t world_version() const {
+        return hierarchy->world_passes[slot];
+    }
+
+    /// The transformation to world space of the current positions, rotations and scales (not cached)
+    Mat4x4 compute_world_matrix() const {
         if (parent == nullptr) {
             return get_transformation_matrix();
         }
-        auto base = parent->world_matrix();
-        return base * get_transformation_matrix();
+        return parent->compute_world_matrix() * get_transformation_matrix();
     }
 
+    /// @brief Attach to `parent` (nullptr detaches), which must be in the same scene
+    /// @note The world matrices follow from the next `Scene::update()`
+    HEADERONLY_INLINE void set_parent(TransformComponent *parent);
+
     TransformComponent *get_parent() {
         return parent;
     }
@@ -41,22 +79,23 @@ public:
         return parent;
     }
 
-    GenericIterable<TransformComponent> get_children() {
+    /// Map function of the ranges of children, `T` is the (const) component type
+    template <typename T>
+    struct ChildPointer {
+        T *operator()(TransformComponent *child) const {
+            return child;
+        }
+    };
 
-        auto map_pred = [](TransformComponent *tc) {
-            return tc;
-        };
+    using ChildRange = Range<MapIterator<std::vector<TransformComponent*>::iterator, ChildPointer<TransformComponent>>>;
+    using ConstChildRange = Range<MapIterator<std::vector<TransformComponent*>::const_iterator, ChildPointer<const TransformComponent>>>;
 
-        return GenericIterable<TransformComponent*>::adaptor(children).map(map_pred);
+    ChildRange get_children() {
+        return make_range(children).map(ChildPointer<TransformComponent>());
     }
 
-    GenericIterable<const TransformComponent> get_children() const {
-
-        auto map_pred = [](TransformComponent *tc) -> const TransformComponent* {
-            return tc;
-        };
-
-        return GenericIterable<TransformComponent *const>::adaptor(children).map(map_pred);
+    ConstChildRange get_children() const {
+        return make_range(children).map(ChildPointer<const TransformComponent>());
     }
 
 };
@@ -64,3 +103,7 @@ public:
 //=============================================================================
 } // OpenGP::
 //=============================================================================
+
+#ifdef HEADERONLY
+    #include "TransformComponent.cpp"
+#endif
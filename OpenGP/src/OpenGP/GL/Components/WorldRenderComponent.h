@@ -4,8 +4,12 @@
 
 #pragma once
 
+#include <limits>
+#include <cstdint>
+
 #include <OpenGP/GL/Entity.h>
 #include <OpenGP/GL/MaterialRenderer.h>
+#include <OpenGP/GL/Frustum.h>
 #include <OpenGP/GL/Components/TransformComponent.h>
 
 
@@ -19,11 +23,21 @@ private:
 
     std::unique_ptr<MaterialRenderer> renderer;
 
+    // world bounds, and what they were computed from
+    Box3 world_bounds;
+    Box3 local_bounds;
+    uint32_t world_version = std::numeric_limits<uint32_t>::max();
+
 public:
 
     /// Should the object be rendered
     bool visible = true;
 
+    /// @brief The object never moves (nor its renderer bounds change), so cameras may cull it
+    /// through a bounding volume hierarchy instead of testing it every frame
+    /// @note See `CameraComponent::invalidate_static_hierarchy`
+    bool is_static = false;
+
     void init() {
         require<TransformComponent>();
     }
@@ -44,6 +58,20 @@ public:
         return *dynamic_cast<T*>(renderer.get());
     }
 
+    /// @brief Bounds in world space of what the renderer draws, as of the last `Scene::update()`,
+    /// empty if unknown (then never culled)
+    /// @note Cached, recomputed when the world matrix or the renderer bounds change.
+    const Box3 &get_world_bounds() {
+        Box3 bounds = renderer ? renderer->get_bounding_box() : Box3();
+        auto &transform = get<TransformComponent>();
+        if (transform.world_version() != world_version || bounds.min() != local_bounds.min() || bounds.max() != local_bounds.max()) {
+            world_version = transform.world_version();
+            local_bounds = bounds;
+            world_bounds = transform_box(transform.world_matrix(), bounds);
+        }
+        return world_bounds;
+    }
+
 };
 
 //=============================================================================
@@ -74,6 +74,8 @@ DepthSurfaceRenderer::DepthSurfaceRenderer() { rebuild(); }
 void DepthSurfaceRenderer::rebuild_mesh() {
 	std::vector<Vec3> vposition;
 	std::vector<unsigned int> triangles;
+	vposition.reserve(width * height);
+	triangles.reserve(6 * (width - 1) * (height - 1));
 
 	GLuint n = 0;
 	for (GLuint i = 0; i < width; i++) {
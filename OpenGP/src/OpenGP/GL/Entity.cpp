@@ -11,9 +11,9 @@ namespace OpenGP {
 
 void Entity::update() {
 
-    for (auto &pair : components) {
+    for (auto component : update_order) {
 
-        pair.second->update();
+        component->update();
 
     }
 
@@ -4,12 +4,12 @@
 
 #pragma once
 
-#include <unordered_map>
-#include <memory>
-#include <typeindex>
+#include <vector>
 #include <cassert>
+#include <stdexcept>
 
 #include <OpenGP/headeronly.h>
+#include <OpenGP/GL/ComponentPool.h>
 
 
 //=============================================================================
@@ -29,6 +29,8 @@ private:
     Entity *entity = nullptr;
     Scene *scene = nullptr;
 
+    uint32_t pool_index = 0; ///< index in the pool of its type
+
 protected:
 
     Component() {}
@@ -45,6 +47,13 @@ public:
     /// Overridable method that handles per-frame updates
     virtual void update() {}
 
+    /// @brief What the `update()` of the derived type touches, see `UpdateAccess`
+    /// @note Derived types hide this conservative default: an exclusive update with GL access
+    static void declare_update_access(UpdateAccess &access) {
+        access.exclusive = true;
+        access.uses_gl = true;
+    }
+
     /// Get a reference to the entity that holds this component
     Entity &get_entity() { assert(entity != nullptr); return *entity; }
     /// Get a reference to the entity that holds this component
@@ -73,7 +82,8 @@ public:
 
 };
 
-/// A basic container for components that describes one node in the scene graph
+/// @brief A basic container for components that describes one node in the scene graph
+/// @note The components are owned by the component pools of the scene
 class Entity {
 
     friend class Scene;
@@ -82,7 +92,17 @@ private:
 
     Scene *scene = nullptr;
 
-    std::unordered_map<std::type_index, std::unique_ptr<Component>> components;
+    /// Components indexed by `ComponentType::id`, nullptr where the entity has none
+    std::vector<Component*> components;
+
+    /// Components in the order they were added, which is the update order
+    std::vector<Component*> update_order;
+
+    template <typename T>
+    T *find() const {
+        size_t id = ComponentType::id<T>();
+        return (id < components.size()) ? static_cast<T*>(components[id]) : nullptr;
+    }
 
 public:
 
@@ -96,38 +116,36 @@ public:
 
     /// Add the specified component to this entity if it does not already exist
     template <typename T>
-    T &require() {
-        assert(scene != nullptr);
-
-        if (has<T>())
-            return get<T>();
-
-        T *component = new T();
-        components[std::type_index(typeid(T))] = std::unique_ptr<Component>(component);
-
-        component->entity = this;
-        component->scene = scene;
-        component->init();
-
-        return *component;
-    }
+    T &require();
 
     /// Check if this entity has the specified component
     template <typename T>
     bool has() const {
-        return components.find(std::type_index(typeid(T))) != components.end();
+        return find<T>() != nullptr;
     }
 
     /// Get a reference to the specified component in this entity
     template <typename T>
     const T &get() const {
-        return dynamic_cast<const T&>(*(components.at(std::type_index(typeid(T)))));
+        const T *component = find<T>();
+        if (component == nullptr) throw std::out_of_range("Entity::get: no such component");
+        return *component;
     }
 
     /// Get a reference to the specified component in this entity
     template <typename T>
     T &get() {
-        return dynamic_cast<T&>(*(components.at(std::type_index(typeid(T)))));
+        T *component = find<T>();
+        if (component == nullptr) throw std::out_of_range("Entity::get: no such component");
+        return *component;
+    }
+
+    /// Stable handle to the specified component in this entity, see `Scene::get`
+    template <typename T>
+    ComponentHandle<T> get_handle() const {
+        ComponentHandle<T> handle;
+        handle.index = get<T>().pool_index;
+        return handle;
     }
 
     /// Get a reference to the scene that contains this entity
@@ -151,6 +169,9 @@ const T &Component::get() const { return get_entity().get<T>(); }
 } // OpenGP::
 //=============================================================================
 
+// Entity::require allocates from the pools of the scene
+#include <OpenGP/GL/Scene.h>
+
 #ifdef HEADERONLY
     #include "Entity.cpp"
 #endif
@@ -0,0 +1,137 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include "Frustum.h"
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+namespace {
+
+    /// Signed distance (scaled by the plane normal length) of the farthest corner of the box
+    /// (center, extent) along the plane normal
+    float max_distance(const float *plane, const Vec3 &center, const Vec3 &extent) {
+        return plane[0] * center(0) + plane[1] * center(1) + plane[2] * center(2) + plane[3] +
+               std::abs(plane[0]) * extent(0) + std::abs(plane[1]) * extent(1) + std::abs(plane[2]) * extent(2);
+    }
+
+    /// Same for the nearest corner
+    float min_distance(const float *plane, const Vec3 &center, const Vec3 &extent) {
+        return plane[0] * center(0) + plane[1] * center(1) + plane[2] * center(2) + plane[3] -
+               std::abs(plane[0]) * extent(0) - std::abs(plane[1]) * extent(1) - std::abs(plane[2]) * extent(2);
+    }
+
+}
+
+Frustum::Frustum(const Mat4x4 &view_projection) {
+
+    // Gribb and Hartmann: the clip space conditions -w <= x <= w, ... as combinations of rows
+    for (int k = 0;k < 3;k++) {
+        for (int j = 0;j < 4;j++) {
+            planes[2 * k][j] = view_projection(3, j) + view_projection(k, j);
+            planes[2 * k + 1][j] = view_projection(3, j) - view_projection(k, j);
+        }
+    }
+
+}
+
+bool Frustum::intersects(const Box3 &box) const {
+
+    if (box.isEmpty()) return true;
+
+    Vec3 center = box.center();
+    Vec3 extent = 0.5f * box.sizes();
+    for (int k = 0;k < 6;k++) {
+        if (max_distance(planes[k], center, extent) < 0) return false;
+    }
+    return true;
+
+}
+
+bool Frustum::contains(const Box3 &box) const {
+
+    if (box.isEmpty()) return false;
+
+    Vec3 center = box.center();
+    Vec3 extent = 0.5f * box.sizes();
+    for (int k = 0;k < 6;k++) {
+        if (min_distance(planes[k], center, extent) < 0) return false;
+    }
+    return true;
+
+}
+
+Box3 transform_box(const Mat4x4 &transformation, const Box3 &box) {
+
+    if (box.isEmpty()) return box;
+
+    // Arvo: the center is transformed, the extent by the absolute values of the linear part
+    Vec3 center = transformation.block<3, 3>(0, 0) * box.center() + transformation.block<3, 1>(0, 3);
+    Vec3 extent = transformation.block<3, 3>(0, 0).cwiseAbs() * (0.5f * box.sizes());
+
+    return Box3(center - extent, center + extent);
+
+}
+
+void CullingBoxes::push_back(const Box3 &box) {
+
+    if (box.isEmpty()) {
+        // as large as can be without overflowing to nan in `cull`
+        for (int k = 0;k < 3;k++) {
+            center[k].push_back(0);
+            extent[k].push_back(std::numeric_limits<float>::max());
+        }
+        return;
+    }
+
+    Vec3 c = box.center();
+    Vec3 e = 0.5f * box.sizes();
+    for (int k = 0;k < 3;k++) {
+        center[k].push_back(c(k));
+        extent[k].push_back(e(k));
+    }
+
+}
+
+void CullingBoxes::cull(const Frustum &frustum, uint8_t *visible) const {
+
+    // the planes in locals, with the absolute values of the normals precomputed, so that
+    // the loop below only streams the box arrays and vectorizes over boxes
+    float a[6], b[6], c[6], d[6], abs_a[6], abs_b[6], abs_c[6];
+    for (int k = 0;k < 6;k++) {
+        a[k] = frustum.planes[k][0];
+        b[k] = frustum.planes[k][1];
+        c[k] = frustum.planes[k][2];
+        d[k] = frustum.planes[k][3];
+        abs_a[k] = std::abs(a[k]);
+        abs_b[k] = std::abs(b[k]);
+        abs_c[k] = std::abs(c[k]);
+    }
+
+    const float *cx = center[0].data(), *cy = center[1].data(), *cz = center[2].data();
+    const float *ex = extent[0].data(), *ey = extent[1].data(), *ez = extent[2].data();
+
+    const size_t n = size();
+    for (size_t i = 0;i < n;i++) {
+        // the smallest over the planes of the distance of the farthest corner, no branches
+        float distance = std::numeric_limits<float>::max();
+        for (int k = 0;k < 6;k++) {
+            float farthest = a[k] * cx[i] + b[k] * cy[i] + c[k] * cz[i] + d[k] +
+                             abs_a[k] * ex[i] + abs_b[k] * ey[i] + abs_c[k] * ez[i];
+            distance = std::min(distance, farthest);
+        }
+        visible[i] = (distance >= 0) ? 1 : 0;
+    }
+
+}
+
+//=============================================================================
+} // OpenGP::
+//=============================================================================
@@ -0,0 +1,81 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include <OpenGP/headeronly.h>
+#include <OpenGP/types.h>
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+/// The volume seen through a view-projection matrix, as the six planes bounding it
+class Frustum {
+public:
+
+    /// Planes (a, b, c, d), a point is inside when a*x + b*y + c*z + d >= 0 for all of them.
+    /// In order: left, right, bottom, top, near and far.
+    float planes[6][4];
+
+    Frustum() {}
+
+    /// The frustum of `view_projection` (OpenGL clip space, -w <= x, y, z <= w)
+    HEADERONLY_INLINE explicit Frustum(const Mat4x4 &view_projection);
+
+    /// @brief Whether `box` may be visible: false only if it is entirely outside a plane
+    /// @note Conservative, boxes near the corners can pass while outside. Empty boxes
+    /// (unknown bounds) always intersect.
+    HEADERONLY_INLINE bool intersects(const Box3 &box) const;
+
+    /// Whether `box` is entirely inside
+    HEADERONLY_INLINE bool contains(const Box3 &box) const;
+
+};
+
+/// @brief The axis aligned box containing `box` transformed by the affine `transformation`
+/// @note Empty boxes stay empty.
+HEADERONLY_INLINE Box3 transform_box(const Mat4x4 &transformation, const Box3 &box);
+
+/// @brief Boxes stored as arrays of centers and half extents, so that testing all of them
+/// against a frustum is one loop the compiler vectorizes
+class CullingBoxes {
+private:
+
+    std::vector<float> center[3];
+    std::vector<float> extent[3];
+
+public:
+
+    void clear() {
+        for (int k = 0;k < 3;k++) {
+            center[k].clear();
+            extent[k].clear();
+        }
+    }
+
+    size_t size() const {
+        return center[0].size();
+    }
+
+    /// Append `box`, an empty one (unknown bounds) is always visible
+    HEADERONLY_INLINE void push_back(const Box3 &box);
+
+    /// visible[i] = whether box i intersects `frustum`, as `Frustum::intersects`
+    HEADERONLY_INLINE void cull(const Frustum &frustum, uint8_t *visible) const;
+
+};
+
+//=============================================================================
+} // OpenGP::
+//=============================================================================
+
+#ifdef HEADERONLY
+    #include "Frustum.cpp"
+#endif
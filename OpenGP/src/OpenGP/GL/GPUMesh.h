@@ -7,14 +7,21 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
 #include <unordered_map>
 
 #include <OpenGP/GL/gl.h>
+#include <OpenGP/MLogger.h>
 #include <OpenGP/GL/Shader.h>
 #include <OpenGP/GL/Buffer.h>
 #include <OpenGP/GL/VertexArrayObject.h>
 
 #include <OpenGP/SurfaceMesh/SurfaceMesh.h>
+#include <OpenGP/SurfaceMesh/vertex_cache.h>
 
 //=============================================================================
 namespace OpenGP {
@@ -23,17 +30,133 @@ namespace OpenGP {
 class GPUMesh {
 private:
 
+    struct Attribute {
+        std::unique_ptr<VectorArrayBuffer> buffer;
+        GLuint divisor = 0;
+        GLsizeiptr dirty_begin = 0, dirty_end = 0; ///< elements to upload again, empty when clean
+    };
+
     VertexArrayObject vao;
 
-    // (attribute name) -> (buffer object, attribute divisor)
-    std::unordered_map<std::string, std::pair<std::unique_ptr<VectorArrayBuffer>, GLuint>> vbos;
+    // (attribute name) -> (buffer object, attribute divisor, dirty range)
+    std::unordered_map<std::string, Attribute> vbos;
 
-    ElementArrayBuffer<unsigned int> triangles;
+    std::unique_ptr<VectorElementArrayBuffer> triangles; ///< 16 or 32 bit indices
 
     int element_count = 0;
 
+    // vertices packed by init_from_mesh<Layout>, and how the layout points shaders into them
+    std::unique_ptr<GenericArrayBuffer> interleaved;
+    std::function<void(Shader&)> set_interleaved_attributes;
+    std::function<void(const SurfaceMesh&)> pack_interleaved;
+
     GLenum mode = GL_TRIANGLES;
 
+    // element counts of the mesh the indices were generated from
+    size_t mesh_vertices = 0;
+    size_t mesh_faces = 0;
+
+    VertexCacheOptimizer vertex_cache_optimizer = VertexCacheOptimizer::None;
+    std::vector<unsigned int> vertex_order; ///< buffer vertex i is mesh vertex vertex_order[i] (empty: same order)
+
+    Box3 bounds; ///< of the uploaded "vposition", empty if unknown
+
+    /// Grow (or with `reset`, replace) the bounds by the uploaded positions of attribute `name`
+    template <typename T>
+    void track_bounds(const std::string &name, const void *data, GLsizeiptr num_elems, bool reset) {
+        if (!std::is_same<T, Vec3>::value || name != "vposition") return;
+        if (reset) bounds.setEmpty();
+        const Vec3 *points = (const Vec3*)data;
+        for (GLsizeiptr i = 0;i < num_elems;i++) {
+            bounds.extend(points[i]);
+        }
+    }
+
+    /// Buffer of attribute `name` holding `T`s, replacing one of another kind
+    template <typename T>
+    ArrayBuffer<T> &get_vbo(const std::string &name) {
+        auto &attribute = vbos[name];
+        auto *buffer = dynamic_cast<ArrayBuffer<T>*>(attribute.buffer.get());
+        if (buffer == nullptr) {
+            buffer = new ArrayBuffer<T>();
+            attribute.buffer = std::unique_ptr<VectorArrayBuffer>(buffer);
+        }
+        return *buffer;
+    }
+
+    /// Storage for `num_elems` elements of attribute `name`, left as is if it has that size
+    template <typename T>
+    void allocate_vbo(const std::string &name, GLsizeiptr num_elems) {
+        auto &buffer = get_vbo<T>(name);
+        if (buffer.size() == num_elems) return;
+        vao.bind();
+        buffer.allocate(num_elems);
+        vao.unbind();
+    }
+
+    /// Upload the dirty range of attribute `name` from the full array `data`
+    template <typename T>
+    void upload_dirty(const std::string &name, const void *data) {
+        auto it = vbos.find(name);
+        if (it == vbos.end() || it->second.dirty_begin >= it->second.dirty_end) return;
+        auto &attribute = it->second;
+        if (!vertex_order.empty()) {
+            // reordered vertices are scattered, the attribute is uploaded as a whole
+            auto reordered = reorder_vertices((const T*)data, vertex_order);
+            update_vbo_raw<T>(name, reordered.data(), 0, reordered.size());
+            return;
+        }
+        GLsizeiptr end = std::min(attribute.dirty_end, attribute.buffer->size());
+        update_vbo_raw<T>(name, (const T*)data + attribute.dirty_begin, attribute.dirty_begin, end - attribute.dirty_begin);
+    }
+
+    /// Upload a mesh vertex attribute, in the buffer vertex order
+    template <typename T>
+    void set_mesh_vbo(const std::string &name, const T *data, size_t num_elems) {
+        if (vertex_order.empty())
+            set_vbo_raw<T>(name, data, num_elems);
+        else
+            set_vbo<T>(name, reorder_vertices(data, vertex_order));
+    }
+
+    template <typename Index>
+    void upload_indices(const std::vector<Index> &indices) {
+        auto *buffer = dynamic_cast<ElementArrayBuffer<Index>*>(triangles.get());
+        if (buffer == nullptr) {
+            buffer = new ElementArrayBuffer<Index>();
+            triangles = std::unique_ptr<VectorElementArrayBuffer>(buffer);
+        }
+        vao.bind();
+        buffer->upload(indices);
+        vao.unbind();
+        element_count = indices.size();
+    }
+
+    /// Triangle indices of `mesh`, optimized for the vertex cache if enabled (which sets `vertex_order`)
+    std::vector<unsigned int> mesh_indices(const SurfaceMesh &mesh) {
+        std::vector<unsigned int> indices;
+        indices.reserve(3 * mesh.n_faces());
+        for(auto f: mesh.faces()) {
+            for(auto v: mesh.vertices(f)) {
+                indices.push_back(v.idx());
+            }
+        }
+        vertex_order.clear();
+        if (vertex_cache_optimizer != VertexCacheOptimizer::None) {
+            optimize_vertex_cache(indices, mesh.n_vertices(), vertex_cache_optimizer);
+            vertex_order = optimize_vertex_fetch(indices, mesh.n_vertices());
+        }
+        return indices;
+    }
+
+    /// Upload mesh indices, as 16 bit ones when allowed and there are fewer than 65536 vertices
+    void upload_mesh_indices(const std::vector<unsigned int> &indices, bool short_indices) {
+        if (short_indices && mesh_vertices < 65536)
+            upload_indices(std::vector<uint16_t>(indices.begin(), indices.end()));
+        else
+            upload_indices(indices);
+    }
+
 public:
 
     GPUMesh() {};
@@ -48,68 +171,223 @@ public:
 
     void init_from_mesh(const SurfaceMesh &mesh) {
 
+        mesh_vertices = mesh.n_vertices();
+        mesh_faces = mesh.n_faces();
+
+        interleaved.reset();
+        set_interleaved_attributes = nullptr;
+        pack_interleaved = nullptr;
+
+        // first, as it decides the vertex order
+        auto indices = mesh_indices(mesh);
+
         auto vpoints = mesh.get_vertex_property<Vec3>("v:point");
-        set_vbo_raw<Vec3>("vposition", vpoints.data(), mesh.n_vertices());
+        set_mesh_vbo<Vec3>("vposition", vpoints.data(), mesh.n_vertices());
 
+        // missing attributes only get (uninitialized) storage
         auto vnormals = mesh.get_vertex_property<Vec3>("v:normal");
         if (vnormals) {
-            set_vbo_raw<Vec3>("vnormal", vnormals.data(), mesh.n_vertices());
+            set_mesh_vbo<Vec3>("vnormal", vnormals.data(), mesh.n_vertices());
         } else {
-            void *uninitialized_data = malloc(mesh.n_vertices() * sizeof(Vec3));
-            set_vbo_raw<Vec3>("vnormal", uninitialized_data, mesh.n_vertices());
-            free(uninitialized_data);
+            allocate_vbo<Vec3>("vnormal", mesh.n_vertices());
         }
 
         auto vcolor = mesh.get_vertex_property<Vec3>("v:color");
         if (vcolor) {
-            set_vbo_raw<Vec3>("vcolor", vcolor.data(), mesh.n_vertices());
+            set_mesh_vbo<Vec3>("vcolor", vcolor.data(), mesh.n_vertices());
         }
 
         // TODO: read texture coordinates
-        {
-            void *uninitialized_data = malloc(mesh.n_vertices() * sizeof(Vec2));
-            set_vbo_raw<Vec2>("vtexcoord", uninitialized_data, mesh.n_vertices());
-            free(uninitialized_data);
+        allocate_vbo<Vec2>("vtexcoord", mesh.n_vertices());
+
+        upload_mesh_indices(indices, false);
+
+        mode = GL_TRIANGLES;
+
+    }
+
+    /// @brief Upload the mesh as interleaved vertices packed by `Layout` (see VertexLayout.h),
+    /// with 16 bit indices when there are fewer than 65536 vertices
+    /// @note The layout replaces the per-attribute buffers of the mesh attributes.
+    template <class Layout>
+    void init_from_mesh(const SurfaceMesh &mesh) {
+
+        mesh_vertices = mesh.n_vertices();
+        mesh_faces = mesh.n_faces();
+
+        for (const char *name : { "vposition", "vnormal", "vcolor", "vtexcoord" }) {
+            vbos.erase(name);
         }
 
-        element_count = 0;
-        std::vector<unsigned int> triangles;
-        for(auto f: mesh.faces()) {
-            for(auto v: mesh.vertices(f)) {
-                element_count++;
-                triangles.push_back(v.idx());
+        if (!interleaved)
+            interleaved = std::unique_ptr<GenericArrayBuffer>(new GenericArrayBuffer());
+
+        pack_interleaved = [this](const SurfaceMesh &mesh) {
+            auto vpoints = mesh.get_vertex_property<Vec3>("v:point");
+            track_bounds<Vec3>("vposition", vpoints.data(), mesh.n_vertices(), true);
+            std::vector<uint8_t> vertices;
+            Layout::pack(mesh, vertices);
+            if (!vertex_order.empty()) {
+                std::vector<uint8_t> reordered(vertices.size());
+                for (size_t i = 0;i < vertex_order.size();i++) {
+                    std::memcpy(&reordered[i * Layout::stride], &vertices[vertex_order[i] * Layout::stride], Layout::stride);
+                }
+                vertices.swap(reordered);
+            }
+            vao.bind();
+            interleaved->upload_raw_block(vertices.data(), vertices.size());
+            vao.unbind();
+        };
+        set_interleaved_attributes = [this](Shader &shader) {
+            Layout::set_attributes(shader, *interleaved);
+        };
+
+        auto indices = mesh_indices(mesh);
+        pack_interleaved(mesh);
+        upload_mesh_indices(indices, true);
+
+        mode = GL_TRIANGLES;
+
+    }
+
+    /// @brief Upload the dirty ranges of the mesh attributes (positions, normals and colors)
+    /// @note The connectivity is assumed unchanged and the indices are kept, unless the
+    /// vertex or face count changed, in which case everything is uploaded again.
+    /// Interleaved vertices are packed and uploaded as a whole.
+    void update_from_mesh(const SurfaceMesh &mesh) {
+
+        if (mesh.n_vertices() != mesh_vertices || mesh.n_faces() != mesh_faces) {
+            if (pack_interleaved) {
+                mesh_vertices = mesh.n_vertices();
+                mesh_faces = mesh.n_faces();
+                auto indices = mesh_indices(mesh);
+                pack_interleaved(mesh);
+                upload_mesh_indices(indices, true);
+            } else {
+                init_from_mesh(mesh);
             }
+            return;
         }
 
-        vao.bind();
-        this->triangles.upload(triangles);
-        vao.unbind();
+        if (pack_interleaved) {
+            pack_interleaved(mesh);
+        }
 
-        mode = GL_TRIANGLES;
+        upload_dirty<Vec3>("vposition", mesh.get_vertex_property<Vec3>("v:point").data());
+
+        auto vnormals = mesh.get_vertex_property<Vec3>("v:normal");
+        if (vnormals) upload_dirty<Vec3>("vnormal", vnormals.data());
+
+        auto vcolor = mesh.get_vertex_property<Vec3>("v:color");
+        if (vcolor) upload_dirty<Vec3>("vcolor", vcolor.data());
 
     }
 
+    /// Mark the elements [first, first + count) of attribute `name` (all to the end if `count` < 0) for `update_from_mesh`
+    void mark_dirty(const std::string &name, GLsizeiptr first = 0, GLsizeiptr count = -1) {
+        auto it = vbos.find(name);
+        if (it == vbos.end()) return;
+        auto &attribute = it->second;
+        GLsizeiptr end = (count < 0) ? attribute.buffer->size() : first + count;
+        if (attribute.dirty_begin >= attribute.dirty_end) {
+            attribute.dirty_begin = first;
+            attribute.dirty_end = end;
+        } else {
+            attribute.dirty_begin = std::min(attribute.dirty_begin, first);
+            attribute.dirty_end = std::max(attribute.dirty_end, end);
+        }
+    }
+
     void set_mode(GLenum mode) {
         this->mode = mode;
     }
 
+    /// @brief Reorder triangles for the post-transform vertex cache, and vertices in order of
+    /// first use, from the next `init_from_mesh` on
+    /// @note Mesh attributes are then uploaded in the new vertex order (`get_vertex_order`),
+    /// which attributes set with `set_vbo` must follow.
+    void set_vertex_cache_optimizer(VertexCacheOptimizer optimizer) {
+        vertex_cache_optimizer = optimizer;
+    }
+
+    /// Buffer vertex i is mesh vertex `get_vertex_order()[i]`, empty if the order is the mesh's
+    const std::vector<unsigned int> &get_vertex_order() const {
+        return vertex_order;
+    }
+
+    /// @brief Bounding box of the vertex positions, in model space
+    /// @note Tracked through the uploads of "vposition" and of the mesh; partial updates only
+    /// grow it. Empty when unknown, e.g. for positions computed in a shader.
+    const Box3 &get_bounding_box() const {
+        return bounds;
+    }
+
+    /// Replace the tracked bounding box, e.g. for vertices displaced in a shader
+    void set_bounding_box(const Box3 &box) {
+        bounds = box;
+    }
+
     template <typename T>
     void set_vbo(const std::string &name, const std::vector<T> &data, GLuint divisor = 0) {
         if (data.size() == 0) return;
         set_vbo_raw<T>(name, &(data[0]), data.size(), divisor);
     }
 
+    /// Upload attribute `name`, reusing its storage when the size is unchanged
     template <typename T>
     void set_vbo_raw(const std::string &name, const void *data, GLsizeiptr num_elems, GLuint divisor = 0) {
 
-        auto &pair = vbos[name];
-        auto *buffer = dynamic_cast<ArrayBuffer<T>*>(pair.first.get());
+        auto &buffer = get_vbo<T>(name);
+        auto &attribute = vbos[name];
+        attribute.divisor = divisor;
+        attribute.dirty_begin = attribute.dirty_end = 0;
+
+        track_bounds<T>(name, data, num_elems, true);
+
+        vao.bind();
+        if (buffer.size() == num_elems && num_elems > 0)
+            buffer.update_raw(data, 0, num_elems);
+        else
+            buffer.upload_raw(data, num_elems);
+        vao.unbind();
+
+    }
+
+    /// Overwrite the elements [first, first + count) of attribute `name`, `data` points to the first one
+    template <typename T>
+    void update_vbo_raw(const std::string &name, const void *data, GLsizeiptr first, GLsizeiptr count) {
+
+        auto it = vbos.find(name);
+        auto *buffer = (it != vbos.end()) ? dynamic_cast<ArrayBuffer<T>*>(it->second.buffer.get()) : nullptr;
+        if (buffer == nullptr || first < 0 || first + count > buffer->size())
+            mFatal() << "Attribute" << name << "has no such range to update";
+
+        it->second.dirty_begin = it->second.dirty_end = 0;
+
+        track_bounds<T>(name, data, count, first == 0 && count == buffer->size());
+
+        vao.bind();
+        buffer->update_raw(data, first, count);
+        vao.unbind();
+
+    }
+
+    /// @brief Upload attribute `name` to the next region of a ring buffer, for data rewritten every frame
+    /// @note `set_attributes` must be called again before drawing, as the attribute moves within the ring.
+    template <typename T>
+    void stream_vbo_raw(const std::string &name, const void *data, GLsizeiptr num_elems, GLuint divisor = 0) {
+
+        auto &attribute = vbos[name];
+        auto *buffer = dynamic_cast<StreamingArrayBuffer<T>*>(attribute.buffer.get());
         if (buffer == nullptr) {
-            buffer = new ArrayBuffer<T>();
-            pair.first = std::unique_ptr<VectorArrayBuffer>(buffer);
+            buffer = new StreamingArrayBuffer<T>();
+            attribute.buffer = std::unique_ptr<VectorArrayBuffer>(buffer);
         }
 
-        pair.second = divisor;
+        attribute.divisor = divisor;
+        attribute.dirty_begin = attribute.dirty_end = 0;
+
+        track_bounds<T>(name, data, num_elems, true);
 
         vao.bind();
         buffer->upload_raw(data, num_elems);
@@ -117,6 +395,11 @@ public:
 
     }
 
+    template <typename T>
+    void stream_vbo(const std::string &name, const std::vector<T> &data, GLuint divisor = 0) {
+        stream_vbo_raw<T>(name, data.data(), data.size(), divisor);
+    }
+
     void set_vpoint(const std::vector<Vec3> &vpoint) {
         set_vbo<Vec3>("vposition", vpoint);
     }
@@ -130,10 +413,12 @@ public:
     }
 
     void set_triangles(const std::vector<unsigned int> &triangles) {
-        vao.bind();
-        this->triangles.upload(triangles);
-        vao.unbind();
-        element_count = triangles.size();
+        upload_indices(triangles);
+    }
+
+    /// 16 bit indices, for meshes of fewer than 65536 vertices
+    void set_triangles(const std::vector<uint16_t> &triangles) {
+        upload_indices(triangles);
     }
 
     void set_attributes(Shader &shader) {
@@ -142,35 +427,43 @@ public:
 
         for (auto &pair : vbos) {
             auto name = pair.first.c_str();
-            auto &buffer = *pair.second.first;
-            auto divisor = pair.second.second;
+            auto &buffer = *pair.second.buffer;
+            auto divisor = pair.second.divisor;
             shader.set_attribute(name, buffer, divisor);
         }
 
+        if (set_interleaved_attributes) {
+            set_interleaved_attributes(shader);
+        }
+
         vao.unbind();
 
     }
 
     void draw() {
 
+        if (!triangles) return;
+
         vao.bind();
-        triangles.bind();
+        triangles->bind();
 
-        glDrawElements(mode, element_count, GL_UNSIGNED_INT, 0);
+        glDrawElements(mode, element_count, triangles->get_data_type(), 0);
 
-        triangles.unbind();
+        triangles->unbind();
         vao.unbind();
 
     }
 
     void draw_instanced(GLsizei instances) {
 
+        if (!triangles) return;
+
         vao.bind();
-        triangles.bind();
+        triangles->bind();
 
-        glDrawElementsInstanced(mode, element_count, GL_UNSIGNED_INT, 0, instances);
+        glDrawElementsInstanced(mode, element_count, triangles->get_data_type(), 0, instances);
 
-        triangles.unbind();
+        triangles->unbind();
         vao.unbind();
 
     }
@@ -2,6 +2,8 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
+#include <atomic>
+
 #include "Material.h"
 
 
@@ -33,26 +35,39 @@ const char *Material::default_fragment_code() {
         uniform vec3 base_color;
 
         vec4 fragment_shade() {
-            vec3 lightdir = -get_forward();
+            vec3 lightdir = -get_light_direction();
             float diffuse = clamp(abs(dot(get_normal(), normalize(lightdir))), 0, 1);
             vec3 ambient = vec3(0.1,0.11,0.13);
 
-            return vec4(diffuse * base_color + ambient, 1);
+            return vec4(diffuse * get_light_color() * base_color + ambient, 1);
         }
 
     )GLSL";
 }
 
+uint64_t Material::next_revision() {
+    static std::atomic<uint64_t> counter(1); // 1 is the default material
+    return ++counter;
+}
+
+bool Material::uses_model(const std::string &code) {
+    // also finds get_MV and get_MVP
+    return code.find("get_M") != std::string::npos;
+}
+
 Material::Material() : Material(default_vertex_code(), default_geometry_code(), default_fragment_code()) {
     set_property("base_color", Vec3(0.6, 0.6, 0.6));
+    // all default materials are the same
+    revision = 1;
 }
 
 Material::Material(const std::string &fragment_code) : Material(default_vertex_code(), default_geometry_code(), fragment_code) {}
 
-Material::Material(const std::string &vertex_code, const std::string &geometry_code, const std::string &fragment_code) {
+Material::Material(const std::string &vertex_code, const std::string &geometry_code, const std::string &fragment_code) : revision(next_revision()) {
     this->vertex_code = vertex_code;
     this->geometry_code = geometry_code;
     this->fragment_code = fragment_code;
+    model_after_vertex_stage = uses_model(geometry_code) || uses_model(fragment_code);
 }
 
 const std::string &Material::get_vertex_code() const {
@@ -67,12 +82,17 @@ const std::string &Material::get_fragment_code() const {
 
 void Material::set_vertex_code(const std::string& code) {
     vertex_code = code;
+    revision = next_revision();
 }
 void Material::set_geometry_code(const std::string& code) {
     geometry_code = code;
+    model_after_vertex_stage = uses_model(geometry_code) || uses_model(fragment_code);
+    revision = next_revision();
 }
 void Material::set_fragment_code(const std::string& code) {
     fragment_code = code;
+    model_after_vertex_stage = uses_model(geometry_code) || uses_model(fragment_code);
+    revision = next_revision();
 }
 
 void Material::apply_properties(Shader &shader) const {
@@ -5,6 +5,7 @@
 #pragma once
 
 #include <string>
+#include <cstdint>
 #include <functional>
 #include <unordered_map>
 
@@ -25,6 +26,16 @@ private:
 
     std::unordered_map<std::string, std::function<void(Shader &shader)>> properties;
 
+    uint64_t revision;
+
+    bool model_after_vertex_stage; ///< the geometry or fragment code calls get_M, get_MV or get_MVP
+
+    /// Whether `code` calls one of the model matrix getters
+    HEADERONLY_INLINE static bool uses_model(const std::string &code);
+
+    /// A revision no material had yet
+    HEADERONLY_INLINE static uint64_t next_revision();
+
     HEADERONLY_INLINE static const char *default_vertex_code();
     HEADERONLY_INLINE static const char *default_geometry_code();
     HEADERONLY_INLINE static const char *default_fragment_code();
@@ -48,6 +59,20 @@ public:
         properties[name] = [val, name] (Shader &shader) {
             shader.set_uniform(name.c_str(), val);
         };
+        revision = next_revision();
+    }
+
+    /// @brief Materials with equal revisions have the same code and properties: copies share
+    /// the revision of the original, and any change gives a new one
+    /// @note Properties cannot be compared, this is how renderers tell they can draw together.
+    uint64_t get_revision() const {
+        return revision;
+    }
+
+    /// @brief The geometry or fragment code reads the model matrices, which instanced draws
+    /// only provide per instance to the vertex stage (see `MaterialRenderer::render_instanced`)
+    bool uses_model_after_vertex_stage() const {
+        return model_after_vertex_stage;
     }
 
     HEADERONLY_INLINE void apply_properties(Shader &shader) const;
@@ -2,6 +2,8 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
+#include <algorithm>
+
 #include "MaterialRenderer.h"
 
 
@@ -14,64 +16,94 @@ namespace {
     inline const char *global_uniforms() {
         return R"GLSL(
 
-            uniform float _uniform_aspect;
+            layout(std140) uniform _OpenGP_Frame {
+                mat4 _uniform_V;
+                mat4 _uniform_P;
+                mat4 _uniform_VP;
+                vec3 _uniform_eye;
+                float _uniform_aspect;
+                vec3 _uniform_forward;
+                float _uniform_vfov;
+                vec3 _uniform_up;
+                float _uniform_near;
+                vec3 _uniform_light_direction;
+                float _uniform_far;
+                vec3 _uniform_light_color;
+            };
+
             float get_aspect() {
                 return _uniform_aspect;
             }
 
-            uniform float _uniform_vfov;
             float get_vfov() {
                 return _uniform_vfov;
             }
 
-            uniform float _uniform_near;
             float get_near() {
                 return _uniform_near;
             }
 
-            uniform float _uniform_far;
             float get_far() {
                 return _uniform_far;
             }
 
-            uniform vec3 _uniform_eye;
             vec3 get_eye() {
                 return _uniform_eye;
             }
 
-            uniform vec3 _uniform_forward;
             vec3 get_forward() {
                 return _uniform_forward;
             }
 
-            uniform vec3 _uniform_up;
             vec3 get_up() {
                 return _uniform_up;
             }
 
-            uniform mat4 _uniform_M;
-            mat4 get_M() {
-                return _uniform_M;
+            vec3 get_light_direction() {
+                return _uniform_light_direction;
+            }
+
+            vec3 get_light_color() {
+                return _uniform_light_color;
             }
 
-            uniform mat4 _uniform_V;
             mat4 get_V() {
                 return _uniform_V;
             }
 
-            uniform mat4 _uniform_P;
             mat4 get_P() {
                 return _uniform_P;
             }
 
-            uniform mat4 _uniform_MV;
+            mat4 get_VP() {
+                return _uniform_VP;
+            }
+
+            #ifdef _OPENGP_INSTANCED
+
+            in mat4 _instance_M;
+            mat4 get_M() {
+                return _instance_M;
+            }
+
             mat4 get_MV() {
-                return _uniform_MV;
+                return _uniform_V * _instance_M;
             }
 
-            uniform mat4 _uniform_VP;
-            mat4 get_VP() {
-                return _uniform_VP;
+            mat4 get_MVP() {
+                return _uniform_VP * _instance_M;
+            }
+
+            #else
+
+            uniform mat4 _uniform_M;
+            mat4 get_M() {
+                return _uniform_M;
+            }
+
+            uniform mat4 _uniform_MV;
+            mat4 get_MV() {
+                return _uniform_MV;
             }
 
             uniform mat4 _uniform_MVP;
@@ -79,6 +111,8 @@ namespace {
                 return _uniform_MVP;
             }
 
+            #endif
+
             uniform int _uniform_wireframe;
             int get_wireframe() {
                 return _uniform_wireframe;
@@ -169,11 +203,13 @@ const Material &MaterialRenderer::get_material() const {
 }
 
 
-void MaterialRenderer::build_shader(Shader &shader, const std::string &vshader, const std::string &fshader, const std::string &gshader) {
+void MaterialRenderer::build_shader(Shader &shader, const std::string &vshader, const std::string &fshader, const std::string &gshader, bool instanced) {
 
     shader.clear();
 
     std::string vshader_source = "#version 330 core\n";
+    if (instanced)
+        vshader_source += "#define _OPENGP_INSTANCED\n";
     vshader_source += global_uniforms();
     vshader_source += vshader_preamble();
     vshader_source += vshader;
@@ -199,6 +235,7 @@ void MaterialRenderer::build_shader(Shader &shader, const std::string &vshader,
     if (gshader.size() > 0)
         shader.add_gshader_from_source(gshader_source.c_str());
     shader.link();
+    shader.bind_uniform_block("_OpenGP_Frame", FrameUniforms::binding);
 
     shader.bind();
     material.apply_properties(shader);
@@ -206,24 +243,58 @@ void MaterialRenderer::build_shader(Shader &shader, const std::string &vshader,
 
 }
 
+void MaterialRenderer::render_instanced(const RenderContext &context, const Mat4x4 *models, size_t count) {
+
+    RenderContext instance = context;
+    for (size_t i = 0;i < count;i++) {
+        instance.update_model(models[i]);
+        render(instance);
+    }
+
+}
+
+MaterialRenderer::ShaderUniforms &MaterialRenderer::get_shader_uniforms(Shader &shader) {
+
+    auto it = std::find_if(shader_uniforms.begin(), shader_uniforms.end(), [&](const ShaderUniforms &uniforms) {
+        return uniforms.shader == &shader;
+    });
+
+    if (it == shader_uniforms.end()) {
+        shader_uniforms.push_back(ShaderUniforms());
+        it = shader_uniforms.end() - 1;
+        it->shader = &shader;
+    } else if (it->M.is_current()) {
+        return *it;
+    }
+
+    // resolved once, and again whenever the shader is rebuilt
+    it->M = shader.uniform("_uniform_M");
+    it->MV = shader.uniform("_uniform_MV");
+    it->MVP = shader.uniform("_uniform_MVP");
+    it->wireframe = shader.uniform("_uniform_wireframe");
+    it->wirecolor = shader.uniform("_uniform_wirecolor");
+
+    return *it;
+
+}
+
 void MaterialRenderer::update_shader(Shader &shader, const RenderContext &context) {
 
-    shader.set_uniform("_uniform_aspect", context.aspect);
-    shader.set_uniform("_uniform_vfov", context.vfov);
-    shader.set_uniform("_uniform_near", context.near);
-    shader.set_uniform("_uniform_far", context.far);
-    shader.set_uniform("_uniform_eye", context.eye);
-    shader.set_uniform("_uniform_forward", context.forward);
-    shader.set_uniform("_uniform_up", context.up);
-    shader.set_uniform("_uniform_M", context.M);
-    shader.set_uniform("_uniform_V", context.V);
-    shader.set_uniform("_uniform_P", context.P);
-    shader.set_uniform("_uniform_MV", context.MV);
-    shader.set_uniform("_uniform_VP", context.VP);
-    shader.set_uniform("_uniform_MVP", context.MVP);
-
-    shader.set_uniform("_uniform_wireframe", use_wirecolor && (wireframe_mode != WireframeMode::None));
-    shader.set_uniform("_uniform_wirecolor", wirecolor);
+    if (!context.frame_uniforms_uploaded) {
+        if (!fallback_frame_uniforms)
+            fallback_frame_uniforms.reset(new UniformBuffer<FrameUniforms>());
+        fallback_frame_uniforms->upload(context.get_frame_uniforms());
+        fallback_frame_uniforms->bind_base(FrameUniforms::binding);
+    }
+
+    ShaderUniforms &uniforms = get_shader_uniforms(shader);
+
+    uniforms.M.set(context.M);
+    uniforms.MV.set(context.MV);
+    uniforms.MVP.set(context.MVP);
+
+    uniforms.wireframe.set((int)(use_wirecolor && (wireframe_mode != WireframeMode::None)));
+    uniforms.wirecolor.set(wirecolor);
 
     material.apply_properties(shader);
 
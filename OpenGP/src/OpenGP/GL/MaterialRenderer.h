@@ -5,17 +5,43 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <functional>
 
 #include <OpenGP/headeronly.h>
 #include <OpenGP/types.h>
 #include <OpenGP/GL/Eigen.h>
 #include <OpenGP/GL/Shader.h>
+#include <OpenGP/GL/Buffer.h>
 #include <OpenGP/GL/Material.h>
 
 //=============================================================================
 namespace OpenGP {
 //=============================================================================
 
+/// @brief Camera and light data of a frame, in the std140 layout of the `_OpenGP_Frame`
+/// uniform block that every material shader shares
+struct FrameUniforms {
+
+    /// Uniform buffer binding point of the block
+    static constexpr GLuint binding = 0;
+
+    Mat4x4 V;
+    Mat4x4 P;
+    Mat4x4 VP;
+
+    Vec3 eye;             float aspect;
+    Vec3 forward;         float vfov;
+    Vec3 up;              float near;
+    Vec3 light_direction; float far;
+    Vec3 light_color;     float padding = 0;
+
+};
+
+static_assert(sizeof(FrameUniforms) == 3 * 64 + 5 * 16, "FrameUniforms must match the std140 layout");
+
 struct RenderContext {
 
     // Camera parameters
@@ -33,6 +59,16 @@ struct RenderContext {
 
     bool ortho = false;
 
+    // Light parameters
+
+    /// Zero for a headlight, which follows `forward`
+    Vec3 light_direction = Vec3(0, 0, 0);
+    Vec3 light_color = Vec3(1, 1, 1);
+
+    /// The frame block was uploaded and bound by `upload_frame_uniforms`, otherwise
+    /// renderers upload it on every draw
+    bool frame_uniforms_uploaded = false;
+
     // Object parameters
 
     Vec3 translation;
@@ -60,6 +96,14 @@ struct RenderContext {
         MVP = P * V * M;
     }
 
+    /// Use `model` as the model matrix, e.g. a cached world matrix, instead of `translation`, `rotation` and `scale`
+    void update_model(const Mat4x4 &model) {
+        M = model;
+
+        MV = V * M;
+        MVP = VP * M;
+    }
+
     void update_view() {
 
         V = look_at(eye, Vec3(eye + forward), up);
@@ -81,6 +125,50 @@ struct RenderContext {
         MVP = P * V * M;
     }
 
+    /// The camera and light data in the layout of the shared uniform block
+    FrameUniforms get_frame_uniforms() const {
+        FrameUniforms block;
+        block.V = V;
+        block.P = P;
+        block.VP = VP;
+        block.eye = eye;
+        block.forward = forward;
+        block.up = up;
+        block.light_direction = light_direction.isZero() ? forward : light_direction;
+        block.light_color = light_color;
+        block.aspect = aspect;
+        block.vfov = vfov;
+        block.near = near;
+        block.far = far;
+        return block;
+    }
+
+    /// Upload the camera and light data once for the frame, for all the draws that follow
+    void upload_frame_uniforms(UniformBuffer<FrameUniforms> &buffer) {
+        buffer.upload(get_frame_uniforms());
+        buffer.bind_base(FrameUniforms::binding);
+        frame_uniforms_uploaded = true;
+    }
+
+};
+
+/// @brief What renderers must have in common to be drawn together by one `render_instanced`
+/// @note Only renderers of the same type return the same non-null `geometry`. Renderers whose
+/// options change the draw (beyond the model matrix) return no geometry.
+struct InstanceBatchKey {
+
+    const void *geometry = nullptr; ///< e.g. the GPUMesh drawn, nullptr if the renderer cannot be batched
+    uint64_t material = 0;          ///< `Material::get_revision()`
+
+    bool operator==(const InstanceBatchKey &rhs) const {
+        return geometry == rhs.geometry && material == rhs.material;
+    }
+
+    bool operator<(const InstanceBatchKey &rhs) const {
+        if (geometry != rhs.geometry) return std::less<const void*>()(geometry, rhs.geometry);
+        return material < rhs.material;
+    }
+
 };
 
 enum class WireframeMode {
@@ -90,11 +178,32 @@ enum class WireframeMode {
 };
 
 class MaterialRenderer {
+private:
+
+    /// Per-object uniforms of one of the shaders of the renderer
+    struct ShaderUniforms {
+        const Shader *shader;
+        Shader::Uniform M, MV, MVP, wireframe, wirecolor;
+    };
+
+    std::vector<ShaderUniforms> shader_uniforms;
+
+    /// Frame block of contexts that were not uploaded once for the frame
+    std::unique_ptr<UniformBuffer<FrameUniforms>> fallback_frame_uniforms;
+
+    /// The (re)resolved uniform handles of `shader`
+    HEADERONLY_INLINE ShaderUniforms &get_shader_uniforms(Shader &shader);
+
 protected:
 
     Material material;
 
-    HEADERONLY_INLINE void build_shader(Shader &shader, const std::string &vshader, const std::string &fshader, const std::string &gshader = "");
+    /// @brief Compile the shader stages around the material code
+    /// @note With `instanced`, `get_M()`, `get_MV()` and `get_MVP()` of the vertex stage use the
+    /// per instance model matrix of the `_instance_M` attribute (a stream of `Mat4x4`, divisor 1)
+    /// instead of the uniforms, which the other stages keep using: renderers only batch materials
+    /// that do not `uses_model_after_vertex_stage()`.
+    HEADERONLY_INLINE void build_shader(Shader &shader, const std::string &vshader, const std::string &fshader, const std::string &gshader = "", bool instanced = false);
 
     HEADERONLY_INLINE void update_shader(Shader &shader, const RenderContext &context);
 
@@ -110,8 +219,19 @@ public:
 
     virtual void render(const RenderContext&) = 0;
 
+    /// Renderers with equal keys (with a geometry) draw the same but for their model matrix
+    virtual InstanceBatchKey get_instance_batch_key() const { return InstanceBatchKey(); }
+
+    /// @brief Draw once per model matrix of `models`, in a single draw call if the renderer
+    /// supports it, otherwise one `render` each
+    /// @note Called on one of the renderers of a batch of equal keys.
+    HEADERONLY_INLINE virtual void render_instanced(const RenderContext &context, const Mat4x4 *models, size_t count);
+
     virtual void rebuild() {}
 
+    /// Bounds of what `render` draws in model space, empty if unknown (then never culled)
+    virtual Box3 get_bounding_box() const { return Box3(); }
+
     HEADERONLY_INLINE void set_material(const Material &material);
 
     HEADERONLY_INLINE Material &get_material();
@@ -2,13 +2,161 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <condition_variable>
+#include <algorithm>
+
 #include "Scene.h"
+#include <OpenGP/GL/Components/TransformComponent.h> ///< defines TransformHierarchy
 
 
 //=============================================================================
 namespace OpenGP {
 //=============================================================================
 
+namespace {
+
+    /// Whether an update may read or write the transforms, which a refresh of their cached matrices rewrites
+    bool touches_transforms(const UpdateAccess &access) {
+        size_t id = ComponentType::id<TransformComponent>();
+        return access.exclusive ||
+               std::find(access.reads.begin(), access.reads.end(), id) != access.reads.end() ||
+               std::find(access.writes.begin(), access.writes.end(), id) != access.writes.end();
+    }
+
+    /// @brief The updates of one frame, each job waiting for the earlier jobs it conflicts with
+    /// @note Finishing a job starts the jobs that waited for it, so the threads chain through
+    /// the graph without a central loop; the calling thread runs the GL and exclusive jobs.
+    /// The transforms are refreshed before each GL job, which may render them, so GL jobs also
+    /// wait for (and hold back) the jobs touching transforms.
+    class UpdateSchedule {
+    private:
+
+        struct Job {
+            ComponentPoolBase *pool = nullptr;
+            std::vector<int> dependents;
+            std::atomic<int> waiting;    ///< unfinished jobs this one depends on
+            std::atomic<size_t> chunks;  ///< unfinished chunks of instances
+        };
+
+        WorkStealingPool &threads;
+        TransformHierarchy &transforms;
+        std::vector<Job> jobs;
+        int remaining; ///< unfinished jobs, guarded by `main_mutex`
+
+        std::mutex main_mutex;
+        std::condition_variable main_condition;
+        std::deque<int> main_jobs;
+
+        void start(int j) {
+            Job &job = jobs[j];
+            const UpdateAccess &access = job.pool->get_update_access();
+
+            if (access.exclusive || access.uses_gl) {
+                {
+                    std::lock_guard<std::mutex> lock(main_mutex);
+                    main_jobs.push_back(j);
+                }
+                main_condition.notify_one();
+                return;
+            }
+
+            size_t n = job.pool->count();
+            size_t grain = n;
+            if (access.parallel_instances) {
+                grain = std::max(n / (8 * (size_t)threads.size()), (size_t)64);
+            }
+            size_t n_chunks = std::max((n + grain - 1) / std::max(grain, (size_t)1), (size_t)1);
+
+            job.chunks = n_chunks;
+            for (size_t c = 0;c < n_chunks;c++) {
+                size_t begin = std::min(c * grain, n);
+                size_t end = std::min(begin + grain, n);
+                threads.submit([this, j, begin, end]() {
+                    jobs[j].pool->update(begin, end);
+                    if (--jobs[j].chunks == 0) finish(j);
+                });
+            }
+        }
+
+        void finish(int j) {
+            for (int d : jobs[j].dependents) {
+                if (--jobs[d].waiting == 0) start(d);
+            }
+            // counted and notified under the lock: once it is released, `run` may see no job
+            // remaining, return and destroy the schedule
+            std::lock_guard<std::mutex> lock(main_mutex);
+            if (--remaining == 0) main_condition.notify_one();
+        }
+
+    public:
+
+        UpdateSchedule(WorkStealingPool &threads, TransformHierarchy &transforms, const std::vector<ComponentPoolBase*> &pools) :
+            threads(threads), transforms(transforms), jobs(pools.size()), remaining((int)pools.size()) {
+
+            // a job waits for the earlier ones it conflicts with, which keeps the serial order where it matters
+            for (size_t b = 0;b < jobs.size();b++) {
+                jobs[b].pool = pools[b];
+                jobs[b].waiting = 0;
+                for (size_t a = 0;a < b;a++) {
+                    const UpdateAccess &first = pools[a]->get_update_access(), &second = pools[b]->get_update_access();
+                    bool refresh_conflict = (first.uses_gl && touches_transforms(second)) || (second.uses_gl && touches_transforms(first));
+                    if (first.conflicts_with(second) || refresh_conflict) {
+                        jobs[a].dependents.push_back((int)b);
+                        jobs[b].waiting++;
+                    }
+                }
+            }
+
+        }
+
+        /// Run all the jobs, on the calling thread and the pool
+        void run() {
+
+            // roots first: starting one may already finish it and release the others
+            std::vector<int> roots;
+            for (size_t j = 0;j < jobs.size();j++) {
+                if (jobs[j].waiting == 0) roots.push_back((int)j);
+            }
+            for (int j : roots) {
+                start(j);
+            }
+
+            while (true) {
+
+                int j = -1;
+                {
+                    std::lock_guard<std::mutex> lock(main_mutex);
+                    if (remaining == 0) return;
+                    if (!main_jobs.empty()) {
+                        j = main_jobs.front();
+                        main_jobs.pop_front();
+                    }
+                }
+
+                if (j >= 0) {
+                    if (jobs[j].pool->get_update_access().uses_gl) transforms.update();
+                    jobs[j].pool->update(0, jobs[j].pool->count());
+                    finish(j);
+                    continue;
+                }
+
+                // help with the queued chunks, or sleep until a job for this thread or the end
+                if (threads.run_one()) continue;
+
+                std::unique_lock<std::mutex> lock(main_mutex);
+                main_condition.wait(lock, [this]() { return !main_jobs.empty() || remaining == 0; });
+
+            }
+
+        }
+
+    };
+
+}
+
 Entity &Scene::create_entity() {
 
     entities.emplace_back();
@@ -23,10 +171,42 @@ void Scene::update() {
 
     /// @note Calls `Component::update()` for all components on all objects
 
-    for (auto &entity : entities) {
-        entity.update();
+    std::vector<ComponentPoolBase*> jobs;
+    bool concurrent = false;
+    for (auto &pool : pools) {
+        if (pool && pool->has_update() && pool->count() > 0) {
+            jobs.push_back(pool.get());
+            const UpdateAccess &access = pool->get_update_access();
+            concurrent = concurrent || !(access.exclusive || access.uses_gl);
+        }
+    }
+
+    /// @note Updates using GL may render, the transforms moved until then are refreshed before each of them
+
+    if (update_threads == 1 || !concurrent) {
+        for (auto pool : jobs) {
+            if (pool->get_update_access().uses_gl) transform_hierarchy.update();
+            pool->update(0, pool->count());
+        }
+    } else {
+        update_parallel(jobs);
+    }
+
+    /// @note Then refreshes the cached matrices of the transforms moved before or during the update
+
+    transform_hierarchy.update();
+
+}
+
+void Scene::update_parallel(const std::vector<ComponentPoolBase*> &jobs) {
+
+    if (!update_pool) {
+        update_pool.reset(new WorkStealingPool(update_threads));
     }
 
+    UpdateSchedule schedule(*update_pool, transform_hierarchy, jobs);
+    schedule.run();
+
 }
 
 //=============================================================================
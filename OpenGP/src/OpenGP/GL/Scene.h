@@ -5,10 +5,15 @@
 #pragma once
 
 #include <list>
+#include <vector>
+#include <memory>
 
 #include <OpenGP/headeronly.h>
-#include <OpenGP/util/GenericIterable.h>
+#include <OpenGP/util/Range.h>
+#include <OpenGP/util/WorkStealingPool.h>
+#include <OpenGP/GL/ComponentPool.h>
 #include <OpenGP/GL/Entity.h>
+#include <OpenGP/GL/TransformHierarchy.h>
 
 
 //=============================================================================
@@ -19,8 +24,21 @@ namespace OpenGP {
 class Scene {
 private:
 
+    /// Declared before the entities, whose transform components leave it when destroyed
+    TransformHierarchy transform_hierarchy;
+
     std::list<Entity> entities;
 
+    /// Pools indexed by `ComponentType::id`, declared last so that components go before their entities
+    std::vector<std::unique_ptr<ComponentPoolBase>> pools;
+
+    /// Threads that run the updates, started by the first parallel update
+    std::unique_ptr<WorkStealingPool> update_pool;
+
+    int update_threads = 0;
+
+    HEADERONLY_INLINE void update_parallel(const std::vector<ComponentPoolBase*> &jobs);
+
 public:
 
     /// Create a new empty scene
@@ -42,27 +60,81 @@ public:
         return t;
     }
 
-    /// Get an iterable object that contains all objects with the specified component
+    /// The storage of all the components of type `T`, created empty on first use
     template <typename T>
-    GenericIterable<T> all_of_type() {
+    ComponentPool<T> &get_pool() {
+        size_t id = ComponentType::id<T>();
+        if (id >= pools.size()) {
+            pools.resize(id + 1);
+        }
+        if (!pools[id]) {
+            pools[id].reset(new ComponentPool<T>());
+        }
+        return static_cast<ComponentPool<T>&>(*pools[id]);
+    }
 
-        auto filter_pred = [](Entity &e){
-            return e.has<T>();
-        };
+    /// Get an iterable object that contains all the components of type `T`, in creation order
+    template <typename T>
+    Range<typename ComponentPool<T>::iterator> all_of_type() {
+        return make_range(get_pool<T>());
+    }
+
+    /// Get the component referred to by `handle`
+    template <typename T>
+    T &get(ComponentHandle<T> handle) {
+        return get_pool<T>().get(handle);
+    }
 
-        auto map_pred = [](Entity &e){
-            return &(e.get<T>());
-        };
+    /// The cached matrices of the `TransformComponent`s of the scene
+    TransformHierarchy &get_transform_hierarchy() {
+        return transform_hierarchy;
+    }
 
-        return GenericIterable<Entity>::adaptor(entities).filter(filter_pred).map(map_pred);
+    /// @brief Threads running `update()`, the calling thread included (0: one per hardware thread)
+    /// @note With 1 thread, the updates run serially in a deterministic order.
+    void set_update_threads(int n_threads) {
+        update_threads = n_threads;
+        update_pool.reset();
+    }
 
+    int get_update_threads() const {
+        return update_threads;
     }
 
-    /// Run one step of the scene simulation
+    /// @brief Run one step of the scene simulation
+    /// @note Component types update one after the other, in the order they were first used,
+    /// each in creation order. Updates that do not conflict (see `UpdateAccess`) run concurrently
+    /// on a work stealing pool, while GL and exclusive updates stay on the calling thread.
     HEADERONLY_INLINE void update();
 
 };
 
+template <typename T>
+T &Entity::require() {
+    assert(scene != nullptr);
+
+    if (has<T>())
+        return get<T>();
+
+    auto &pool = scene->get_pool<T>();
+    uint32_t pool_index = (uint32_t)pool.size();
+    T *component = pool.create();
+
+    size_t id = ComponentType::id<T>();
+    if (id >= components.size()) {
+        components.resize(id + 1, nullptr);
+    }
+    components[id] = component;
+    update_order.push_back(component);
+
+    component->entity = this;
+    component->scene = scene;
+    component->pool_index = pool_index;
+    component->init();
+
+    return *component;
+}
+
 //=============================================================================
 } // OpenGP::
 //=============================================================================
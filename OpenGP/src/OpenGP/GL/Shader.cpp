@@ -2,6 +2,8 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
+#include <cstring>
+
 #include <OpenGP/GL/Shader.h>
 
 //=============================================================================
@@ -12,57 +14,103 @@ void Shader::clear() {
     glDeleteProgram(pid);
     _is_valid = false;
     pid = glCreateProgram();
+    uniforms.clear();
+    uniform_slots.clear();
+    attributes.clear();
+    link_generation++;
 }
 
-void Shader::set_uniform(const char* name, int scalar) {
+bool Shader::update_uniform_cache(int slot, const void* data, int count) {
+    UniformSlot &cached = uniform_slots[slot];
+    if (cached.count == count && std::memcmp(cached.value, data, count * sizeof(float)) == 0)
+        return false;
+    cached.count = count;
+    std::memcpy(cached.value, data, count * sizeof(float));
+    return true;
+}
+
+void Shader::set_uniform_slot(int slot, int scalar) {
     assert( check_is_current() );
-    if (!has_uniform(name)) return;
-    GLint loc = uniforms.at(std::string(name));
-    glUniform1i(loc, scalar);
+    static_assert(sizeof(int) == sizeof(float), "Cached ints need float sized slots");
+    if (update_uniform_cache(slot, &scalar, 1))
+        glUniform1i(uniform_slots[slot].location, scalar);
 }
 
-void Shader::set_uniform(const char* name, float scalar) {
+void Shader::set_uniform_slot(int slot, float scalar) {
     assert( check_is_current() );
-    if (!has_uniform(name)) return;
-    GLint loc = uniforms.at(std::string(name));
-    glUniform1f(loc, scalar);
+    if (update_uniform_cache(slot, &scalar, 1))
+        glUniform1f(uniform_slots[slot].location, scalar);
 }
 
-void Shader::set_uniform(const char* name, const Eigen::Vector3f& vector) {
+void Shader::set_uniform_slot(int slot, const Eigen::Vector3f& vector) {
     assert( check_is_current() );
-    if (!has_uniform(name)) return;
-    GLint loc = uniforms.at(std::string(name));
-    glUniform3fv(loc, 1, vector.data());
+    if (update_uniform_cache(slot, vector.data(), 3))
+        glUniform3fv(uniform_slots[slot].location, 1, vector.data());
 }
 
-void Shader::set_uniform(const char* name, const Eigen::Matrix4f& matrix) {
+void Shader::set_uniform_slot(int slot, const Eigen::Matrix4f& matrix) {
     assert( check_is_current() );
-    if (!has_uniform(name)) return;
-    GLint loc = uniforms.at(std::string(name));
-    glUniformMatrix4fv(loc, 1, GL_FALSE, matrix.data());
+    if (update_uniform_cache(slot, matrix.data(), 16))
+        glUniformMatrix4fv(uniform_slots[slot].location, 1, GL_FALSE, matrix.data());
+}
+
+Shader::Uniform Shader::uniform(const char* name) {
+    auto it = uniforms.find(std::string(name));
+    return Uniform(this, (it != uniforms.end()) ? it->second : -1);
+}
+
+void Shader::invalidate_uniform_cache() {
+    for (UniformSlot &slot : uniform_slots) slot.count = 0;
+}
+
+bool Shader::bind_uniform_block(const char* name, GLuint binding) {
+    GLuint index = glGetUniformBlockIndex(pid, name);
+    if (index == GL_INVALID_INDEX) return false;
+    glUniformBlockBinding(pid, index, binding);
+    return true;
+}
+
+void Shader::set_uniform(const char* name, int scalar) {
+    auto it = uniforms.find(std::string(name));
+    if (it != uniforms.end()) set_uniform_slot(it->second, scalar);
+}
+
+void Shader::set_uniform(const char* name, float scalar) {
+    auto it = uniforms.find(std::string(name));
+    if (it != uniforms.end()) set_uniform_slot(it->second, scalar);
+}
+
+void Shader::set_uniform(const char* name, const Eigen::Vector3f& vector) {
+    auto it = uniforms.find(std::string(name));
+    if (it != uniforms.end()) set_uniform_slot(it->second, vector);
+}
+
+void Shader::set_uniform(const char* name, const Eigen::Matrix4f& matrix) {
+    auto it = uniforms.find(std::string(name));
+    if (it != uniforms.end()) set_uniform_slot(it->second, matrix);
 }
 
 void Shader::get_uniform(const char* name, int &scalar) {
     assert( check_is_current() );
-    GLint loc = uniforms.at(std::string(name));
+    GLint loc = uniform_slots[uniforms.at(std::string(name))].location;
     glGetUniformiv(pid, loc, &scalar);
 }
 
 void Shader::get_uniform(const char* name, float &scalar) {
     assert( check_is_current() );
-    GLint loc = uniforms.at(std::string(name));
+    GLint loc = uniform_slots[uniforms.at(std::string(name))].location;
     glGetUniformfv(pid, loc, &scalar);
 }
 
 void Shader::get_uniform(const char* name, Eigen::Vector3f& vector) {
     assert( check_is_current() );
-    GLint loc = uniforms.at(std::string(name));
+    GLint loc = uniform_slots[uniforms.at(std::string(name))].location;
     glGetUniformfv(pid, loc, vector.data());
 }
 
 void Shader::get_uniform(const char* name, Eigen::Matrix4f& matrix) {
     assert( check_is_current() );
-    GLint loc = uniforms.at(std::string(name));
+    GLint loc = uniform_slots[uniforms.at(std::string(name))].location;
     glGetUniformfv(pid, loc, matrix.data());
 }
 
@@ -118,9 +166,27 @@ void OpenGP::Shader::set_attribute(const char* name, VectorArrayBuffer &buffer,
     assert( check_is_current() );
     if (!has_attribute(name)) return;
     GLint location = attributes.at(std::string(name));
+    buffer.bind(); ///< memory the description below refers to
+    // matrices (e.g. mat4 of Mat4x4) take one location per column of 4 components
+    GLuint components = buffer.get_components();
+    GLuint columns = (components > 4) ? components / 4 : 1;
+    GLsizei stride = (columns > 1) ? (GLsizei)buffer.elem_size() : ZERO_STRIDE;
+    for (GLuint i = 0;i < columns;i++) {
+        GLintptr offset = buffer.get_offset() + i * buffer.elem_size() / columns;
+        glEnableVertexAttribArray(location + i); ///< cached in VAO
+        glVertexAttribPointer(location + i, components / columns, buffer.get_data_type(), DONT_NORMALIZE, stride, (const void*)offset);
+        glVertexAttribDivisor(location + i, divisor);
+    }
+}
+
+void OpenGP::Shader::set_attribute(const char* name, GenericArrayBuffer& buffer, GLint components, GLenum type, bool normalized,
+                                   GLsizei stride, GLintptr offset, GLuint divisor) {
+    assert( check_is_current() );
+    if (!has_attribute(name)) return;
+    GLint location = attributes.at(std::string(name));
     glEnableVertexAttribArray(location); ///< cached in VAO
     buffer.bind(); ///< memory the description below refers to
-    glVertexAttribPointer(location, buffer.get_components(), buffer.get_data_type(), DONT_NORMALIZE, ZERO_STRIDE, ZERO_BUFFER_OFFSET);
+    glVertexAttribPointer(location, components, type, normalized, stride, (const void*)offset);
     glVertexAttribDivisor(location, divisor);
 }
 
@@ -232,7 +298,9 @@ bool OpenGP::Shader::link() {
     } else {
 
         uniforms.clear();
+        uniform_slots.clear();
         attributes.clear();
+        link_generation++;
 
         _is_valid = true;
 
@@ -253,7 +321,10 @@ bool OpenGP::Shader::link() {
         for (GLint i = 0;i < uniforms_count;i++) {
             glGetActiveUniform(pid, i, 128, nullptr, &uniform_size, &uniform_type, buffer);
             uniform_location = glGetUniformLocation(pid, buffer);
-            uniforms[std::string(buffer)] = uniform_location;
+            if (uniform_location < 0) continue; ///< members of uniform blocks
+            uniforms[std::string(buffer)] = (int)uniform_slots.size();
+            uniform_slots.push_back(UniformSlot());
+            uniform_slots.back().location = uniform_location;
         }
 
     }
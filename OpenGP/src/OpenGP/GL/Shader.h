@@ -5,6 +5,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <unordered_map>
 
 #include <Eigen/Dense>
@@ -31,14 +32,52 @@ namespace{
 class Shader{
 /// @{
 private:
+
+    /// Location of an active uniform and the last value set through this class
+    struct UniformSlot {
+        GLint location;
+        int count = 0;        ///< 0: no cached value
+        float value[16];      ///< raw bits, ints are stored as is
+    };
+
     GLuint pid = 0; ///< 0: invalid
     bool _is_valid = false;
+    unsigned link_generation = 0; ///< bumped whenever the uniform slots are rebuilt
     std::unordered_map<std::string, GLuint> attributes;
-    std::unordered_map<std::string, GLuint> uniforms;
+    std::unordered_map<std::string, int> uniforms; ///< name to index in uniform_slots
+    std::vector<UniformSlot> uniform_slots;
 public:
     bool verbose = false; ///< prints messages
 /// @}
 
+public:
+
+    /// @brief Resolved uniform of a linked shader, setting it costs no name lookup
+    /// @note Values equal to the last one set (through a handle or by name) are not
+    /// sent to GL again. Handles of uniforms the program does not use are valid and
+    /// ignore the values. A handle is stale once its shader is linked or cleared again.
+    class Uniform {
+    private:
+        friend class Shader;
+        Shader *shader = nullptr;
+        int slot = -1;
+        unsigned generation = 0;
+        Uniform(Shader *shader, int slot) : shader(shader), slot(slot), generation(shader->link_generation) {}
+    public:
+        Uniform() {}
+
+        /// The program has an active uniform of this name
+        bool is_active() const { assert(is_current()); return slot >= 0; }
+
+        /// The shader was not linked again since the handle was resolved
+        bool is_current() const { return shader != nullptr && generation == shader->link_generation; }
+
+        void set(int scalar) { assert(is_current()); if (slot >= 0) shader->set_uniform_slot(slot, scalar); }
+        void set(float scalar) { assert(is_current()); if (slot >= 0) shader->set_uniform_slot(slot, scalar); }
+        void set(const Eigen::Vector3f& vector) { assert(is_current()); if (slot >= 0) shader->set_uniform_slot(slot, vector); }
+        void set(const Eigen::Matrix4f& matrix) { assert(is_current()); if (slot >= 0) shader->set_uniform_slot(slot, matrix); }
+    };
+
 public:
 
     Shader(){ pid = glCreateProgram(); }
@@ -85,7 +124,25 @@ public:
 /// @}
 
 /// @{ uniforms setters
+private:
+    /// Store `count` floats worth of `data` in the slot cache, false if they are unchanged
+    HEADERONLY_INLINE bool update_uniform_cache(int slot, const void* data, int count);
+    HEADERONLY_INLINE void set_uniform_slot(int slot, int scalar);
+    HEADERONLY_INLINE void set_uniform_slot(int slot, float scalar);
+    HEADERONLY_INLINE void set_uniform_slot(int slot, const Eigen::Vector3f& vector);
+    HEADERONLY_INLINE void set_uniform_slot(int slot, const Eigen::Matrix4f& matrix);
 public:
+    /// Handle of the uniform `name`, resolve it once after linking and keep it
+    HEADERONLY_INLINE Uniform uniform(const char* name);
+
+    /// @brief Forget the cached uniform values
+    /// @note Needed only after setting uniforms of this program with raw glUniform calls
+    HEADERONLY_INLINE void invalidate_uniform_cache();
+
+    /// @brief Attach the uniform block `name` to the uniform buffer binding point `binding`
+    /// @return false if the program has no such active block
+    HEADERONLY_INLINE bool bind_uniform_block(const char* name, GLuint binding);
+
     HEADERONLY_INLINE void set_uniform(const char* name, int scalar);
     HEADERONLY_INLINE void set_uniform(const char* name, float scalar);
     HEADERONLY_INLINE void set_uniform(const char* name, const Eigen::Vector3f& vector);
@@ -110,6 +167,9 @@ public:
     HEADERONLY_INLINE void set_attribute(const char* name, ArrayBuffer<Eigen::Vector2f>& buffer, GLuint divisor = 0);
     HEADERONLY_INLINE void set_attribute(const char* name, ArrayBuffer<Eigen::Vector3f>& buffer, GLuint divisor = 0);
     HEADERONLY_INLINE void set_attribute(const char* name, VectorArrayBuffer& buffer, GLuint divisor = 0);
+    /// Attribute of `components` values of `type` at byte `offset` of every `stride` bytes of an interleaved buffer
+    HEADERONLY_INLINE void set_attribute(const char* name, GenericArrayBuffer& buffer, GLint components, GLenum type, bool normalized,
+                                         GLsizei stride, GLintptr offset, GLuint divisor = 0);
 /// @}
 
     HEADERONLY_INLINE bool has_attribute(const char* name) const;
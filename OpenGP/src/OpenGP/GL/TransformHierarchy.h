@@ -0,0 +1,72 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <Eigen/StdVector>
+
+#include <OpenGP/headeronly.h>
+#include <OpenGP/types.h>
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+class TransformComponent;
+
+/// @brief The cached local and world matrices of all the transforms of a scene
+/// @note Matrices are stored contiguously with parents before their children, so that
+/// `update` is a single forward pass in which each parent world matrix is already final.
+/// The methods are defined with `TransformComponent`, which they need.
+class TransformHierarchy {
+
+    friend class TransformComponent;
+
+private:
+
+    using Matrices = std::vector<Mat4x4, Eigen::aligned_allocator<Mat4x4>>;
+
+    /// Position, scale and rotation a local matrix was built from
+    struct LocalState {
+        float values[10];
+    };
+
+    std::vector<TransformComponent*> nodes;  ///< nullptr once removed (until the next sort)
+    std::vector<int> parents;                ///< index of the parent, -1 for roots
+    std::vector<LocalState> states;
+    std::vector<char> changed;               ///< world matrix changed during the current pass
+    std::vector<uint32_t> world_passes;      ///< pass in which the world matrix last changed
+    Matrices local_matrices;
+    Matrices world_matrices;
+
+    bool topology_changed = false;
+
+    uint32_t pass = 0; ///< count of `update` calls
+
+    HEADERONLY_INLINE void add(TransformComponent *node);
+
+    HEADERONLY_INLINE void remove(TransformComponent *node);
+
+    /// Restore the parents-first order after parents changed
+    HEADERONLY_INLINE void sort();
+
+public:
+
+    TransformHierarchy() {}
+
+    TransformHierarchy(const TransformHierarchy&) = delete;
+    TransformHierarchy &operator=(const TransformHierarchy&) = delete;
+
+    /// Rebuild the local matrices of the transforms that changed, and the world matrices below them
+    HEADERONLY_INLINE void update();
+
+};
+
+//=============================================================================
+} // OpenGP::
+//=============================================================================
@@ -0,0 +1,236 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include <OpenGP/types.h>
+#include <OpenGP/GL/gl.h>
+#include <OpenGP/GL/Shader.h>
+#include <OpenGP/GL/Buffer.h>
+#include <OpenGP/SurfaceMesh/SurfaceMesh.h>
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+/// @file
+/// Interleaved vertex layouts described at compile time. A layout lists attributes, each
+/// with a vertex format; the same description packs the vertices of a mesh into one
+/// buffer and points the shader attributes into it, e.g.
+///
+///     using Layout = VertexLayout<PositionAttribute<Float3Format>, NormalAttribute<Snorm10Format>>;
+///
+/// Every format packs a `Vec3` (2D formats take x and y) into a multiple of 4 bytes, so
+/// that all attributes stay aligned.
+
+namespace internal {
+
+    /// IEEE half float of `value`, rounded to nearest even
+    inline uint16_t float_to_half(float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, 4);
+        uint32_t sign = (bits >> 16) & 0x8000;
+        uint32_t magnitude = bits & 0x7fffffff;
+        if (magnitude >= 0x7f800000) // inf and nan
+            return (uint16_t)(sign | 0x7c00 | ((magnitude > 0x7f800000) ? 0x200 : 0));
+        if (magnitude >= 0x477ff000) // overflows to inf
+            return (uint16_t)(sign | 0x7c00);
+        if (magnitude < 0x38800000) { // subnormal (or zero) half
+            float scaled;
+            uint32_t abs_bits = magnitude;
+            std::memcpy(&scaled, &abs_bits, 4);
+            return (uint16_t)(sign | (uint32_t)std::nearbyint(scaled * 16777216.0f));
+        }
+        uint32_t rounded = magnitude + 0xfff + ((magnitude >> 13) & 1) - 0x38000000;
+        return (uint16_t)(sign | (rounded >> 13));
+    }
+
+    /// Signed normalized integer of `bits` bits of `value` in [-1, 1]
+    inline int32_t to_snorm(float value, int bits) {
+        const float scale = (float)((1 << (bits - 1)) - 1);
+        return (int32_t)std::lround(std::min(std::max(value, -1.0f), 1.0f) * scale);
+    }
+
+    /// Unsigned normalized integer of `bits` bits of `value` in [0, 1]
+    inline uint32_t to_unorm(float value, int bits) {
+        const float scale = (float)((1u << bits) - 1);
+        return (uint32_t)std::lround(std::min(std::max(value, 0.0f), 1.0f) * scale);
+    }
+
+}
+
+///--- Vertex formats
+
+/// Three floats (12 bytes)
+struct Float3Format {
+    static constexpr GLint components = 3;
+    static constexpr GLenum type = GL_FLOAT;
+    static constexpr bool normalized = false;
+    static constexpr size_t size = 12;
+    static void pack(const Vec3 &value, uint8_t *out) { std::memcpy(out, value.data(), 12); }
+};
+
+/// Two floats (8 bytes)
+struct Float2Format {
+    static constexpr GLint components = 2;
+    static constexpr GLenum type = GL_FLOAT;
+    static constexpr bool normalized = false;
+    static constexpr size_t size = 8;
+    static void pack(const Vec3 &value, uint8_t *out) { std::memcpy(out, value.data(), 8); }
+};
+
+/// Unit vectors as signed normalized 10-10-10-2 (4 bytes), the shader sees a vec3 with 1/511 precision
+struct Snorm10Format {
+    static constexpr GLint components = 4;
+    static constexpr GLenum type = GL_INT_2_10_10_10_REV;
+    static constexpr bool normalized = true;
+    static constexpr size_t size = 4;
+    static void pack(const Vec3 &value, uint8_t *out) {
+        uint32_t packed = ((uint32_t)internal::to_snorm(value(0), 10) & 0x3ff) |
+                          (((uint32_t)internal::to_snorm(value(1), 10) & 0x3ff) << 10) |
+                          (((uint32_t)internal::to_snorm(value(2), 10) & 0x3ff) << 20);
+        std::memcpy(out, &packed, 4);
+    }
+};
+
+/// Two half floats (4 bytes), e.g. texture coordinates that may leave [0, 1]
+struct Half2Format {
+    static constexpr GLint components = 2;
+    static constexpr GLenum type = GL_HALF_FLOAT;
+    static constexpr bool normalized = false;
+    static constexpr size_t size = 4;
+    static void pack(const Vec3 &value, uint8_t *out) {
+        uint16_t packed[2] = { internal::float_to_half(value(0)), internal::float_to_half(value(1)) };
+        std::memcpy(out, packed, 4);
+    }
+};
+
+/// Two unsigned normalized shorts (4 bytes), for texture coordinates in [0, 1]
+struct Unorm16x2Format {
+    static constexpr GLint components = 2;
+    static constexpr GLenum type = GL_UNSIGNED_SHORT;
+    static constexpr bool normalized = true;
+    static constexpr size_t size = 4;
+    static void pack(const Vec3 &value, uint8_t *out) {
+        uint16_t packed[2] = { (uint16_t)internal::to_unorm(value(0), 16), (uint16_t)internal::to_unorm(value(1), 16) };
+        std::memcpy(out, packed, 4);
+    }
+};
+
+/// RGB in [0, 1] as unsigned normalized bytes, with an opaque alpha (4 bytes)
+struct Unorm8x4Format {
+    static constexpr GLint components = 4;
+    static constexpr GLenum type = GL_UNSIGNED_BYTE;
+    static constexpr bool normalized = true;
+    static constexpr size_t size = 4;
+    static void pack(const Vec3 &value, uint8_t *out) {
+        for (int i = 0;i < 3;i++) out[i] = (uint8_t)internal::to_unorm(value(i), 8);
+        out[3] = 255;
+    }
+};
+
+///--- Vertex attributes, the shader input and the mesh property they come from
+
+template <class F>
+struct PositionAttribute {
+    using Format = F;
+    static const char *name() { return "vposition"; }
+    static const char *property() { return "v:point"; }
+};
+
+template <class F>
+struct NormalAttribute {
+    using Format = F;
+    static const char *name() { return "vnormal"; }
+    static const char *property() { return "v:normal"; }
+};
+
+template <class F>
+struct TexcoordAttribute {
+    using Format = F;
+    static const char *name() { return "vtexcoord"; }
+    static const char *property() { return "v:texcoord"; }
+};
+
+template <class F>
+struct ColorAttribute {
+    using Format = F;
+    static const char *name() { return "vcolor"; }
+    static const char *property() { return "v:color"; }
+};
+
+///--- Layouts
+
+/// Interleaved vertices made of `Attributes`, in order
+template <class... Attributes>
+class VertexLayout {
+private:
+
+    // single return statements, as C++11 constexpr functions require
+    static constexpr size_t sum() {
+        return 0;
+    }
+
+    template <class... Sizes>
+    static constexpr size_t sum(size_t size, Sizes... sizes) {
+        return size + sum(sizes...);
+    }
+
+    template <class Attribute>
+    static void pack_attribute(const SurfaceMesh &mesh, size_t offset, uint8_t *out) {
+        // missing properties are packed as zero
+        auto property = mesh.get_vertex_property<Vec3>(Attribute::property());
+        const Vec3 zero = Vec3::Zero();
+        for (size_t v = 0;v < mesh.n_vertices();v++) {
+            Attribute::Format::pack(property ? property.data()[v] : zero, out + v * stride + offset);
+        }
+    }
+
+    template <class Attribute>
+    static void set_attribute(Shader &shader, GenericArrayBuffer &buffer, size_t offset, GLuint divisor) {
+        using Format = typename Attribute::Format;
+        shader.set_attribute(Attribute::name(), buffer, Format::components, Format::type, Format::normalized, (GLsizei)stride, (GLintptr)offset, divisor);
+    }
+
+public:
+
+    static_assert(sizeof...(Attributes) > 0, "A vertex layout needs attributes");
+
+    /// Bytes per vertex
+    static constexpr size_t stride = sum(Attributes::Format::size...);
+
+    /// Shader input names of the attributes
+    static std::vector<const char*> names() {
+        return { Attributes::name()... };
+    }
+
+    /// Pack the vertex properties of `mesh` into `n_vertices * stride` bytes
+    static void pack(const SurfaceMesh &mesh, std::vector<uint8_t> &out) {
+        out.resize(mesh.n_vertices() * stride);
+        size_t offset = 0;
+        int expand[] = { (pack_attribute<Attributes>(mesh, offset, out.data()), offset += Attributes::Format::size, 0)... };
+        (void)expand;
+    }
+
+    /// Point the attributes of `shader` into `buffer`, which holds packed vertices
+    static void set_attributes(Shader &shader, GenericArrayBuffer &buffer, GLuint divisor = 0) {
+        size_t offset = 0;
+        int expand[] = { (set_attribute<Attributes>(shader, buffer, offset, divisor), offset += Attributes::Format::size, 0)... };
+        (void)expand;
+    }
+
+};
+
+/// Full precision positions, 10-10-10-2 normals and half float texture coordinates (20 bytes instead of 32)
+using PackedVertexLayout = VertexLayout<PositionAttribute<Float3Format>, NormalAttribute<Snorm10Format>, TexcoordAttribute<Half2Format>>;
+
+//=============================================================================
+} // namespace OpenGP
+//=============================================================================
@@ -11,6 +11,7 @@
 #include <type_traits>
 #include <limits>
 #include <cassert>
+#include <cstring>
 
 #include <Eigen/Dense>
 #include <Eigen/Geometry>
@@ -23,6 +24,9 @@
 #include <OpenGP/GL/FullscreenQuad.h>
 #include <OpenGP/GL/SceneObject.h>
 #include <OpenGP/Image/ImageType.h>
+#include <OpenGP/Image/PixelConversion.h>
+#include <OpenGP/Image/PNGEncoder.h>
+#include <OpenGP/Image/RawImageFile.h>
 
 //=============================================================================
 namespace OpenGP {
@@ -56,18 +60,47 @@ protected:
 
     int components;
     int width, height;
+    int bit_depth = 8;
 
 public:
 
     using ReadFunction = std::function<void(int, int, int, double)>;
+    using RowFunction = std::function<void(int, const void*)>;
 
     int get_components() const { return components; }
     int get_width() const { return width; }
     int get_height() const { return height; }
 
+    /// Bits per decoded sample: 8 (uint8_t), 16 (uint16_t in host byte order) or 32 (float)
+    int get_bit_depth() const { return bit_depth; }
+
     virtual ~ImageReader() {}
 
-    virtual void read(const ReadFunction&) = 0;
+    /// Decode the image, calling the function with each row of `width * components` interleaved samples
+    /// @note Rows come in file order, each exactly once
+    virtual void read_rows(const RowFunction&) = 0;
+
+    /// Decode the image straight into rows of `width * components` samples, `row_stride` bytes apart
+    virtual void read_into(void *buffer, size_t row_stride) {
+        size_t row_bytes = (size_t)width * components * (bit_depth / 8);
+        read_rows([&](int row, const void *samples) {
+            std::memcpy((uint8_t*)buffer + row * row_stride, samples, row_bytes);
+        });
+    }
+
+    /// Decode the image one sample at a time, as a value in [0, 1] (slow, for pixel types without packed samples)
+    void read(const ReadFunction &read_function) {
+        read_rows([&](int row, const void *samples) {
+            for (int col = 0;col < width;col++) {
+                for (int c = 0;c < components;c++) {
+                    int i = col * components + c;
+                    double val = (bit_depth == 32) ? ((const float*)samples)[i] :
+                                 (bit_depth == 16) ? ((const uint16_t*)samples)[i] / 65535.0 : ((const uint8_t*)samples)[i] / 255.0;
+                    read_function(row, col, c, val);
+                }
+            }
+        });
+    }
 
 };
 
@@ -75,14 +108,25 @@ class PNGReader : public ImageReader {
 public:
     HEADERONLY_INLINE PNGReader(const std::string &path);
     HEADERONLY_INLINE ~PNGReader();
-    HEADERONLY_INLINE void read(const ReadFunction&);
+    HEADERONLY_INLINE void read_rows(const RowFunction&);
+    HEADERONLY_INLINE void read_into(void *buffer, size_t row_stride);
 };
 
 class TGAReader : public ImageReader {
 public:
     HEADERONLY_INLINE TGAReader(const std::string &path);
     HEADERONLY_INLINE ~TGAReader();
-    HEADERONLY_INLINE void read(const ReadFunction&);
+    HEADERONLY_INLINE void read_rows(const RowFunction&);
+    HEADERONLY_INLINE void read_into(void *buffer, size_t row_stride);
+};
+
+/// Reader of raw images (see RawImageFile), uncompressed rows are read straight from the file mapping
+class RawImageReader : public ImageReader {
+public:
+    HEADERONLY_INLINE RawImageReader(const std::string &path);
+    HEADERONLY_INLINE ~RawImageReader();
+    HEADERONLY_INLINE void read_rows(const RowFunction&);
+    HEADERONLY_INLINE void read_into(void *buffer, size_t row_stride);
 };
 
 class ImageWriter {
@@ -92,19 +136,46 @@ protected:
 
     int components, bit_depth;
     int width, height;
+    bool floating_point = false;
 
 public:
 
     using WriteFunction = std::function<double(int, int, int)>;
+    using RowFunction = std::function<void(int, void*)>;
 
     virtual ~ImageWriter() {}
 
     void set_components(int components) { this->components = components; }
     void set_bit_depth(int bit_depth) { this->bit_depth = bit_depth; }
+    void set_floating_point(bool floating_point) { this->floating_point = floating_point; }
     void set_width(int width) { this->width = width; }
     void set_height(int height) { this->height = height; }
 
-    virtual void write(const WriteFunction&) = 0;
+    /// Bits per sample the writer asks for: 8 (uint8_t), 16 (uint16_t in host byte order) or 32 (float)
+    virtual int get_bit_depth() const { return (bit_depth <= 8) ? 8 : 16; }
+
+    /// Encode the image, calling the function to fill each row of `width * components` interleaved samples
+    /// @note Rows are requested top to bottom, and writers hold no more than a bounded band of them
+    virtual void write_rows(const RowFunction&) = 0;
+
+    /// Encode the image one sample at a time, from a value in [0, 1] (slow, for pixel types without packed samples)
+    void write(const WriteFunction &write_function) {
+        int depth = get_bit_depth();
+        write_rows([&](int row, void *samples) {
+            for (int col = 0;col < width;col++) {
+                for (int c = 0;c < components;c++) {
+                    int i = col * components + c;
+                    if (depth == 32) {
+                        ((float*)samples)[i] = (float)write_function(row, col, c);
+                        continue;
+                    }
+                    double val = std::min(std::max(write_function(row, col, c), 0.0), 1.0);
+                    if (depth == 16) ((uint16_t*)samples)[i] = (uint16_t)(val * 65535);
+                    else ((uint8_t*)samples)[i] = (uint8_t)(val * 255);
+                }
+            }
+        });
+    }
 
 };
 
@@ -112,14 +183,48 @@ class PNGWriter : public ImageWriter {
 public:
     HEADERONLY_INLINE PNGWriter(const std::string &path);
     HEADERONLY_INLINE ~PNGWriter();
-    HEADERONLY_INLINE void write(const WriteFunction&);
+
+    /// zlib compression level, 0 (store) to 9 (smallest), 6 by default
+    HEADERONLY_INLINE void set_compression_level(int level);
+
+    /// Row filter, adaptive by default
+    HEADERONLY_INLINE void set_filter(PNGFilter filter);
+
+    /// Threads filtering and compressing bands of rows (0, the default, uses all hardware threads)
+    HEADERONLY_INLINE void set_threads(int n_threads);
+
+    HEADERONLY_INLINE void write_rows(const RowFunction&);
+private:
+    PNGEncoder encoder;
 };
 
 class TGAWriter : public ImageWriter {
 public:
     HEADERONLY_INLINE TGAWriter(const std::string &path);
     HEADERONLY_INLINE ~TGAWriter();
-    HEADERONLY_INLINE void write(const WriteFunction&);
+
+    /// Run-length encode the pixels (off by default: uncompressed TGA is the cheapest to write and read)
+    HEADERONLY_INLINE void set_rle(bool rle);
+
+    /// TGA stores 8 bit samples only
+    int get_bit_depth() const { return 8; }
+
+    HEADERONLY_INLINE void write_rows(const RowFunction&);
+};
+
+/// Writer of raw images (see RawImageFile), which keep float and 16 bit samples as they are
+class RawImageWriter : public ImageWriter {
+public:
+    HEADERONLY_INLINE RawImageWriter(const std::string &path);
+    HEADERONLY_INLINE ~RawImageWriter();
+
+    /// Compress tiles of this many rows (0, the default, stores the samples uncompressed for zero-copy mapping)
+    HEADERONLY_INLINE void set_tile_rows(int tile_rows);
+
+    /// Float images are stored as float, others as 8 or 16 bit integers
+    int get_bit_depth() const { return floating_point ? 32 : (bit_depth <= 8) ? 8 : 16; }
+
+    HEADERONLY_INLINE void write_rows(const RowFunction&);
 };
 
 
@@ -144,30 +249,148 @@ typename std::enable_if<!std::is_integral<Scalar>::value, double>::type scalar_t
 }
 
 
-template <typename ImageType>
-void imread(const char* path, ImageType& I) {
+namespace internal {
+
+    /// Convert a row of decoded samples of `bit_depth` bits (see ImageReader) to `Dst` samples
+    template <typename Dst>
+    void convert_row_from(const void *samples, int bit_depth, int src_channels, Dst *dst, int dst_channels, int width) {
+        if (bit_depth == 32) {
+            convert_row((const float*)samples, src_channels, dst, dst_channels, width);
+        } else if (bit_depth == 16) {
+            convert_row((const uint16_t*)samples, src_channels, dst, dst_channels, width);
+        } else {
+            convert_row((const uint8_t*)samples, src_channels, dst, dst_channels, width);
+        }
+    }
+
+    /// Convert a row of `Src` samples to samples of `bit_depth` bits (see ImageWriter)
+    template <typename Src>
+    void convert_row_to(const Src *src, int channels, void *samples, int bit_depth, int width) {
+        if (bit_depth == 32) {
+            convert_row(src, channels, (float*)samples, channels, width);
+        } else if (bit_depth == 16) {
+            convert_row(src, channels, (uint16_t*)samples, channels, width);
+        } else {
+            convert_row(src, channels, (uint8_t*)samples, channels, width);
+        }
+    }
 
-    std::regex suffix_regex(R"regex([\S\s]*\.([^\.]+)$)regex");
+    template <typename ImageType>
+    bool imread_rows(ImageReader &reader, ImageType &I, std::true_type /*packed pixels*/) {
 
-    std::cmatch match;
-    if (!std::regex_match(path, match, suffix_regex))
-        mFatal() << "Could not identify the image file type";
+        using Scalar = typename ImageTypeInfo<ImageType>::Scalar;
+        constexpr int components = ImageTypeInfo<ImageType>::component_count;
 
-    std::string suffix = match[1];
-    std::transform(suffix.begin(), suffix.end(), suffix.begin(), ::tolower);
+        if (!channels_convertible(reader.get_components(), components))
+            mFatal() << "Image type and image file are incompatible";
 
-    std::unique_ptr<ImageReader> reader;
+        Scalar *data = (Scalar*)I.data();
+        int width = reader.get_width();
+        size_t row_samples = (size_t)width * components;
+
+        bool same_samples = 8 * sizeof(Scalar) == (size_t)reader.get_bit_depth() &&
+                            std::is_floating_point<Scalar>::value == (reader.get_bit_depth() == 32);
+
+        if (reader.get_components() == components && same_samples) {
+            reader.read_into(data, sizeof(Scalar) * row_samples);
+        } else {
+            reader.read_rows([&](int row, const void *samples) {
+                convert_row_from(samples, reader.get_bit_depth(), reader.get_components(), data + row * row_samples, components, width);
+            });
+        }
+
+        return true;
+
+    }
+
+    template <typename ImageType>
+    bool imread_rows(ImageReader&, ImageType&, std::false_type) { return false; }
+
+    template <typename ImageType>
+    bool imwrite_rows(ImageWriter &writer, const ImageType &I, std::true_type /*packed pixels*/) {
+
+        using Scalar = typename ImageTypeInfo<ImageType>::Scalar;
+        constexpr int components = ImageTypeInfo<ImageType>::component_count;
+
+        const Scalar *data = (const Scalar*)I.data();
+        int width = I.cols();
+        size_t row_samples = (size_t)width * components;
+
+        int depth = writer.get_bit_depth();
+        writer.write_rows([&](int row, void *samples) {
+            convert_row_to(data + row * row_samples, components, samples, depth, width);
+        });
+
+        return true;
+
+    }
+
+    template <typename ImageType>
+    bool imwrite_rows(ImageWriter&, const ImageType&, std::false_type) { return false; }
+
+    /// Lower case suffix of the path, which identifies the image file type
+    inline std::string image_suffix(const std::string &path) {
+
+        std::regex suffix_regex(R"regex([\S\s]*\.([^\.]+)$)regex");
+
+        std::smatch match;
+        if (!std::regex_match(path, match, suffix_regex))
+            mFatal() << "Could not identify the image file type";
+
+        std::string suffix = match[1];
+        std::transform(suffix.begin(), suffix.end(), suffix.begin(), ::tolower);
+
+        return suffix;
+
+    }
+
+    inline std::unique_ptr<ImageReader> open_image_reader(const std::string &path) {
+
+        std::string suffix = image_suffix(path);
+
+        if (suffix == "png") {
+            return std::unique_ptr<ImageReader>(new PNGReader(path));
+        } else if (suffix == "tga") {
+            return std::unique_ptr<ImageReader>(new TGAReader(path));
+        } else if (suffix == "rawimg") {
+            return std::unique_ptr<ImageReader>(new RawImageReader(path));
+        }
 
-    if (suffix == "png") {
-        reader = std::unique_ptr<ImageReader>(new PNGReader(path));
-    } else if (suffix == "tga") {
-        reader = std::unique_ptr<ImageReader>(new TGAReader(path));
-    } else {
         mFatal() << "Unknown image type suffix";
+        return nullptr;
+
     }
 
+    inline std::unique_ptr<ImageWriter> open_image_writer(const std::string &path) {
+
+        std::string suffix = image_suffix(path);
+
+        if (suffix == "png") {
+            return std::unique_ptr<ImageWriter>(new PNGWriter(path));
+        } else if (suffix == "tga") {
+            return std::unique_ptr<ImageWriter>(new TGAWriter(path));
+        } else if (suffix == "rawimg") {
+            return std::unique_ptr<ImageWriter>(new RawImageWriter(path));
+        }
+
+        mFatal() << "Unknown image type suffix";
+        return nullptr;
+
+    }
+
+}
+
+template <typename ImageType>
+void imread(const char* path, ImageType& I) {
+
+    std::unique_ptr<ImageReader> reader = internal::open_image_reader(path);
+
     I.resize(reader->get_height(), reader->get_width());
 
+    // packed pixels are converted a row at a time, or decoded straight into the image
+    if (internal::imread_rows(*reader, I, has_packed_pixels<ImageType>()))
+        return;
+
     int image_type_components = ImageTypeInfo<ImageType>::component_count;
     using Scalar = typename ImageTypeInfo<ImageType>::Scalar;
 
@@ -194,6 +417,23 @@ void imread(const char* path, ImageType& I) {
             mFatal() << "Image type and image file are incompatible";
         }
 
+    } else if (reader->get_components() == 2) {
+
+        // gray replicated into the first 3 provided channels, alpha kept only as the fourth
+        if (image_type_components == 1 || image_type_components == 3 || image_type_components == 4) {
+            read_function = [&](int row, int col, int c, double val) {
+                if (c == 0) {
+                    for (int i = 0;i < std::min(image_type_components, 3);i++) {
+                        ImageTypeInfo<ImageType>::channel_ref(I, row, col, i) = scalar_transfer_read<Scalar>(val);
+                    }
+                } else if (image_type_components == 4) {
+                    ImageTypeInfo<ImageType>::channel_ref(I, row, col, 3) = scalar_transfer_read<Scalar>(val);
+                }
+            };
+        } else {
+            mFatal() << "Image type and image file are incompatible";
+        }
+
     } else if (reader->get_components() == 3) {
 
         if (image_type_components == 1) {
@@ -257,24 +497,7 @@ void imread(const char* path, ImageType& I) {
 template <typename ImageType>
 void imwrite(const char* path, ImageType &I) {
 
-    std::regex suffix_regex(R"regex([\S\s]*\.([^\.]+)$)regex");
-
-    std::cmatch match;
-    if (!std::regex_match(path, match, suffix_regex))
-        mFatal() << "Could not identify the image file type";
-
-    std::string suffix = match[1];
-    std::transform(suffix.begin(), suffix.end(), suffix.begin(), ::tolower);
-
-    std::unique_ptr<ImageWriter> writer;
-
-    if (suffix == "png") {
-        writer = std::unique_ptr<ImageWriter>(new PNGWriter(path));
-    } else if (suffix == "tga") {
-        writer = std::unique_ptr<ImageWriter>(new TGAWriter(path));
-    } else {
-        mFatal() << "Unknown image type suffix";
-    }
+    std::unique_ptr<ImageWriter> writer = internal::open_image_writer(path);
 
     int image_type_components = ImageTypeInfo<ImageType>::component_count;
     using Scalar = typename ImageTypeInfo<ImageType>::Scalar;
@@ -285,6 +508,10 @@ void imwrite(const char* path, ImageType &I) {
     writer->set_height(I.rows());
     writer->set_components(image_type_components);
     writer->set_bit_depth(8 * sizeof(Scalar));
+    writer->set_floating_point(std::is_floating_point<Scalar>::value);
+
+    if (internal::imwrite_rows(*writer, I, has_packed_pixels<ImageType>()))
+        return;
 
     ImageWriter::WriteFunction write_function;
 
@@ -317,6 +544,97 @@ void imwrite(const char* path, ImageType &I) {
 
 }
 
+/// @brief Read an image a band of `band_rows` rows at a time, without holding all of it in memory
+/// @note `band_function(const ImageType &band, int first_row)` is called once per band, with
+/// `band.rows()` rows starting at image row `first_row` (the last band may be shorter).
+/// Bands come in file order, which is bottom to top for some TGA files. PNG and TGA
+/// files are decoded a row at a time, except interlaced PNGs and LodePNG builds, which
+/// decode the whole image first.
+template <typename ImageType, typename BandFunction>
+void imread_bands(const std::string &path, int band_rows, BandFunction band_function) {
+
+    static_assert(has_packed_pixels<ImageType>::value, "Banded reading needs pixels of packed samples");
+
+    using Scalar = typename ImageTypeInfo<ImageType>::Scalar;
+    constexpr int components = ImageTypeInfo<ImageType>::component_count;
+
+    std::unique_ptr<ImageReader> reader = internal::open_image_reader(path);
+
+    if (!channels_convertible(reader->get_components(), components))
+        mFatal() << "Image type and image file are incompatible";
+
+    int width = reader->get_width(), height = reader->get_height();
+    band_rows = std::max(1, std::min(band_rows, height));
+    size_t row_samples = (size_t)width * components;
+
+    ImageType band;
+    int band_index = -1, band_filled = 0;
+
+    reader->read_rows([&](int row, const void *samples) {
+
+        int index = row / band_rows;
+        if (index != band_index) {
+            if (band_filled != 0)
+                mFatal() << "Image rows arrived out of band order";
+            band_index = index;
+            band.resize(std::min(band_rows, height - index * band_rows), width);
+        }
+
+        Scalar *out = (Scalar*)band.data() + (row - index * band_rows) * row_samples;
+        internal::convert_row_from(samples, reader->get_bit_depth(), reader->get_components(), out, components, width);
+
+        if (++band_filled == band.rows()) {
+            band_function((const ImageType&)band, index * band_rows);
+            band_filled = 0;
+        }
+
+    });
+
+}
+
+/// @brief Write a `width` x `height` image a band of `band_rows` rows at a time, without holding all of it in memory
+/// @note `band_function(ImageType &band, int first_row)` fills `band`, which is sized to
+/// the rows starting at image row `first_row` (the last band may be shorter). Bands are
+/// requested top to bottom, and written out as soon as the encoder has enough rows.
+template <typename ImageType, typename BandFunction>
+void imwrite_bands(const std::string &path, int width, int height, int band_rows, BandFunction band_function) {
+
+    static_assert(has_packed_pixels<ImageType>::value, "Banded writing needs pixels of packed samples");
+
+    using Scalar = typename ImageTypeInfo<ImageType>::Scalar;
+    constexpr int components = ImageTypeInfo<ImageType>::component_count;
+
+    std::unique_ptr<ImageWriter> writer = internal::open_image_writer(path);
+
+    writer->set_width(width);
+    writer->set_height(height);
+    writer->set_components(components);
+    writer->set_bit_depth(8 * sizeof(Scalar));
+    writer->set_floating_point(std::is_floating_point<Scalar>::value);
+
+    band_rows = std::max(1, std::min(band_rows, height));
+    size_t row_samples = (size_t)width * components;
+    int depth = writer->get_bit_depth();
+
+    ImageType band;
+    int band_index = -1;
+
+    writer->write_rows([&](int row, void *samples) {
+
+        int index = row / band_rows;
+        if (index != band_index) {
+            band_index = index;
+            band.resize(std::min(band_rows, height - index * band_rows), width);
+            band_function(band, index * band_rows);
+        }
+
+        const Scalar *in = (const Scalar*)band.data() + (row - index * band_rows) * row_samples;
+        internal::convert_row_to(in, components, samples, depth, width);
+
+    });
+
+}
+
 //=============================================================================
 } // namespace OpenGP
 //=============================================================================
@@ -324,4 +642,5 @@ void imwrite(const char* path, ImageType &I) {
 #ifdef HEADERONLY
     #include "PNGImage.cpp"
     #include "TGAImage.cpp"
+    #include "RawImage.cpp"
 #endif
@@ -0,0 +1,415 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <cmath>
+#include <cstring>
+#include <utility>
+#include <algorithm>
+
+#include "ImageFilters.h"
+
+#include <OpenGP/MLogger.h>
+#include <OpenGP/util/parallel_for.h>
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+namespace {
+
+    /// Pixels along a row processed together, small enough to stay on the stack
+    const int lanes = 64;
+
+    int clamp_index(int i, int n) {
+        return std::min(std::max(i, 0), n - 1);
+    }
+
+    std::vector<float> gaussian_kernel(Scalar sigma) {
+        int radius = std::max(1, (int)std::ceil(3 * sigma));
+        std::vector<float> kernel(2 * radius + 1);
+        float sum = 0;
+        for (int i = -radius;i <= radius;i++) {
+            kernel[i + radius] = std::exp(-0.5f * i * i / (sigma * sigma));
+            sum += kernel[i + radius];
+        }
+        for (float &k : kernel) k /= sum;
+        return kernel;
+    }
+
+    /// @brief Convolve rows of `width * channels` interleaved samples with `kernel` horizontally, then vertically
+    /// @note Both passes are sums of whole shifted rows, which the compiler vectorizes.
+    void separable_filter(const float *in, float *out, int width, int height, int channels, const std::vector<float> &kernel, int n_threads) {
+
+        const int radius = (int)kernel.size() / 2;
+        const size_t row_samples = (size_t)width * channels;
+        std::vector<float> horizontal(row_samples * height);
+
+        parallel_for(0, height, [&](int y) {
+
+            // the row with `radius` replicated pixels on either side
+            std::vector<float> padded((size_t)(width + 2 * radius) * channels);
+            const float *row = in + y * row_samples;
+            for (int x = -radius;x < width + radius;x++) {
+                std::memcpy(&padded[(size_t)(x + radius) * channels], row + (size_t)clamp_index(x, width) * channels, channels * sizeof(float));
+            }
+
+            float *dst = horizontal.data() + y * row_samples;
+            std::fill(dst, dst + row_samples, 0.0f);
+            for (int k = 0;k < (int)kernel.size();k++) {
+                const float weight = kernel[k];
+                const float *src = padded.data() + (size_t)k * channels;
+                for (size_t i = 0;i < row_samples;i++) dst[i] += weight * src[i];
+            }
+
+        }, 8, n_threads);
+
+        parallel_for(0, height, [&](int y) {
+            float *dst = out + y * row_samples;
+            std::fill(dst, dst + row_samples, 0.0f);
+            for (int k = 0;k < (int)kernel.size();k++) {
+                const float weight = kernel[k];
+                const float *src = horizontal.data() + clamp_index(y + k - radius, height) * row_samples;
+                for (size_t i = 0;i < row_samples;i++) dst[i] += weight * src[i];
+            }
+        }, 8, n_threads);
+
+    }
+
+    /// @brief Smooth depth with `kernel`, normalized over the valid pixels
+    /// @note Depth and validity are filtered together as two interleaved channels.
+    void depth_separable_filter(const Image<uint16_t> &in, Image<uint16_t> &out, const std::vector<float> &kernel, int n_threads) {
+
+        const int width = in.cols(), height = in.rows();
+        std::vector<float> weighted(2 * (size_t)width * height);
+
+        parallel_for(0, height, [&](int y) {
+            const uint16_t *row = in.data() + y * width;
+            float *dst = weighted.data() + 2 * (size_t)y * width;
+            for (int x = 0;x < width;x++) {
+                dst[2 * x] = row[x];
+                dst[2 * x + 1] = (row[x] != 0) ? 1.0f : 0.0f;
+            }
+        }, 8, n_threads);
+
+        separable_filter(weighted.data(), weighted.data(), width, height, 2, kernel, n_threads);
+
+        out.resize(height, width);
+        parallel_for(0, height, [&](int y) {
+            const uint16_t *row = in.data() + y * width;
+            const float *src = weighted.data() + 2 * (size_t)y * width;
+            uint16_t *dst = out.data() + y * width;
+            for (int x = 0;x < width;x++) {
+                float depth = src[2 * x] / std::max(src[2 * x + 1], 1e-6f) + 0.5f;
+                dst[x] = (row[x] != 0) ? (uint16_t)std::min(depth, 65535.0f) : 0;
+            }
+        }, 8, n_threads);
+
+    }
+
+    /// Rows y - radius .. y + radius (clamped) of `in`, each extended by `radius` replicated pixels
+    void padded_rows(const uint16_t *in, int width, int height, int y, int radius, std::vector<uint16_t> &rows) {
+        const int padded_width = width + 2 * radius;
+        rows.resize((size_t)(2 * radius + 1) * padded_width);
+        for (int dy = -radius;dy <= radius;dy++) {
+            const uint16_t *row = in + (size_t)clamp_index(y + dy, height) * width;
+            uint16_t *dst = rows.data() + (size_t)(dy + radius) * padded_width;
+            for (int x = -radius;x < 0;x++) dst[x + radius] = row[0];
+            std::memcpy(dst + radius, row, width * sizeof(uint16_t));
+            for (int x = width;x < width + radius;x++) dst[x + radius] = row[width - 1];
+        }
+    }
+
+    /// The source pixels, copied if the output would overwrite them
+    const uint16_t *filter_source(const Image<uint16_t> &in, const Image<uint16_t> &out, Image<uint16_t> &copy) {
+        if (&in != &out) return in.data();
+        copy = in;
+        return copy.data();
+    }
+
+    using Comparator = std::pair<int, int>;
+
+    /// @brief Batcher's odd-even merge sorting network on `n` (a power of two) values,
+    /// keeping only the comparators that the value at `target` depends on
+    std::vector<Comparator> selection_network(int n, int target) {
+
+        std::vector<Comparator> network;
+        for (int p = 1;p < n;p *= 2) {
+            for (int k = p;k >= 1;k /= 2) {
+                for (int j = k % p;j + k < n;j += 2 * k) {
+                    for (int i = 0;i < std::min(k, n - j - k);i++) {
+                        if ((i + j) / (2 * p) == (i + j + k) / (2 * p)) network.push_back({ i + j, i + j + k });
+                    }
+                }
+            }
+        }
+
+        std::vector<bool> needed(n, false);
+        needed[target] = true;
+        std::vector<Comparator> pruned;
+        for (int c = (int)network.size() - 1;c >= 0;c--) {
+            const Comparator &comparator = network[c];
+            if (!needed[comparator.first] && !needed[comparator.second]) continue;
+            needed[comparator.first] = needed[comparator.second] = true;
+            pruned.push_back(comparator);
+        }
+        std::reverse(pruned.begin(), pruned.end());
+
+        return pruned;
+
+    }
+
+}
+
+namespace internal {
+
+    void gaussian_blur(const float *in, float *out, int width, int height, int channels, Scalar sigma, int n_threads) {
+        separable_filter(in, out, width, height, channels, gaussian_kernel(sigma), n_threads);
+    }
+
+    void box_blur(const float *in, float *out, int width, int height, int channels, int radius, int n_threads) {
+        radius = std::max(radius, 0);
+        separable_filter(in, out, width, height, channels, std::vector<float>(2 * radius + 1, 1.0f / (2 * radius + 1)), n_threads);
+    }
+
+    void downsample(const float *in, float *out, int width, int height, int channels, int n_threads) {
+
+        const int half_width = (width + 1) / 2, half_height = (height + 1) / 2;
+        const size_t row_samples = (size_t)width * channels;
+
+        parallel_for(0, half_height, [&](int y) {
+            const float *row0 = in + 2 * y * row_samples;
+            const float *row1 = in + std::min(2 * y + 1, height - 1) * row_samples;
+            float *dst = out + (size_t)y * half_width * channels;
+            for (int x = 0;x < half_width;x++) {
+                int x0 = 2 * x * channels, x1 = std::min(2 * x + 1, width - 1) * channels;
+                for (int c = 0;c < channels;c++) {
+                    dst[x * channels + c] = 0.25f * (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c]);
+                }
+            }
+        }, 8, n_threads);
+
+    }
+
+}
+
+void gaussian_blur(const Image<uint16_t> &in, Image<uint16_t> &out, Scalar sigma, int n_threads) {
+    depth_separable_filter(in, out, gaussian_kernel(sigma), n_threads);
+}
+
+void box_blur(const Image<uint16_t> &in, Image<uint16_t> &out, int radius, int n_threads) {
+    radius = std::max(radius, 0);
+    depth_separable_filter(in, out, std::vector<float>(2 * radius + 1, 1.0f / (2 * radius + 1)), n_threads);
+}
+
+void median_filter(const Image<uint16_t> &in, Image<uint16_t> &out, int size, int n_threads) {
+
+    if (size != 3 && size != 5)
+        mFatal() << "Median filter size must be 3 or 5";
+
+    const int width = in.cols(), height = in.rows();
+    const int radius = size / 2, n_values = size * size;
+
+    // the window is padded to a power of two with maximal values, which leaves the median in place
+    const int n_network = (size == 3) ? 16 : 32;
+    const int median = n_values / 2;
+    const std::vector<Comparator> network = selection_network(n_network, median);
+
+    Image<uint16_t> copy;
+    const uint16_t *source = filter_source(in, out, copy);
+    out.resize(height, width);
+
+    parallel_for(0, height, [&](int y) {
+
+        std::vector<uint16_t> rows;
+        padded_rows(source, width, height, y, radius, rows);
+        const int padded_width = width + 2 * radius;
+
+        std::vector<uint16_t> values((size_t)n_network * lanes);
+
+        for (int x0 = 0;x0 < width;x0 += lanes) {
+
+            const int n = std::min(lanes, width - x0);
+            std::fill(values.begin() + (size_t)n_values * lanes, values.end(), 0xffff);
+            const uint16_t *center = rows.data() + (size_t)radius * padded_width + radius + x0;
+
+            for (int dy = 0;dy < size;dy++) {
+                for (int dx = 0;dx < size;dx++) {
+                    const uint16_t *neighbour = rows.data() + (size_t)dy * padded_width + dx + x0;
+                    uint16_t *v = values.data() + (size_t)(dy * size + dx) * lanes;
+                    for (int i = 0;i < n;i++) v[i] = (neighbour[i] != 0) ? neighbour[i] : center[i];
+                }
+            }
+
+            for (const Comparator &comparator : network) {
+                uint16_t *a = values.data() + (size_t)comparator.first * lanes, *b = values.data() + (size_t)comparator.second * lanes;
+                for (int i = 0;i < lanes;i++) {
+                    uint16_t low = std::min(a[i], b[i]), high = std::max(a[i], b[i]);
+                    a[i] = low;
+                    b[i] = high;
+                }
+            }
+
+            const uint16_t *result = values.data() + (size_t)median * lanes;
+            uint16_t *dst = out.data() + y * width + x0;
+            for (int i = 0;i < n;i++) dst[i] = (center[i] != 0) ? result[i] : 0;
+
+        }
+
+    }, 4, n_threads);
+
+}
+
+void bilateral_filter(const Image<uint16_t> &in, Image<uint16_t> &out, Scalar sigma_space, Scalar sigma_depth, int n_threads) {
+
+    const int width = in.cols(), height = in.rows();
+    const int radius = std::max(1, (int)std::ceil(2 * sigma_space));
+    const int window = 2 * radius + 1;
+
+    std::vector<float> space_weights(window * window);
+    for (int dy = -radius;dy <= radius;dy++) {
+        for (int dx = -radius;dx <= radius;dx++) {
+            space_weights[(dy + radius) * window + dx + radius] = std::exp(-0.5f * (dx * dx + dy * dy) / (sigma_space * sigma_space));
+        }
+    }
+
+    // depth differences are integers, so the range weights are tabulated out to 4 sigma;
+    // the last entry is 0, for larger differences
+    const int max_difference = std::min(65535, (int)std::ceil(4 * sigma_depth) + 1);
+    std::vector<float> depth_weights(max_difference + 1, 0.0f);
+    for (int d = 0;d < max_difference;d++) {
+        depth_weights[d] = std::exp(-0.5f * d * d / (sigma_depth * sigma_depth));
+    }
+
+    Image<uint16_t> copy;
+    const uint16_t *source = filter_source(in, out, copy);
+    out.resize(height, width);
+
+    parallel_for(0, height, [&](int y) {
+
+        std::vector<uint16_t> rows;
+        padded_rows(source, width, height, y, radius, rows);
+        const int padded_width = width + 2 * radius;
+
+        float sum[lanes], weight_sum[lanes];
+
+        for (int x0 = 0;x0 < width;x0 += lanes) {
+
+            const int n = std::min(lanes, width - x0);
+            const uint16_t *center = rows.data() + (size_t)radius * padded_width + radius + x0;
+            std::fill(sum, sum + lanes, 0.0f);
+            std::fill(weight_sum, weight_sum + lanes, 0.0f);
+
+            for (int dy = 0;dy < window;dy++) {
+                for (int dx = 0;dx < window;dx++) {
+                    const uint16_t *neighbour = rows.data() + (size_t)dy * padded_width + dx + x0;
+                    const float space_weight = space_weights[dy * window + dx];
+                    for (int i = 0;i < n;i++) {
+                        // missing depth (0) has no weight
+                        int difference = std::min(std::abs((int)neighbour[i] - (int)center[i]), max_difference);
+                        float weight = (neighbour[i] != 0) ? space_weight * depth_weights[difference] : 0.0f;
+                        sum[i] += weight * neighbour[i];
+                        weight_sum[i] += weight;
+                    }
+                }
+            }
+
+            // the center has full weight if valid, so the sum is only empty for missing pixels
+            uint16_t *dst = out.data() + y * width + x0;
+            for (int i = 0;i < n;i++) {
+                dst[i] = (center[i] != 0) ? (uint16_t)std::min(sum[i] / weight_sum[i] + 0.5f, 65535.0f) : 0;
+            }
+
+        }
+
+    }, 4, n_threads);
+
+}
+
+void fill_holes(const Image<uint16_t> &in, Image<uint16_t> &out, int iterations, int n_threads) {
+
+    const int width = in.cols(), height = in.rows();
+
+    Image<uint16_t> current = in, next(height, width);
+
+    for (int pass = 0;pass < iterations;pass++) {
+
+        parallel_for(0, height, [&](int y) {
+
+            const uint16_t *above = current.data() + clamp_index(y - 1, height) * width;
+            const uint16_t *row = current.data() + y * width;
+            const uint16_t *below = current.data() + clamp_index(y + 1, height) * width;
+            uint16_t *dst = next.data() + y * width;
+
+            // missing depth is 0, so the maximum is the farthest valid neighbour
+            for (int x = 0;x < width;x++) {
+                int left = std::max(x - 1, 0), right = std::min(x + 1, width - 1);
+                uint16_t farthest = std::max(std::max(std::max(above[left], above[x]), std::max(above[right], row[left])),
+                                             std::max(std::max(row[right], below[left]), std::max(below[x], below[right])));
+                dst[x] = (row[x] != 0) ? row[x] : farthest;
+            }
+
+        }, 8, n_threads);
+
+        current.swap(next);
+
+    }
+
+    out.swap(current);
+
+}
+
+void downsample(const Image<uint16_t> &in, Image<uint16_t> &out, int max_difference, int n_threads) {
+
+    const int width = in.cols(), height = in.rows();
+    const int half_width = (width + 1) / 2, half_height = (height + 1) / 2;
+
+    Image<uint16_t> half(half_height, half_width);
+
+    parallel_for(0, half_height, [&](int y) {
+
+        const uint16_t *row0 = in.data() + 2 * y * width;
+        const uint16_t *row1 = in.data() + std::min(2 * y + 1, height - 1) * width;
+        uint16_t *dst = half.data() + y * half_width;
+
+        for (int x = 0;x < half_width;x++) {
+
+            int x0 = 2 * x, x1 = std::min(2 * x + 1, width - 1);
+            const int block[4] = { row0[x0], row0[x1], row1[x0], row1[x1] };
+
+            int nearest = 0x10000;
+            for (int k = 0;k < 4;k++) {
+                if (block[k] != 0) nearest = std::min(nearest, block[k]);
+            }
+
+            int sum = 0, count = 0;
+            for (int k = 0;k < 4;k++) {
+                bool used = block[k] != 0 && block[k] - nearest <= max_difference;
+                sum += used ? block[k] : 0;
+                count += used ? 1 : 0;
+            }
+
+            dst[x] = (count > 0) ? (uint16_t)((sum + count / 2) / count) : 0;
+
+        }
+
+    }, 8, n_threads);
+
+    out.swap(half);
+
+}
+
+std::vector<Image<uint16_t>> pyramid(const Image<uint16_t> &in, int levels, int max_difference, int n_threads) {
+    std::vector<Image<uint16_t>> result(1, in);
+    while ((int)result.size() < levels && (result.back().rows() > 1 || result.back().cols() > 1)) {
+        Image<uint16_t> half;
+        downsample(result.back(), half, max_difference, n_threads);
+        result.push_back(std::move(half));
+    }
+    return result;
+}
+
+//=============================================================================
+} // OpenGP::
+//=============================================================================
@@ -0,0 +1,113 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <type_traits>
+
+#include <OpenGP/headeronly.h>
+#include <OpenGP/types.h>
+#include <OpenGP/Image/ImageType.h>
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+/// @file
+/// Image filters, multithreaded over rows and vectorized along them. Color filters take
+/// images of packed float samples (`Image<float>`, `Image<Vec3>`, `Image<Vec4>`, ...).
+/// Depth filters take `Image<uint16_t>` where 0 marks missing depth: missing pixels stay
+/// missing and never contribute to their neighbours. Borders are extended by replication.
+/// The output may be the input image. A thread count of 0 uses all hardware threads.
+
+namespace internal {
+
+    HEADERONLY_INLINE void gaussian_blur(const float *in, float *out, int width, int height, int channels, Scalar sigma, int n_threads);
+    HEADERONLY_INLINE void box_blur(const float *in, float *out, int width, int height, int channels, int radius, int n_threads);
+    HEADERONLY_INLINE void downsample(const float *in, float *out, int width, int height, int channels, int n_threads);
+
+    template <typename ImageType>
+    constexpr bool is_float_image() {
+        return std::is_same<typename ImageTypeInfo<ImageType>::Scalar, float>::value &&
+               sizeof(typename ImageType::Scalar) == ImageTypeInfo<ImageType>::component_count * sizeof(float);
+    }
+
+}
+
+/// Separable Gaussian blur, the kernel reaches out to 3 sigma
+template <typename ImageType>
+void gaussian_blur(const ImageType &in, ImageType &out, Scalar sigma, int n_threads = 0) {
+    static_assert(internal::is_float_image<ImageType>(), "Filters need pixels of packed float samples");
+    out.resize(in.rows(), in.cols());
+    internal::gaussian_blur((const float*)in.data(), (float*)out.data(), in.cols(), in.rows(), ImageTypeInfo<ImageType>::component_count, sigma, n_threads);
+}
+
+/// Mean over the (2 radius + 1)^2 window around every pixel
+template <typename ImageType>
+void box_blur(const ImageType &in, ImageType &out, int radius, int n_threads = 0) {
+    static_assert(internal::is_float_image<ImageType>(), "Filters need pixels of packed float samples");
+    out.resize(in.rows(), in.cols());
+    internal::box_blur((const float*)in.data(), (float*)out.data(), in.cols(), in.rows(), ImageTypeInfo<ImageType>::component_count, radius, n_threads);
+}
+
+/// Half size image, the mean of every 2 x 2 block (a last odd row or column is averaged with itself)
+template <typename ImageType>
+void downsample(const ImageType &in, ImageType &out, int n_threads = 0) {
+    static_assert(internal::is_float_image<ImageType>(), "Filters need pixels of packed float samples");
+    ImageType half((in.rows() + 1) / 2, (in.cols() + 1) / 2);
+    internal::downsample((const float*)in.data(), (float*)half.data(), in.cols(), in.rows(), ImageTypeInfo<ImageType>::component_count, n_threads);
+    out.swap(half);
+}
+
+/// Gaussian pyramid: the image, then up to `levels - 1` blurred and downsampled ones (down to 1 x 1)
+template <typename ImageType>
+std::vector<ImageType> pyramid(const ImageType &in, int levels, int n_threads = 0) {
+    std::vector<ImageType> result(1, in);
+    while ((int)result.size() < levels && (result.back().rows() > 1 || result.back().cols() > 1)) {
+        ImageType blurred;
+        gaussian_blur(result.back(), blurred, Scalar(1), n_threads);
+        result.emplace_back();
+        downsample(blurred, result.back(), n_threads);
+    }
+    return result;
+}
+
+/// Gaussian blur of depth, normalized over the valid pixels of the window
+HEADERONLY_INLINE void gaussian_blur(const Image<uint16_t> &in, Image<uint16_t> &out, Scalar sigma, int n_threads = 0);
+
+/// Mean of the valid depth in the (2 radius + 1)^2 window
+HEADERONLY_INLINE void box_blur(const Image<uint16_t> &in, Image<uint16_t> &out, int radius, int n_threads = 0);
+
+/// @brief Median of the 3 x 3 (`size` 3) or 5 x 5 (`size` 5) window, computed with a sorting network
+/// @note Missing neighbours count as the center depth, so the median stays with valid depth.
+HEADERONLY_INLINE void median_filter(const Image<uint16_t> &in, Image<uint16_t> &out, int size, int n_threads = 0);
+
+/// @brief Edge-preserving smoothing of depth
+/// @param sigma_space spatial standard deviation in pixels (the window reaches 2 sigma)
+/// @param sigma_depth standard deviation of depth differences, in depth units
+HEADERONLY_INLINE void bilateral_filter(const Image<uint16_t> &in, Image<uint16_t> &out, Scalar sigma_space, Scalar sigma_depth, int n_threads = 0);
+
+/// @brief Fill holes from their borders, by up to `iterations` pixels
+/// @note Each pass gives missing pixels the farthest valid depth among their 8 neighbours:
+/// holes mostly come from occlusion boundaries, where the background is the right guess.
+HEADERONLY_INLINE void fill_holes(const Image<uint16_t> &in, Image<uint16_t> &out, int iterations, int n_threads = 0);
+
+/// @brief Half size depth, the mean of every 2 x 2 block
+/// @note Only the valid pixels within `max_difference` of the nearest one in the block are
+/// averaged, so that depth discontinuities are not blurred into phantom surfaces.
+HEADERONLY_INLINE void downsample(const Image<uint16_t> &in, Image<uint16_t> &out, int max_difference, int n_threads = 0);
+
+/// Depth pyramid: the image, then up to `levels - 1` downsampled ones
+HEADERONLY_INLINE std::vector<Image<uint16_t>> pyramid(const Image<uint16_t> &in, int levels, int max_difference, int n_threads = 0);
+
+//=============================================================================
+} // namespace OpenGP
+//=============================================================================
+
+#ifdef HEADERONLY
+    #include "ImageFilters.cpp"
+#endif
@@ -0,0 +1,423 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdio.h>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+#ifdef USE_PNG
+#include <zlib.h>
+#elif !defined(HEADERONLY)
+#include <OpenGP/external/LodePNG/lodepng.h>
+#endif
+
+#include "PNGEncoder.h"
+
+#include <OpenGP/MLogger.h>
+#include <OpenGP/util/parallel_for.h>
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+namespace {
+
+    const size_t png_window_size = 32768;
+
+    void append_be32(std::vector<uint8_t> &out, uint32_t value) {
+        uint8_t bytes[4] = { (uint8_t)(value >> 24), (uint8_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value };
+        out.insert(out.end(), bytes, bytes + 4);
+    }
+
+    uint32_t png_crc32(const uint8_t *data, size_t size) {
+#ifdef USE_PNG
+        return (uint32_t)crc32(crc32(0, Z_NULL, 0), data, (uInt)size);
+#elif !defined(HEADERONLY)
+        return lodepng_crc32(data, size);
+#else
+        (void)data; (void)size;
+        return 0;
+#endif
+    }
+
+    void append_chunk(std::vector<uint8_t> &png, const char *type, const uint8_t *data, size_t size) {
+        append_be32(png, (uint32_t)size);
+        size_t start = png.size();
+        png.insert(png.end(), type, type + 4);
+        png.insert(png.end(), data, data + size);
+        append_be32(png, png_crc32(png.data() + start, size + 4));
+    }
+
+    int paeth_predictor(int a, int b, int c) {
+        int p = a + b - c;
+        int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+        if (pa <= pb && pa <= pc) return a;
+        return (pb <= pc) ? b : c;
+    }
+
+    /// Filter `row` against the row above (`prev`, zeros for the first row) into `out`
+    void filter_row(PNGFilter type, const uint8_t *row, const uint8_t *prev, size_t n, int bpp, uint8_t *out) {
+        switch (type) {
+            case PNGFilter::None:
+                std::memcpy(out, row, n);
+                break;
+            case PNGFilter::Sub:
+                for (size_t i = 0;i < n;i++) out[i] = row[i] - (i >= (size_t)bpp ? row[i - bpp] : 0);
+                break;
+            case PNGFilter::Up:
+                for (size_t i = 0;i < n;i++) out[i] = row[i] - prev[i];
+                break;
+            case PNGFilter::Average:
+                for (size_t i = 0;i < n;i++) out[i] = row[i] - ((i >= (size_t)bpp ? row[i - bpp] : 0) + prev[i]) / 2;
+                break;
+            default:
+                for (size_t i = 0;i < n;i++) {
+                    int a = (i >= (size_t)bpp) ? row[i - bpp] : 0, c = (i >= (size_t)bpp) ? prev[i - bpp] : 0;
+                    out[i] = row[i] - paeth_predictor(a, prev[i], c);
+                }
+                break;
+        }
+    }
+
+    /// Sum of the filtered bytes as signed values, the usual heuristic for the best filter
+    size_t filter_cost(const uint8_t *filtered, size_t n) {
+        size_t cost = 0;
+        for (size_t i = 0;i < n;i++) cost += (filtered[i] < 128) ? filtered[i] : 256 - filtered[i];
+        return cost;
+    }
+
+    /// Copy a row to `out` with 16 bit samples in big endian byte order
+    const uint8_t *big_endian_row(const uint8_t *row, size_t n, int bit_depth, uint8_t *out) {
+        const uint16_t one = 1;
+        if (bit_depth != 16 || *(const uint8_t*)&one == 0) return row;
+        for (size_t i = 0;i + 1 < n;i += 2) {
+            out[i] = row[i + 1];
+            out[i + 1] = row[i];
+        }
+        return out;
+    }
+
+}
+
+int PNGEncoder::rows_per_band() const {
+    size_t row_bytes = (size_t)width * components * (bit_depth / 8);
+    return (band_rows > 0) ? band_rows : std::max(1, (int)((256 << 10) / std::max(row_bytes, (size_t)1)));
+}
+
+int PNGEncoder::batch_rows() const {
+    return rows_per_band() * ((n_threads > 0) ? n_threads : hardware_threads());
+}
+
+bool PNGEncoder::output_chunk(const char *type, const uint8_t *data, size_t size) {
+    std::vector<uint8_t> chunk;
+    append_chunk(chunk, type, data, size);
+    if (!failed && !output(chunk.data(), chunk.size())) failed = true;
+    return !failed;
+}
+
+bool PNGEncoder::begin(int width, int height, int components, int bit_depth, const OutputFunction &output) {
+
+    static const uint8_t color_types[] = { 0, 4, 2, 6 }; // gray, gray + alpha, RGB, RGBA
+
+    if (components < 1 || components > 4 || (bit_depth != 8 && bit_depth != 16) || width <= 0 || height <= 0)
+        return false;
+
+    this->width = width;
+    this->height = height;
+    this->components = components;
+    this->bit_depth = bit_depth;
+    this->output = output;
+    rows_added = 0;
+    failed = false;
+    prev_row.assign((size_t)width * components * (bit_depth / 8), 0);
+    filtered.clear();
+    dictionary_size = 0;
+    checksum = 1;
+    stream_started = false;
+
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    if (!output(signature, 8)) {
+        failed = true;
+        return false;
+    }
+
+    std::vector<uint8_t> header;
+    append_be32(header, (uint32_t)width);
+    append_be32(header, (uint32_t)height);
+    header.push_back((uint8_t)bit_depth);
+    header.push_back(color_types[components - 1]);
+    header.push_back(0); // deflate
+    header.push_back(0); // adaptive filtering
+    header.push_back(0); // no interlace
+
+    return output_chunk("IHDR", header.data(), header.size());
+
+}
+
+bool PNGEncoder::add_rows(const void *pixels, size_t row_stride, int n_rows) {
+
+    if (failed || output == nullptr || n_rows < 0 || rows_added + n_rows > height)
+        return false;
+
+    const size_t row_bytes = prev_row.size();
+    const int bpp = components * (bit_depth / 8);
+    const int band = rows_per_band(), batch = batch_rows();
+
+    // a batch at a time, so that memory use stays bounded for large calls
+    for (int first = 0;first < n_rows;first += batch) {
+
+        const uint8_t *rows = (const uint8_t*)pixels + first * row_stride;
+        const int count = std::min(batch, n_rows - first);
+        const int n_bands = (count + band - 1) / band;
+
+        // --- filter the bands: a filter type byte followed by the filtered row
+
+        size_t offset = filtered.size();
+        filtered.resize(offset + (row_bytes + 1) * count);
+
+        parallel_for(0, n_bands, [&](int b) {
+
+            std::vector<uint8_t> row_swapped(row_bytes), prev_swapped(row_bytes);
+            std::vector<uint8_t> candidate(filter == PNGFilter::Adaptive ? row_bytes : 0);
+
+            int r0 = b * band, r1 = std::min(r0 + band, count);
+            const uint8_t *prev = (r0 == 0) ? prev_row.data() :
+                big_endian_row(rows + (r0 - 1) * row_stride, row_bytes, bit_depth, prev_swapped.data());
+
+            for (int r = r0;r < r1;r++) {
+
+                const uint8_t *row = big_endian_row(rows + r * row_stride, row_bytes, bit_depth, row_swapped.data());
+                uint8_t *out = filtered.data() + offset + r * (row_bytes + 1);
+
+                PNGFilter type = filter;
+                if (filter == PNGFilter::Adaptive) {
+                    size_t best_cost = SIZE_MAX;
+                    for (int f = 0;f < 5;f++) {
+                        filter_row((PNGFilter)f, row, prev, row_bytes, bpp, candidate.data());
+                        size_t cost = filter_cost(candidate.data(), row_bytes);
+                        if (cost < best_cost) {
+                            best_cost = cost;
+                            type = (PNGFilter)f;
+                            std::memcpy(out + 1, candidate.data(), row_bytes);
+                        }
+                    }
+                } else {
+                    filter_row(type, row, prev, row_bytes, bpp, out + 1);
+                }
+                out[0] = (uint8_t)type;
+
+                // the swapped copy of this row becomes the previous row
+                if (row == row_swapped.data()) std::swap(row_swapped, prev_swapped);
+                prev = row;
+
+            }
+
+        }, 1, n_threads);
+
+        const uint8_t *last = big_endian_row(rows + (count - 1) * row_stride, row_bytes, bit_depth, prev_row.data());
+        if (last != prev_row.data()) std::memcpy(prev_row.data(), last, row_bytes);
+
+        rows_added += count;
+
+#ifdef USE_PNG
+        // rows are compressed in whole batches, small calls are collected first
+        if (filtered.size() - dictionary_size >= (size_t)batch * (row_bytes + 1) && !compress(false))
+            return false;
+#endif
+
+    }
+
+    return true;
+
+}
+
+bool PNGEncoder::compress(bool last) {
+
+    // --- deflate the pending rows, appending to one zlib stream
+
+    std::vector<uint8_t> zlib_stream;
+
+#ifdef USE_PNG
+
+    int level = std::min(std::max(compression_level, 0), 9);
+
+    if (!stream_started) {
+        // zlib header: deflate with a 32 KiB window, compression level hint, check bits
+        int level_hint = (level < 2) ? 0 : (level < 6) ? 1 : (level == 6) ? 2 : 3;
+        uint8_t cmf = 0x78, flg = (uint8_t)(level_hint << 6);
+        flg += 31 - (cmf * 256 + flg) % 31;
+        zlib_stream.push_back(cmf);
+        zlib_stream.push_back(flg);
+        stream_started = true;
+    }
+
+    const size_t row_bytes = prev_row.size();
+    const size_t band_bytes = (size_t)rows_per_band() * (row_bytes + 1);
+    const size_t pending = filtered.size() - dictionary_size;
+    const int n_bands = std::max(1, (int)((pending + band_bytes - 1) / band_bytes));
+
+    // offset of a band in the filtered data
+    auto band_offset = [&](int band) { return dictionary_size + std::min(band * band_bytes, pending); };
+
+    std::vector<std::vector<uint8_t>> deflated(n_bands);
+    std::vector<uLong> checksums(n_bands);
+    std::vector<char> band_failed(n_bands, 0);
+
+    parallel_for(0, n_bands, [&](int band) {
+
+        size_t begin = band_offset(band), end = band_offset(band + 1);
+        bool final_band = last && (band == n_bands - 1);
+
+        z_stream stream;
+        std::memset(&stream, 0, sizeof(stream));
+        // raw deflate, the zlib header and checksum are written around the bands
+        if (deflateInit2(&stream, level, Z_DEFLATED, -15, 8, (filter == PNGFilter::None) ? Z_DEFAULT_STRATEGY : Z_FILTERED) != Z_OK) {
+            band_failed[band] = 1;
+            return;
+        }
+
+        if (begin > 0) {
+            size_t dictionary = std::min(begin, png_window_size);
+            deflateSetDictionary(&stream, filtered.data() + begin - dictionary, (uInt)dictionary);
+        }
+
+        std::vector<uint8_t> &out = deflated[band];
+        out.resize(deflateBound(&stream, (uLong)(end - begin)) + 16);
+
+        stream.next_in = filtered.data() + begin;
+        stream.avail_in = (uInt)(end - begin);
+        stream.next_out = out.data();
+        stream.avail_out = (uInt)out.size();
+
+        // the sync flush ends the band on a byte boundary with a non-final block
+        int status = deflate(&stream, final_band ? Z_FINISH : Z_SYNC_FLUSH);
+        if (status == Z_STREAM_ERROR || stream.avail_in != 0 || (final_band && status != Z_STREAM_END)) band_failed[band] = 1;
+
+        out.resize(out.size() - stream.avail_out);
+        deflateEnd(&stream);
+
+        checksums[band] = adler32(adler32(0, Z_NULL, 0), filtered.data() + begin, (uInt)(end - begin));
+
+    }, 1, n_threads);
+
+    if (std::find(band_failed.begin(), band_failed.end(), 1) != band_failed.end()) {
+        failed = true;
+        return false;
+    }
+
+    uLong combined = checksum;
+    for (int band = 0;band < n_bands;band++) {
+        zlib_stream.insert(zlib_stream.end(), deflated[band].begin(), deflated[band].end());
+        combined = adler32_combine(combined, checksums[band], (z_off_t)(band_offset(band + 1) - band_offset(band)));
+    }
+    checksum = (uint32_t)combined;
+    if (last) append_be32(zlib_stream, checksum);
+
+    // keep the end of the compressed rows as dictionary for the next ones
+    dictionary_size = std::min(filtered.size(), png_window_size);
+    filtered.erase(filtered.begin(), filtered.end() - dictionary_size);
+
+#elif !defined(HEADERONLY)
+
+    // LodePNG has no flush, the filtered image is deflated in one piece
+    if (!last)
+        return true;
+
+    LodePNGCompressSettings settings;
+    lodepng_compress_settings_init(&settings);
+    if (compression_level <= 0) {
+        settings.btype = 0;
+    } else {
+        settings.windowsize = (compression_level < 7) ? 2048 : 32768;
+        settings.lazymatching = (compression_level >= 4);
+        settings.nicematch = (compression_level < 7) ? 128 : 258;
+    }
+
+    unsigned char *out = nullptr;
+    size_t out_size = 0;
+    unsigned err = lodepng_zlib_compress(&out, &out_size, filtered.data(), filtered.size(), &settings);
+    if (!err) zlib_stream.assign(out, out + out_size);
+    free(out);
+    if (err) {
+        failed = true;
+        return false;
+    }
+
+    std::vector<uint8_t>().swap(filtered);
+
+#else
+
+    (void)last;
+    mFatal() << "PNG support is not availible: to enable PNG support in header-only mode, define USE_PNG and include libpng in your build system";
+    return false;
+
+#endif
+
+    const size_t max_chunk = 1 << 20;
+    for (size_t offset = 0;offset < zlib_stream.size();offset += max_chunk) {
+        if (!output_chunk("IDAT", zlib_stream.data() + offset, std::min(max_chunk, zlib_stream.size() - offset)))
+            return false;
+    }
+
+    return true;
+
+}
+
+bool PNGEncoder::finish() {
+
+    if (failed || output == nullptr || rows_added != height)
+        return false;
+
+    bool ok = compress(true) && output_chunk("IEND", nullptr, 0);
+
+    output = nullptr;
+    std::vector<uint8_t>().swap(filtered);
+
+    return ok;
+
+}
+
+bool PNGEncoder::encode(const void *pixels, size_t row_stride, int width, int height, int components, int bit_depth,
+                        std::vector<uint8_t> &png) const {
+
+    png.clear();
+
+    PNGEncoder encoder = *this;
+    auto append = [&](const uint8_t *data, size_t size) {
+        png.insert(png.end(), data, data + size);
+        return true;
+    };
+
+    return encoder.begin(width, height, components, bit_depth, append) &&
+           encoder.add_rows(pixels, row_stride, height) &&
+           encoder.finish();
+
+}
+
+bool PNGEncoder::write(const std::string &path, const void *pixels, size_t row_stride, int width, int height, int components, int bit_depth) const {
+
+    FILE *fid = fopen(path.c_str(), "wb");
+    if (fid == nullptr)
+        return false;
+
+    // written as it is encoded
+    PNGEncoder encoder = *this;
+    auto write_bytes = [&](const uint8_t *data, size_t size) {
+        return fwrite(data, 1, size, fid) == size;
+    };
+
+    bool ok = encoder.begin(width, height, components, bit_depth, write_bytes) &&
+              encoder.add_rows(pixels, row_stride, height) &&
+              encoder.finish();
+    ok = (fclose(fid) == 0) && ok;
+
+    return ok;
+
+}
+
+//=============================================================================
+} // OpenGP::
+//=============================================================================
@@ -0,0 +1,106 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+
+#include <OpenGP/headeronly.h>
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+/// PNG row filter, or `Adaptive` to pick the best one per row (minimum sum of absolute differences)
+enum class PNGFilter {
+    None = 0,
+    Sub = 1,
+    Up = 2,
+    Average = 3,
+    Paeth = 4,
+    Adaptive = 5
+};
+
+/// @brief Multithreaded PNG encoder
+/// @note The image is cut into bands of rows that are filtered and deflated on worker
+/// threads. Every band but the last is flushed to a byte boundary, and every band but the
+/// first is primed with the last 32 KiB of the one before as dictionary, so the bands
+/// concatenate into one valid zlib stream (as pigz does) that is about as small as a
+/// serial one. Deflating in parallel needs zlib (`USE_PNG`); with LodePNG only the
+/// filtering runs in parallel.
+///
+/// Images can also be encoded incrementally with `begin`, `add_rows` and `finish`: with
+/// zlib only about `batch_rows()` rows are held at a time, so images larger than memory
+/// can be written. LodePNG cannot compress incrementally and keeps the filtered image.
+class PNGEncoder {
+public:
+
+    /// Receives the encoded bytes in order, returns false to abort
+    using OutputFunction = std::function<bool(const uint8_t*, size_t)>;
+
+    /// zlib compression level, 0 (store) to 9 (smallest)
+    int compression_level = 6;
+
+    PNGFilter filter = PNGFilter::Adaptive;
+
+    /// Worker threads (0 uses all hardware threads)
+    int n_threads = 0;
+
+    /// Rows per band (0 picks bands of about 256 KiB of pixel data)
+    int band_rows = 0;
+
+    /// @brief Encode rows of `width * components` interleaved samples, `row_stride` bytes apart
+    /// @param bit_depth 8 (uint8_t samples) or 16 (uint16_t samples in host byte order)
+    /// @return false if the format is not supported by PNG or compression failed
+    HEADERONLY_INLINE bool encode(const void *pixels, size_t row_stride, int width, int height, int components, int bit_depth,
+                                  std::vector<uint8_t> &png) const;
+
+    /// Encode as above and write the file
+    HEADERONLY_INLINE bool write(const std::string &path, const void *pixels, size_t row_stride, int width, int height, int components, int bit_depth) const;
+
+    /// Start an incremental encoding, the PNG header is passed to `output` right away
+    HEADERONLY_INLINE bool begin(int width, int height, int components, int bit_depth, const OutputFunction &output);
+
+    /// Encode the next `n_rows` rows, `row_stride` bytes apart
+    HEADERONLY_INLINE bool add_rows(const void *pixels, size_t row_stride, int n_rows);
+
+    /// Complete the image once all rows were added
+    HEADERONLY_INLINE bool finish();
+
+    /// Rows compressed together, one band per thread: the best amount to pass to `add_rows`
+    HEADERONLY_INLINE int batch_rows() const;
+
+private:
+
+    HEADERONLY_INLINE int rows_per_band() const;
+    HEADERONLY_INLINE bool compress(bool last);
+    HEADERONLY_INLINE bool output_chunk(const char *type, const uint8_t *data, size_t size);
+
+    int width = 0, height = 0, components = 0, bit_depth = 0;
+    int rows_added = 0;
+    OutputFunction output;
+    bool failed = false;
+
+    std::vector<uint8_t> prev_row; ///< last added row, 16 bit samples in big endian byte order
+
+    /// Filtered rows: the tail of the compressed ones (the dictionary) and the pending ones
+    std::vector<uint8_t> filtered;
+    size_t dictionary_size = 0;
+    uint32_t checksum = 1;
+    bool stream_started = false;
+
+};
+
+//=============================================================================
+} // namespace OpenGP
+//=============================================================================
+
+#ifdef HEADERONLY
+    #include "PNGEncoder.cpp"
+#endif
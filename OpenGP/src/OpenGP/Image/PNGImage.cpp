@@ -3,6 +3,8 @@
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 #include <stdio.h>
+#include <vector>
+#include <cstring>
 
 #ifdef USE_PNG
 #include <png.h>
@@ -18,6 +20,24 @@
 namespace OpenGP {
 //=============================================================================
 
+namespace {
+
+    bool host_is_little_endian() {
+        const uint16_t one = 1;
+        return *(const uint8_t*)&one == 1;
+    }
+
+    /// Swap the bytes of `count` 16 bit samples (in place if `in == out`)
+    void swap_bytes_16(const uint8_t *in, uint8_t *out, size_t count) {
+        for (size_t i = 0;i < count;i++) {
+            uint8_t high = in[2 * i];
+            out[2 * i] = in[2 * i + 1];
+            out[2 * i + 1] = high;
+        }
+    }
+
+}
+
 #ifdef USE_PNG
 
 namespace {
@@ -27,14 +47,7 @@ namespace {
         FILE *fid = nullptr;
         png_struct *read_struct = nullptr;
         png_info *info_struct = nullptr;
-
-    };
-
-    struct PNGWriterData {
-
-        FILE *fid = nullptr;
-        png_struct *write_struct = nullptr;
-        png_info *info_struct = nullptr;
+        int passes = 1; ///< more than one for interlaced images
 
     };
 
@@ -86,161 +99,57 @@ PNGReader::PNGReader(const std::string &path) {
 
     png_read_info(read_struct, info_struct);
 
+    // expand palettes, low bit depth gray and transparency keys to 8 bit samples,
+    // 16 bit samples are delivered in host byte order
+    png_set_expand(read_struct);
+    if (png_get_bit_depth(read_struct, info_struct) == 16 && host_is_little_endian())
+        png_set_swap(read_struct);
+    data->passes = png_set_interlace_handling(read_struct);
+    png_read_update_info(read_struct, info_struct);
+
     width = png_get_image_width(read_struct, info_struct);
     height = png_get_image_height(read_struct, info_struct);
     components = png_get_channels(read_struct, info_struct);
+    bit_depth = png_get_bit_depth(read_struct, info_struct);
 
 }
 
-void PNGReader::read(const ReadFunction &read_function) {
+void PNGReader::read_into(void *buffer, size_t row_stride) {
 
     PNGReaderData *data = (PNGReaderData*)private_data;
 
-    using filep = FILE*;
-
-    filep &fid = data->fid;
-    png_structp &read_struct = data->read_struct;
-    png_infop &info_struct = data->info_struct;
-
-    int passes = png_set_interlace_handling(read_struct);
-    png_read_update_info(read_struct, info_struct);
-
-    Eigen::Matrix<uint8_t*, Eigen::Dynamic, Eigen::Dynamic> row_ptrs(height, 1);
+    std::vector<uint8_t*> row_ptrs(height);
     for (int i = 0;i < height;i++) {
-        row_ptrs(i) = (uint8_t*)malloc(png_get_rowbytes(read_struct, info_struct));
-    }
-
-    png_read_image(read_struct, row_ptrs.data());
-
-    int bit_depth = png_get_bit_depth(read_struct, info_struct);
-    int row_width = components * width * 8;
-
-    for (int row=0;row < height;row++) {
-        for (int col=0;col < width;col++) {
-            for (int c=0;c < components;c++) {
-
-                uint32_t int_val = 0;
-
-                int start_idx = (components * col + c) * (bit_depth / 8);
-                for (int i=0;i < bit_depth / 8;i++) {
-                    int_val <<= 8;
-                    int_val |= row_ptrs(row)[start_idx + i];
-                }
-
-                double val = ((double)int_val) / ((((uint64_t)0x1) << bit_depth) - 1);
-                read_function(row, col, c, val);
-            }
-        }
-    }
-
-    for (int i = 0;i < height;i++) {
-        free(row_ptrs(i));
-    }
-
-}
-
-PNGWriter::PNGWriter(const std::string &path) {
-
-    private_data = new PNGWriterData();
-
-    PNGWriterData *data = (PNGWriterData*)private_data;
-
-    using filep = FILE*;
-
-    filep &fid = data->fid;
-
-    fid = fopen(path.c_str(), "wb");
-    if (fid == nullptr)
-        mFatal() << "Could not open file";
-
-}
-
-PNGWriter::~PNGWriter() {
-
-    PNGWriterData *data = (PNGWriterData*)private_data;
-
-    if (data != nullptr) {
-        if (data->write_struct != nullptr) {
-            png_destroy_write_struct(&(data->write_struct), &(data->info_struct));
-        }
-        fclose(data->fid);
+        row_ptrs[i] = (uint8_t*)buffer + i * row_stride;
     }
 
-    delete data;
+    png_read_image(data->read_struct, row_ptrs.data());
 
 }
 
-void PNGWriter::write(const WriteFunction &write_function) {
+void PNGReader::read_rows(const RowFunction &row_function) {
 
-    PNGWriterData *data = (PNGWriterData*)private_data;
-
-    using filep = FILE*;
-
-    filep &fid = data->fid;
-    png_structp &write_struct = data->write_struct;
-    png_infop &info_struct = data->info_struct;
-
-    write_struct = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
-    info_struct = png_create_info_struct(write_struct);
-
-    png_init_io(write_struct, fid);
-
-    uint8_t color_type;
-
-    if (components == 1) {
-        color_type = PNG_COLOR_TYPE_GRAY;
-    } else if (components == 3) {
-        color_type = PNG_COLOR_TYPE_RGB;
-    } else if (components == 4) {
-        color_type = PNG_COLOR_TYPE_RGB_ALPHA;
-    } else {
-        mFatal() << "Unsupported PNG color type";
-    }
-
-    if (!(bit_depth == 8 || bit_depth == 16)) {
-        bit_depth = 16;
-    }
-
-    png_set_IHDR(write_struct, info_struct, width, height,
-                     bit_depth, color_type, PNG_INTERLACE_NONE,
-                     PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
-
-
-    png_write_info(write_struct, info_struct);
-
-    Eigen::Matrix<uint8_t*, Eigen::Dynamic, Eigen::Dynamic> row_ptrs(height, 1);
-    for (int i = 0;i < height;i++) {
-        row_ptrs(i) = (uint8_t*)malloc(png_get_rowbytes(write_struct, info_struct));
-    }
-
-    int row_width = components * width * 8;
-
-    for (int row=0;row < height;row++) {
-        for (int col=0;col < width;col++) {
-            for (int c=0;c < components;c++) {
-
-                double val = write_function(row, col, c);
+    PNGReaderData *data = (PNGReaderData*)private_data;
 
-                uint32_t int_val = val * ((((uint64_t)0x1) << bit_depth) - 1);
+    size_t row_bytes = png_get_rowbytes(data->read_struct, data->info_struct);
 
-                int start_idx = (components * col + c) * (bit_depth / 8);
-                for (int i=(bit_depth/8)-1;i >= 0;i--) {
-                    row_ptrs(row)[start_idx + i] = int_val;
-                    int_val >>= 8;
-                }
-            }
+    if (data->passes > 1) {
+        // interlaced images are only complete after the last pass, so the whole image is decoded first
+        std::vector<uint8_t> pixels(row_bytes * height);
+        read_into(pixels.data(), row_bytes);
+        for (int row = 0;row < height;row++) {
+            row_function(row, pixels.data() + row * row_bytes);
         }
+        return;
     }
 
-    png_write_image(write_struct, row_ptrs.data());
-
-    png_write_end(data->write_struct, nullptr);
-
-    for (int i = 0;i < height;i++) {
-        free(row_ptrs(i));
+    // one row in memory at a time
+    std::vector<uint8_t> samples(row_bytes);
+    for (int row = 0;row < height;row++) {
+        png_read_row(data->read_struct, samples.data(), nullptr);
+        row_function(row, samples.data());
     }
 
-
 }
 
 #else
@@ -249,15 +158,13 @@ namespace {
 
     struct PNGReaderData {
 
+        /// Decoded samples, 16 bit ones in big endian byte order
         std::vector<uint8_t> pixels;
 
     };
 
-    struct PNGWriterData {
-
-        std::string path;
-
-    };
+    /// lodepng color types by channel count
+    const LodePNGColorType lodepng_color_types[] = { LCT_GREY, LCT_GREY_ALPHA, LCT_RGB, LCT_RGBA };
 
 }
 
@@ -284,15 +191,35 @@ PNGReader::PNGReader(const std::string &path) {
 
     PNGReaderData *data = (PNGReaderData*)private_data;
 
-    uint32_t width, height;
+    uint32_t width = 0, height = 0;
+
+    std::vector<uint8_t> file;
+    lodepng::State state;
 
-    uint32_t err = lodepng::decode(data->pixels, width, height, path.c_str());
+    uint32_t err = lodepng::load_file(file, path);
+    if (!err) err = lodepng_inspect(&width, &height, &state, file.data(), file.size());
+
+    if (err) {
+        mFatal() << "lodepng error:" << lodepng_error_text(err);
+    }
+
+    // decode to the channels of the file, palettes are expanded to RGBA
+    switch (state.info_png.color.colortype) {
+        case LCT_GREY: components = 1; break;
+        case LCT_GREY_ALPHA: components = 2; break;
+        case LCT_RGB: components = 3; break;
+        default: components = 4; break;
+    }
+    bit_depth = (state.info_png.color.bitdepth == 16) ? 16 : 8;
+
+    state.info_raw.colortype = lodepng_color_types[components - 1];
+    state.info_raw.bitdepth = bit_depth;
+
+    err = lodepng::decode(data->pixels, width, height, state, file);
 
     this->width = width;
     this->height = height;
 
-    components = 4;
-
     if(err) {
         mFatal() << "lodepng error:" << lodepng_error_text(err);
     }
@@ -301,102 +228,132 @@ PNGReader::PNGReader(const std::string &path) {
 
 }
 
-void PNGReader::read(const ReadFunction &read_function) {
+void PNGReader::read_into(void *buffer, size_t row_stride) {
 
     PNGReaderData *data = (PNGReaderData*)private_data;
 
-    int i = 0;
+    size_t row_bytes = (size_t)width * components * (bit_depth / 8);
 
-    for (int row=0;row < height;row++) {
-        for (int col=0;col < width;col++) {
-            for (int c=0;c < components;c++) {
+    for (int row = 0;row < height;row++) {
+        uint8_t *out = (uint8_t*)buffer + row * row_stride;
+        const uint8_t *in = data->pixels.data() + row * row_bytes;
+        if (bit_depth == 16 && host_is_little_endian()) {
+            swap_bytes_16(in, out, row_bytes / 2);
+        } else {
+            std::memcpy(out, in, row_bytes);
+        }
+    }
 
-                uint8_t val = data->pixels[i];
+}
+
+void PNGReader::read_rows(const RowFunction &row_function) {
 
-                read_function(row, col, c, ((double)val) / 255);
+    PNGReaderData *data = (PNGReaderData*)private_data;
 
-                i++;
-            }
+    size_t row_bytes = (size_t)width * components * (bit_depth / 8);
+    std::vector<uint8_t> row_samples(row_bytes);
+
+    for (int row = 0;row < height;row++) {
+        const uint8_t *in = data->pixels.data() + row * row_bytes;
+        if (bit_depth == 16 && host_is_little_endian()) {
+            swap_bytes_16(in, row_samples.data(), row_bytes / 2);
+            row_function(row, row_samples.data());
+        } else {
+            row_function(row, in);
         }
     }
 
 }
 
-PNGWriter::PNGWriter(const std::string &path) {
+#endif
 
-#ifdef HEADERONLY
+namespace {
 
-    mFatal() << "PNG support is not availible: to enable PNG support in header-only mode, define USE_PNG and include libpng in your build system";
+    struct PNGWriterData {
 
-#else
+        FILE *fid = nullptr;
 
-    private_data = new PNGWriterData();
+    };
 
-    PNGWriterData *data = (PNGWriterData*)private_data;
+}
 
-    data->path = path;
+PNGWriter::PNGWriter(const std::string &path) {
 
-#endif
+#if defined(HEADERONLY) && !defined(USE_PNG)
 
-}
+    // fail before the file is created, the encoder could not compress into it
+    mFatal() << "PNG support is not availible: to enable PNG support in header-only mode, define USE_PNG and include libpng in your build system";
 
-PNGWriter::~PNGWriter() {
+#endif
 
-    if (private_data == nullptr)
-        return;
+    private_data = new PNGWriterData();
 
     PNGWriterData *data = (PNGWriterData*)private_data;
 
-    delete data;
-
+    data->fid = fopen(path.c_str(), "wb");
+    if (data->fid == nullptr)
+        mFatal() << "Could not open file";
 
 }
 
-void PNGWriter::write(const WriteFunction &write_function) {
-
-#ifndef HEADERONLY
+PNGWriter::~PNGWriter() {
 
     PNGWriterData *data = (PNGWriterData*)private_data;
 
-    std::vector<uint8_t> pixels;
+    if (data != nullptr && data->fid != nullptr)
+        fclose(data->fid);
 
-    for (int row=0;row < height;row++) {
-        for (int col=0;col < width;col++) {
-            for (int c=0;c < 4;c++) {
+    delete data;
 
-                uint8_t val;
+}
 
-                if (c < components) {
+void PNGWriter::set_compression_level(int level) {
+    encoder.compression_level = level;
+}
 
-                    val = write_function(row, col, c) * 255;
+void PNGWriter::set_filter(PNGFilter filter) {
+    encoder.filter = filter;
+}
 
-                } else if (c < 3) {
+void PNGWriter::set_threads(int n_threads) {
+    encoder.n_threads = n_threads;
+}
 
-                    val = 0;
+void PNGWriter::write_rows(const RowFunction &row_function) {
 
-                } else {
+    PNGWriterData *data = (PNGWriterData*)private_data;
 
-                    val = 255;
+    if (components < 1 || components > 4)
+        mFatal() << "Unsupported PNG color type";
 
-                }
+    FILE *fid = data->fid;
+    auto write_bytes = [fid](const uint8_t *bytes, size_t size) {
+        return fwrite(bytes, 1, size, fid) == size;
+    };
 
-                pixels.push_back(val);
-            }
-        }
-    }
+    int depth = get_bit_depth();
+    if (!encoder.begin(width, height, components, depth, write_bytes))
+        mFatal() << "Could not write file";
 
-    uint32_t err = lodepng::encode(data->path.c_str(), pixels, width, height);
+    // rows are collected into batches, only one of which is held at a time
+    size_t row_bytes = (size_t)width * components * (depth / 8);
+    int batch = std::min(encoder.batch_rows(), height);
+    std::vector<uint8_t> pixels(row_bytes * batch);
 
-    if(err) {
-        mFatal() << "lodepng error:" << lodepng_error_text(err);
+    for (int first = 0;first < height;first += batch) {
+        int count = std::min(batch, height - first);
+        for (int i = 0;i < count;i++) {
+            row_function(first + i, pixels.data() + i * row_bytes);
+        }
+        if (!encoder.add_rows(pixels.data(), row_bytes, count))
+            mFatal() << "PNG encoding failed";
     }
 
-#endif
+    if (!encoder.finish())
+        mFatal() << "PNG encoding failed";
 
 }
 
-#endif
-
 //=============================================================================
 } // OpenGP::
 //=============================================================================
@@ -0,0 +1,126 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+#include <Eigen/Dense>
+
+#include <OpenGP/Image/ImageType.h>
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+/// Value of a full intensity sample: the type's maximum for integers, 1 for floating point
+template <typename T>
+constexpr double sample_max() {
+    return std::is_integral<T>::value ? (double)std::numeric_limits<T>::max() : 1.0;
+}
+
+/// Sample types with a bulk conversion path
+template <typename T>
+struct is_sample_type : std::integral_constant<bool,
+    std::is_same<T, uint8_t>::value || std::is_same<T, uint16_t>::value ||
+    std::is_same<T, float>::value || std::is_same<T, double>::value> {};
+
+/// @brief Whether the pixels of `ImageType` are `component_count` packed samples of a sample type
+/// @note Such images can be converted a whole row at a time, instead of through `channel_ref`
+template <typename ImageType>
+struct has_packed_pixels : std::integral_constant<bool,
+    is_sample_type<typename ImageTypeInfo<ImageType>::Scalar>::value &&
+    sizeof(typename ImageType::Scalar) == ImageTypeInfo<ImageType>::component_count * sizeof(typename ImageTypeInfo<ImageType>::Scalar)> {};
+
+/// Whether `convert_row` can map `src_channels` channels onto `dst_channels` channels
+inline bool channels_convertible(int src_channels, int dst_channels) {
+    if (src_channels == dst_channels) return true;
+    if (src_channels == 1) return dst_channels <= 4;
+    if (src_channels == 2) return dst_channels == 1 || dst_channels == 3 || dst_channels == 4;
+    if (src_channels == 3 || src_channels == 4) return dst_channels == 1 || dst_channels == 3 || dst_channels == 4;
+    return false;
+}
+
+namespace internal {
+
+    template <typename DstMap, typename SrcExpr>
+    void assign_samples(DstMap dst, const SrcExpr &src, double src_max, std::true_type /*floating point*/) {
+        using Dst = typename DstMap::Scalar;
+        dst = src.template cast<Dst>() * Dst(1.0 / src_max);
+    }
+
+    template <typename DstMap, typename SrcExpr>
+    void assign_samples(DstMap dst, const SrcExpr &src, double src_max, std::false_type /*integer*/) {
+        using Dst = typename DstMap::Scalar;
+        if (src_max == sample_max<Dst>()) {
+            dst = src.template cast<Dst>();
+        } else {
+            // rounded and saturated, in single precision which is exact enough for 16 bits
+            float scale = float(sample_max<Dst>() / src_max);
+            dst = (src.template cast<float>() * scale + 0.5f).max(0.0f).min(float(sample_max<Dst>())).template cast<Dst>();
+        }
+    }
+
+    /// Rescale samples normalized to [0, src_max] into the destination range (packet math)
+    template <typename DstMap, typename SrcExpr>
+    void assign_samples(DstMap dst, const SrcExpr &src, double src_max) {
+        using Dst = typename DstMap::Scalar;
+        assign_samples(dst, src, src_max, std::is_floating_point<Dst>());
+    }
+
+}
+
+/// @brief Convert a row of `width` interleaved pixels between sample types and channel counts
+/// @note Matches the per-sample rules of `imread`: gray is replicated into the color
+/// channels, color is averaged into gray, alpha is dropped or added as full intensity.
+/// Gray with alpha is read as gray, with its alpha kept for four channels.
+/// The channel counts must be `channels_convertible`.
+template <typename Dst, typename Src>
+void convert_row(const Src *src, int src_channels, Dst *dst, int dst_channels, int width) {
+
+    using SrcArray = Eigen::Array<Src, Eigen::Dynamic, 1>;
+    using DstArray = Eigen::Array<Dst, Eigen::Dynamic, 1>;
+    const double src_max = sample_max<Src>();
+
+    if (src_channels == dst_channels) {
+        if (std::is_same<Src, Dst>::value) {
+            if ((const void*)src != (const void*)dst) std::memcpy(dst, src, sizeof(Src) * width * src_channels);
+        } else {
+            internal::assign_samples(Eigen::Map<DstArray>(dst, width * dst_channels), Eigen::Map<const SrcArray>(src, width * src_channels), src_max);
+        }
+        return;
+    }
+
+    // one channel of the row, as a strided view
+    auto S = [&](int c) { return Eigen::Map<const SrcArray, 0, Eigen::InnerStride<>>(src + c, width, Eigen::InnerStride<>(src_channels)); };
+    auto D = [&](int c) { return Eigen::Map<DstArray, 0, Eigen::InnerStride<>>(dst + c, width, Eigen::InnerStride<>(dst_channels)); };
+
+    if (src_channels == 1) {
+        for (int c = 0;c < dst_channels;c++) {
+            if (c < 3) internal::assign_samples(D(c), S(0), src_max);
+            else D(c).setConstant((Dst)sample_max<Dst>());
+        }
+    } else if (src_channels == 2) {
+        for (int c = 0;c < dst_channels;c++) {
+            internal::assign_samples(D(c), S((c < 3) ? 0 : 1), src_max);
+        }
+    } else if (dst_channels == 1) {
+        // summed in floating point, which cannot overflow
+        internal::assign_samples(D(0), (S(0).template cast<float>() + S(1).template cast<float>() + S(2).template cast<float>()) * (1.0f / 3), src_max);
+    } else {
+        for (int c = 0;c < dst_channels;c++) {
+            if (c < src_channels) internal::assign_samples(D(c), S(c), src_max);
+            else D(c).setConstant((Dst)sample_max<Dst>());
+        }
+    }
+
+}
+
+//=============================================================================
+} // namespace OpenGP
+//=============================================================================
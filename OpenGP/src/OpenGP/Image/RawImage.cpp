@@ -0,0 +1,103 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <string>
+
+#include "Image.h"
+
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+namespace {
+
+    struct RawImageWriterData {
+
+        std::string path;
+        int tile_rows = 0;
+
+    };
+
+}
+
+RawImageReader::RawImageReader(const std::string &path) {
+
+    RawImageFile *file = new RawImageFile();
+    private_data = file;
+
+    if (!file->open(path))
+        mFatal() << "Could not open raw image";
+
+    width = file->get_width();
+    height = file->get_height();
+    components = file->get_channels();
+    bit_depth = 8 * file->scalar_size();
+
+}
+
+RawImageReader::~RawImageReader() {
+
+    RawImageFile *file = (RawImageFile*)private_data;
+
+    delete file;
+
+}
+
+void RawImageReader::read_rows(const RowFunction &row_function) {
+
+    RawImageFile *file = (RawImageFile*)private_data;
+
+    if (!file->read_rows(row_function))
+        mFatal() << "Raw image data is corrupt";
+
+}
+
+void RawImageReader::read_into(void *buffer, size_t row_stride) {
+
+    RawImageFile *file = (RawImageFile*)private_data;
+
+    if (!file->read_into(buffer, row_stride))
+        mFatal() << "Raw image data is corrupt";
+
+}
+
+RawImageWriter::RawImageWriter(const std::string &path) {
+
+    private_data = new RawImageWriterData();
+
+    RawImageWriterData *data = (RawImageWriterData*)private_data;
+
+    data->path = path;
+
+}
+
+RawImageWriter::~RawImageWriter() {
+
+    RawImageWriterData *data = (RawImageWriterData*)private_data;
+
+    delete data;
+
+}
+
+void RawImageWriter::set_tile_rows(int tile_rows) {
+    ((RawImageWriterData*)private_data)->tile_rows = tile_rows;
+}
+
+void RawImageWriter::write_rows(const RowFunction &row_function) {
+
+    RawImageWriterData *data = (RawImageWriterData*)private_data;
+
+    int depth = get_bit_depth();
+    RawScalarType type = (depth == 32) ? RawScalarType::Float32 : (depth == 16) ? RawScalarType::UInt16 : RawScalarType::UInt8;
+
+    if (!RawImageFile::write(data->path, width, height, components, type, data->tile_rows, row_function))
+        mFatal() << "Could not write raw image";
+
+}
+
+//=============================================================================
+} // OpenGP::
+//=============================================================================
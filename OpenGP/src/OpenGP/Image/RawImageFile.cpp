@@ -0,0 +1,325 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdio.h>
+#include <cstring>
+#include <algorithm>
+
+#include "RawImageFile.h"
+
+#include <OpenGP/RGBD/codecs.h>
+#include <OpenGP/util/parallel_for.h>
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+namespace {
+
+    const char raw_magic[8] = { 'O', 'G', 'P', 'R', 'A', 'W', 'I', 'M' };
+    const uint32_t raw_version = 1;
+    const size_t raw_header_size = 64;
+
+    enum RawCompression {
+        RAW_UNCOMPRESSED = 0,
+        RAW_TILES = 1,
+    };
+
+    uint32_t read_le32(const uint8_t *p) {
+        return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+
+    uint64_t read_le64(const uint8_t *p) {
+        return (uint64_t)read_le32(p) | ((uint64_t)read_le32(p + 4) << 32);
+    }
+
+    void write_le(uint8_t *p, uint64_t value, int bytes) {
+        for (int i = 0;i < bytes;i++) p[i] = (uint8_t)(value >> (8 * i));
+    }
+
+    int raw_scalar_size(RawScalarType type) {
+        switch (type) {
+            case RawScalarType::UInt8: return 1;
+            case RawScalarType::UInt16: return 2;
+            default: return 4;
+        }
+    }
+
+    /// Group byte `b` of every `size` byte sample into the `b`-th plane of `out`
+    void shuffle_bytes(const uint8_t *in, size_t n_samples, int size, uint8_t *out) {
+        for (int b = 0;b < size;b++) {
+            uint8_t *plane = out + b * n_samples;
+            for (size_t i = 0;i < n_samples;i++) plane[i] = in[i * size + b];
+        }
+    }
+
+    /// Inverse of `shuffle_bytes`, into rows of `row_samples` samples `row_stride` bytes apart
+    void unshuffle_bytes(const uint8_t *in, size_t n_samples, int size, size_t row_samples, uint8_t *out, size_t row_stride) {
+        for (size_t i = 0;i < n_samples;i += row_samples) {
+            uint8_t *row = out + (i / row_samples) * row_stride;
+            for (int b = 0;b < size;b++) {
+                const uint8_t *plane = in + b * n_samples + i;
+                for (size_t j = 0;j < row_samples;j++) row[j * size + b] = plane[j];
+            }
+        }
+    }
+
+}
+
+bool RawImageFile::open(const std::string &path) {
+
+    width = height = channels = tile_rows = 0;
+
+    if (!file.open(path))
+        return false;
+
+    const uint8_t *header = file.data();
+    if (file.size() < raw_header_size || std::memcmp(header, raw_magic, 8) != 0 || read_le32(header + 8) != raw_version) {
+        file.close();
+        return false;
+    }
+
+    uint32_t file_width = read_le32(header + 12), file_height = read_le32(header + 16);
+    int file_channels = header[20] | (header[21] << 8);
+    int type = header[22], compression = header[23];
+    uint32_t file_tile_rows = read_le32(header + 24);
+
+    bool valid = file_width > 0 && file_width <= (1u << 20) && file_height > 0 && file_height <= (1u << 20) &&
+                 file_channels > 0 && type >= 1 && type <= 3 &&
+                 (compression == RAW_UNCOMPRESSED || (compression == RAW_TILES && file_tile_rows > 0));
+
+    if (valid) {
+        width = (int)file_width;
+        height = (int)file_height;
+        channels = file_channels;
+        scalar_type = (RawScalarType)type;
+        tile_rows = (compression == RAW_TILES) ? (int)std::min(file_tile_rows, file_height) : 0;
+
+        size_t row_bytes = (size_t)width * channels * scalar_size();
+        if (tile_rows == 0) {
+            valid = file.size() - raw_header_size >= row_bytes * height;
+        } else {
+            size_t n_tiles = (height + tile_rows - 1) / tile_rows;
+            valid = file.size() - raw_header_size >= 8 * (n_tiles + 1);
+        }
+    }
+
+    if (!valid) {
+        width = height = channels = tile_rows = 0;
+        file.close();
+    }
+
+    return valid;
+
+}
+
+int RawImageFile::scalar_size() const {
+    return raw_scalar_size(scalar_type);
+}
+
+const void *RawImageFile::data() const {
+    return (file.is_open() && !is_compressed()) ? file.data() + raw_header_size : nullptr;
+}
+
+bool RawImageFile::decode_tile(int tile, void *out, size_t row_stride) const {
+
+    const uint8_t *table = file.data() + raw_header_size;
+    uint64_t begin = read_le64(table + 8 * tile), end = read_le64(table + 8 * (tile + 1));
+    if (begin > end || end > file.size())
+        return false;
+
+    const int size = scalar_size();
+    const size_t row_samples = (size_t)width * channels;
+    const size_t n_samples = row_samples * std::min(tile_rows, height - tile * tile_rows);
+
+    // decoded in place when the rows are contiguous and need no unshuffling
+    std::vector<uint8_t> decoded((size == 1 && row_stride == row_samples) ? 0 : n_samples * size);
+    uint8_t *target = decoded.empty() ? (uint8_t*)out : decoded.data();
+
+    if (!lz4_decompress(file.data() + begin, (size_t)(end - begin), target, n_samples * size))
+        return false;
+
+    if (!decoded.empty())
+        unshuffle_bytes(decoded.data(), n_samples, size, row_samples, (uint8_t*)out, row_stride);
+
+    return true;
+
+}
+
+bool RawImageFile::read_into(void *buffer, size_t row_stride) const {
+
+    if (!file.is_open())
+        return false;
+
+    const size_t row_bytes = (size_t)width * channels * scalar_size();
+
+    if (!is_compressed()) {
+        const uint8_t *samples = file.data() + raw_header_size;
+        for (int row = 0;row < height;row++) {
+            std::memcpy((uint8_t*)buffer + row * row_stride, samples + row * row_bytes, row_bytes);
+        }
+        return true;
+    }
+
+    const int n_tiles = (height + tile_rows - 1) / tile_rows;
+    std::vector<char> failed(n_tiles, 0);
+
+    parallel_for(0, n_tiles, [&](int tile) {
+        failed[tile] = !decode_tile(tile, (uint8_t*)buffer + (size_t)tile * tile_rows * row_stride, row_stride);
+    }, 1);
+
+    return std::find(failed.begin(), failed.end(), 1) == failed.end();
+
+}
+
+bool RawImageFile::read_rows(const ReadRowFunction &row_function) const {
+
+    if (!file.is_open())
+        return false;
+
+    const size_t row_bytes = (size_t)width * channels * scalar_size();
+
+    if (!is_compressed()) {
+        // straight from the mapping
+        const uint8_t *samples = file.data() + raw_header_size;
+        for (int row = 0;row < height;row++) {
+            row_function(row, samples + row * row_bytes);
+        }
+        return true;
+    }
+
+    // the rows of one tile per thread are held at a time
+    const int n_tiles = (height + tile_rows - 1) / tile_rows, batch_tiles = hardware_threads();
+    std::vector<uint8_t> rows(row_bytes * std::min(tile_rows * batch_tiles, height));
+
+    for (int first_tile = 0;first_tile < n_tiles;first_tile += batch_tiles) {
+
+        int count = std::min(batch_tiles, n_tiles - first_tile);
+        int first_row = first_tile * tile_rows, last_row = std::min(first_row + count * tile_rows, height);
+        std::vector<char> failed(count, 0);
+
+        parallel_for(0, count, [&](int tile) {
+            failed[tile] = !decode_tile(first_tile + tile, rows.data() + (size_t)tile * tile_rows * row_bytes, row_bytes);
+        }, 1);
+
+        if (std::find(failed.begin(), failed.end(), 1) != failed.end())
+            return false;
+
+        for (int row = first_row;row < last_row;row++) {
+            row_function(row, rows.data() + (row - first_row) * row_bytes);
+        }
+
+    }
+
+    return true;
+
+}
+
+bool RawImageFile::write(const std::string &path, int width, int height, int channels, RawScalarType scalar_type,
+                         int tile_rows, const WriteRowFunction &row_function) {
+
+    if (width <= 0 || height <= 0 || channels <= 0 || channels > 0xffff || tile_rows < 0)
+        return false;
+
+    FILE *fid = fopen(path.c_str(), "wb");
+    if (fid == nullptr)
+        return false;
+
+    tile_rows = std::min(tile_rows, height);
+
+    uint8_t header[raw_header_size] = {};
+    std::memcpy(header, raw_magic, 8);
+    write_le(header + 8, raw_version, 4);
+    write_le(header + 12, (uint32_t)width, 4);
+    write_le(header + 16, (uint32_t)height, 4);
+    write_le(header + 20, (uint32_t)channels, 2);
+    header[22] = (uint8_t)scalar_type;
+    header[23] = (uint8_t)((tile_rows > 0) ? RAW_TILES : RAW_UNCOMPRESSED);
+    write_le(header + 24, (uint32_t)tile_rows, 4);
+
+    bool ok = fwrite(header, 1, raw_header_size, fid) == raw_header_size;
+
+    const int size = raw_scalar_size(scalar_type);
+    const size_t row_samples = (size_t)width * channels, row_bytes = row_samples * size;
+
+    if (tile_rows == 0) {
+
+        std::vector<uint8_t> row(row_bytes);
+        for (int r = 0;r < height && ok;r++) {
+            row_function(r, row.data());
+            ok = fwrite(row.data(), 1, row_bytes, fid) == row_bytes;
+        }
+
+    } else {
+
+        // the tile table is written last, once the tile sizes are known
+        const int n_tiles = (height + tile_rows - 1) / tile_rows;
+        std::vector<uint64_t> offsets(n_tiles + 1);
+        std::vector<uint8_t> table(8 * (n_tiles + 1), 0);
+        ok = ok && fwrite(table.data(), 1, table.size(), fid) == table.size();
+        offsets[0] = raw_header_size + table.size();
+
+        // the rows of one tile per thread are held at a time
+        const int batch_tiles = hardware_threads();
+        std::vector<uint8_t> rows(row_bytes * std::min(tile_rows * batch_tiles, height));
+        std::vector<std::vector<uint8_t>> compressed(batch_tiles);
+
+        for (int first_tile = 0;first_tile < n_tiles && ok;first_tile += batch_tiles) {
+
+            int count = std::min(batch_tiles, n_tiles - first_tile);
+            int first_row = first_tile * tile_rows, last_row = std::min(first_row + count * tile_rows, height);
+
+            for (int r = first_row;r < last_row;r++) {
+                row_function(r, rows.data() + (r - first_row) * row_bytes);
+            }
+
+            parallel_for(0, count, [&](int tile) {
+                int tile_count = std::min(tile_rows, last_row - first_row - tile * tile_rows);
+                size_t n_samples = row_samples * tile_count;
+                const uint8_t *samples = rows.data() + (size_t)tile * tile_rows * row_bytes;
+                std::vector<uint8_t> shuffled;
+                if (size > 1) {
+                    shuffled.resize(n_samples * size);
+                    shuffle_bytes(samples, n_samples, size, shuffled.data());
+                    samples = shuffled.data();
+                }
+                compressed[tile].clear();
+                lz4_compress(samples, n_samples * size, compressed[tile]);
+            }, 1);
+
+            for (int tile = 0;tile < count && ok;tile++) {
+                ok = fwrite(compressed[tile].data(), 1, compressed[tile].size(), fid) == compressed[tile].size();
+                offsets[first_tile + tile + 1] = offsets[first_tile + tile] + compressed[tile].size();
+            }
+
+        }
+
+        for (int tile = 0;tile <= n_tiles;tile++) {
+            write_le(table.data() + 8 * tile, offsets[tile], 8);
+        }
+        ok = ok && fseek(fid, (long)raw_header_size, SEEK_SET) == 0 && fwrite(table.data(), 1, table.size(), fid) == table.size();
+
+    }
+
+    ok = (fclose(fid) == 0) && ok;
+
+    return ok;
+
+}
+
+bool RawImageFile::write(const std::string &path, const void *pixels, size_t row_stride, int width, int height, int channels,
+                         RawScalarType scalar_type, int tile_rows) {
+
+    size_t row_bytes = (size_t)width * channels * raw_scalar_size(scalar_type);
+
+    return write(path, width, height, channels, scalar_type, tile_rows, [&](int row, void *samples) {
+        std::memcpy(samples, (const uint8_t*)pixels + row * row_stride, row_bytes);
+    });
+
+}
+
+//=============================================================================
+} // OpenGP::
+//=============================================================================
@@ -0,0 +1,126 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+
+#include <Eigen/Dense>
+
+#include <OpenGP/headeronly.h>
+#include <OpenGP/MLogger.h>
+#include <OpenGP/Image/ImageType.h>
+#include <OpenGP/util/MappedFile.h>
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+/// Sample type of a raw image
+enum class RawScalarType : uint8_t {
+    UInt8 = 1,
+    UInt16 = 2,
+    Float32 = 3
+};
+
+/// Raw sample type of `T` (only uint8_t, uint16_t and float are stored)
+template <typename T>
+constexpr RawScalarType raw_scalar_type() {
+    return std::is_same<T, uint8_t>::value ? RawScalarType::UInt8 :
+           std::is_same<T, uint16_t>::value ? RawScalarType::UInt16 : RawScalarType::Float32;
+}
+
+/// @brief Memory mapped raw image (".rawimg"), for float point maps and 16 bit depth without loss
+/// @note The format is a 64 byte header followed by the samples:
+///
+///     header   magic "OGPRAWIM", uint32 version, uint32 width, uint32 height, uint16 channels,
+///              uint8 scalar type, uint8 compression (0: none, 1: tiles), uint32 tile rows,
+///              zero padding (all little endian)
+///     samples  uncompressed: rows of `width * channels` interleaved samples
+///              tiles: uint64 file offsets of the `n_tiles + 1` tile boundaries, then each
+///              tile of `tile rows` rows compressed on its own in the LZ4 block format,
+///              after grouping the bytes of the samples by significance (which compresses
+///              floats and 16 bit depth much better)
+///
+/// Uncompressed images are not copied: `map` returns an Eigen::Map over the file mapping.
+/// Tiles are compressed and decompressed in parallel.
+class RawImageFile {
+private:
+
+    MappedFile file;
+
+    int width = 0, height = 0, channels = 0;
+    RawScalarType scalar_type = RawScalarType::UInt8;
+    int tile_rows = 0; ///< 0 for uncompressed images
+
+    /// Decompress a tile into rows `row_stride` bytes apart
+    HEADERONLY_INLINE bool decode_tile(int tile, void *out, size_t row_stride) const;
+
+public:
+
+    using ReadRowFunction = std::function<void(int, const void*)>;
+    using WriteRowFunction = std::function<void(int, void*)>;
+
+    RawImageFile() {}
+    explicit RawImageFile(const std::string &path) { if (!open(path)) mFatal() << "Could not open raw image" << path; }
+
+    /// Map `path`, returns false if it is not a valid raw image
+    HEADERONLY_INLINE bool open(const std::string &path);
+
+    int get_width() const { return width; }
+    int get_height() const { return height; }
+    int get_channels() const { return channels; }
+    RawScalarType get_scalar_type() const { return scalar_type; }
+    bool is_compressed() const { return tile_rows > 0; }
+
+    /// Bytes per sample
+    HEADERONLY_INLINE int scalar_size() const;
+
+    /// The samples in the file mapping (nullptr for compressed images)
+    HEADERONLY_INLINE const void *data() const;
+
+    /// @brief Zero-copy view of an uncompressed image as `ImageType` (e.g. `Image<Vec3>` or `Image<uint16_t>`)
+    /// @note Valid while the file is open. The sample type and channels must match the file.
+    template <typename ImageType>
+    Eigen::Map<const ImageType> map() const {
+        using Scalar = typename ImageTypeInfo<ImageType>::Scalar;
+        if (is_compressed())
+            mFatal() << "Compressed raw images cannot be mapped";
+        if (raw_scalar_type<Scalar>() != scalar_type || sizeof(Scalar) != (size_t)scalar_size() ||
+            ImageTypeInfo<ImageType>::component_count != channels || sizeof(typename ImageType::Scalar) != sizeof(Scalar) * channels)
+            mFatal() << "Image type and raw image are incompatible";
+        return Eigen::Map<const ImageType>((const typename ImageType::Scalar*)data(), height, width);
+    }
+
+    /// Decode into rows of `width * channels` samples, `row_stride` bytes apart
+    HEADERONLY_INLINE bool read_into(void *buffer, size_t row_stride) const;
+
+    /// Decode a tile at a time, calling the function with each row in order
+    HEADERONLY_INLINE bool read_rows(const ReadRowFunction &row_function) const;
+
+    /// @brief Write a raw image, asking the function to fill each row in order
+    /// @param tile_rows rows per compressed tile, 0 to store the samples uncompressed
+    /// @note Only a batch of tiles is held in memory at a time.
+    static HEADERONLY_INLINE bool write(const std::string &path, int width, int height, int channels, RawScalarType scalar_type,
+                                        int tile_rows, const WriteRowFunction &row_function);
+
+    /// Write rows of `width * channels` samples, `row_stride` bytes apart
+    static HEADERONLY_INLINE bool write(const std::string &path, const void *pixels, size_t row_stride, int width, int height, int channels,
+                                        RawScalarType scalar_type, int tile_rows = 0);
+
+};
+
+//=============================================================================
+} // namespace OpenGP
+//=============================================================================
+
+#ifdef HEADERONLY
+    #include "RawImageFile.cpp"
+#endif
@@ -2,6 +2,10 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
+#include <stdio.h>
+#include <vector>
+#include <cstring>
+
 #include "Image.h"
 
 
@@ -10,27 +14,392 @@
 namespace OpenGP {
 //=============================================================================
 
+namespace {
+
+    enum TGAImageType {
+        TGA_COLOR_MAPPED = 1,
+        TGA_TRUE_COLOR = 2,
+        TGA_GRAY = 3,
+        TGA_RLE = 8, ///< added to the above for run-length encoded data
+    };
+
+    const int tga_header_size = 18;
+    const uint8_t tga_right_to_left = 0x10;
+    const uint8_t tga_top_to_bottom = 0x20;
+
+    struct TGAReaderData {
+
+        /// The file is read through a small buffer, so that images of any size can be streamed
+        FILE *fid = nullptr;
+        std::vector<uint8_t> buffer;
+        size_t begin = 0, end = 0; ///< unread bytes of the buffer
+
+        bool rle = false;
+        bool right_to_left = false, top_to_bottom = false;
+
+        int pixel_bytes = 0; ///< bytes per pixel in the file (a palette index for color mapped images)
+        std::vector<uint8_t> palette; ///< RGB(A) entries of color mapped images
+
+        /// State of the current RLE packet, which may continue on the next row
+        int run_length = 0;
+        bool run_repeat = false;
+        uint8_t run_value[4] = {}; ///< the repeated pixel
+
+    };
+
+    struct TGAWriterData {
+
+        FILE *fid = nullptr;
+        bool rle = false;
+
+    };
+
+    uint16_t read_le16(const uint8_t *p) {
+        return (uint16_t)(p[0] | (p[1] << 8));
+    }
+
+    void write_le16(uint8_t *p, int value) {
+        p[0] = (uint8_t)(value & 0xff);
+        p[1] = (uint8_t)((value >> 8) & 0xff);
+    }
+
+    /// Copy `count` pixels of `bytes` bytes, swapping BGR(A) and RGB(A) (in place if `in == out`)
+    void swap_red_blue(const uint8_t *in, uint8_t *out, int count, int bytes) {
+        if (bytes < 3) {
+            if (in != out) std::memcpy(out, in, (size_t)count * bytes);
+            return;
+        }
+        for (int i = 0;i < count;i++, in += bytes, out += bytes) {
+            uint8_t blue = in[0];
+            out[0] = in[2];
+            out[1] = in[1];
+            out[2] = blue;
+            if (bytes == 4) out[3] = in[3];
+        }
+    }
+
+    /// Next `size` bytes of the file, valid until the following call, or nullptr at the end of the file
+    const uint8_t *tga_take(TGAReaderData &data, size_t size) {
+
+        if (data.end - data.begin < size) {
+            // keep the unread bytes and refill the rest of the buffer
+            std::memmove(data.buffer.data(), data.buffer.data() + data.begin, data.end - data.begin);
+            data.end -= data.begin;
+            data.begin = 0;
+            if (data.buffer.size() < size) data.buffer.resize(size);
+            data.end += fread(data.buffer.data() + data.end, 1, data.buffer.size() - data.end, data.fid);
+            if (data.end < size) return nullptr;
+        }
+
+        const uint8_t *bytes = data.buffer.data() + data.begin;
+        data.begin += size;
+        return bytes;
+
+    }
+
+    /// Decode the next row of file pixels (in file order and layout) into `out`
+    void tga_decode_row(TGAReaderData &data, int width, uint8_t *out) {
+
+        const int bytes = data.pixel_bytes;
+
+        if (!data.rle) {
+            size_t row_bytes = (size_t)width * bytes;
+            const uint8_t *row = tga_take(data, row_bytes);
+            if (row == nullptr)
+                mFatal() << "TGA pixel data is truncated";
+            std::memcpy(out, row, row_bytes);
+            return;
+        }
+
+        for (int i = 0;i < width;) {
+
+            if (data.run_length == 0) {
+                const uint8_t *packet = tga_take(data, 1);
+                if (packet == nullptr)
+                    mFatal() << "TGA pixel data is truncated";
+                data.run_repeat = (*packet & 0x80) != 0;
+                data.run_length = (*packet & 0x7f) + 1;
+                if (data.run_repeat) {
+                    const uint8_t *value = tga_take(data, bytes);
+                    if (value == nullptr)
+                        mFatal() << "TGA pixel data is truncated";
+                    std::memcpy(data.run_value, value, bytes);
+                }
+            }
+
+            int count = std::min(data.run_length, width - i);
+            uint8_t *dst = out + (size_t)i * bytes;
+            if (data.run_repeat) {
+                for (int k = 0;k < count;k++) std::memcpy(dst + k * bytes, data.run_value, bytes);
+            } else {
+                const uint8_t *values = tga_take(data, (size_t)count * bytes);
+                if (values == nullptr)
+                    mFatal() << "TGA pixel data is truncated";
+                std::memcpy(dst, values, (size_t)count * bytes);
+            }
+
+            data.run_length -= count;
+            i += count;
+
+        }
+
+    }
+
+    /// Convert a decoded row of file pixels in place (or through the palette) to RGB(A) samples
+    void tga_convert_row(const TGAReaderData &data, const uint8_t *in, uint8_t *out, int width, int components) {
+
+        if (!data.palette.empty()) {
+            for (int i = 0;i < width;i++) {
+                std::memcpy(out + (size_t)i * components, data.palette.data() + (size_t)in[i] * components, components);
+            }
+        } else {
+            swap_red_blue(in, out, width, data.pixel_bytes);
+        }
+
+        if (data.right_to_left) {
+            for (int i = 0, j = width - 1;i < j;i++, j--) {
+                for (int c = 0;c < components;c++) std::swap(out[i * components + c], out[j * components + c]);
+            }
+        }
+
+    }
+
+    /// Append one row of file pixels to `out` as RLE packets (which never cross rows)
+    void tga_encode_rle_row(const uint8_t *row, int width, int bytes, std::vector<uint8_t> &out) {
+
+        auto same = [&](int a, int b) { return std::memcmp(row + a * bytes, row + b * bytes, bytes) == 0; };
+
+        for (int i = 0;i < width;) {
+
+            int run = 1;
+            while (i + run < width && run < 128 && same(i, i + run)) run++;
+
+            if (run > 1) {
+                out.push_back((uint8_t)(0x80 | (run - 1)));
+                out.insert(out.end(), row + i * bytes, row + (i + 1) * bytes);
+                i += run;
+                continue;
+            }
+
+            // raw packet up to the next pair of equal pixels
+            int count = 1;
+            while (i + count < width && count < 128 && !(i + count + 1 < width && same(i + count, i + count + 1))) count++;
+
+            out.push_back((uint8_t)(count - 1));
+            out.insert(out.end(), row + i * bytes, row + (i + count) * bytes);
+            i += count;
+
+        }
+
+    }
+
+}
+
 TGAReader::~TGAReader() {
 
+    TGAReaderData *data = (TGAReaderData*)private_data;
+
+    if (data != nullptr && data->fid != nullptr)
+        fclose(data->fid);
+
+    delete data;
+
 }
 
 TGAReader::TGAReader(const std::string &path) {
 
+    private_data = new TGAReaderData();
+
+    TGAReaderData *data = (TGAReaderData*)private_data;
+
+    data->fid = fopen(path.c_str(), "rb");
+    if (data->fid == nullptr)
+        mFatal() << "Could not open file";
+
+    data->buffer.resize(64 << 10);
+
+    uint8_t header[tga_header_size];
+    const uint8_t *bytes = tga_take(*data, tga_header_size);
+    if (bytes == nullptr)
+        mFatal() << "Cannot read TGA header";
+    std::memcpy(header, bytes, tga_header_size);
+
+    int id_length = header[0];
+    int color_map_type = header[1];
+    int image_type = header[2];
+    int color_map_first = read_le16(header + 3);
+    int color_map_length = read_le16(header + 5);
+    int color_map_depth = header[7];
+    width = read_le16(header + 12);
+    height = read_le16(header + 14);
+    int pixel_depth = header[16];
+    uint8_t descriptor = header[17];
+
+    data->rle = (image_type & TGA_RLE) != 0;
+    data->right_to_left = (descriptor & tga_right_to_left) != 0;
+    data->top_to_bottom = (descriptor & tga_top_to_bottom) != 0;
+    data->pixel_bytes = pixel_depth / 8;
+    bit_depth = 8;
+
+    switch (image_type & ~TGA_RLE) {
+        case TGA_GRAY:
+            if (pixel_depth != 8)
+                mFatal() << "Unsupported TGA gray depth" << pixel_depth;
+            components = 1;
+            break;
+        case TGA_TRUE_COLOR:
+            if (pixel_depth != 24 && pixel_depth != 32)
+                mFatal() << "Unsupported TGA pixel depth" << pixel_depth;
+            components = pixel_depth / 8;
+            break;
+        case TGA_COLOR_MAPPED:
+            if (color_map_type != 1 || pixel_depth != 8 || (color_map_depth != 24 && color_map_depth != 32))
+                mFatal() << "Unsupported TGA color map";
+            components = color_map_depth / 8;
+            break;
+        default:
+            mFatal() << "Unsupported TGA image type" << image_type;
+    }
+
+    size_t color_map_bytes = (color_map_type == 1) ? (size_t)color_map_length * ((color_map_depth + 7) / 8) : 0;
+    if (tga_take(*data, id_length) == nullptr)
+        mFatal() << "TGA header is truncated";
+    const uint8_t *color_map = tga_take(*data, color_map_bytes);
+    if (color_map == nullptr)
+        mFatal() << "TGA color map is truncated";
+
+    if ((image_type & ~TGA_RLE) == TGA_COLOR_MAPPED) {
+        // indices below the first entry map to black
+        data->palette.assign(256 * components, 0);
+        int entries = std::min(color_map_length, 256 - std::min(color_map_first, 256));
+        swap_red_blue(color_map, data->palette.data() + color_map_first * components, entries, components);
+    }
+
 }
 
-void TGAReader::read(const ReadFunction &read_function) {
+void TGAReader::read_into(void *buffer, size_t row_stride) {
+
+    TGAReaderData *data = (TGAReaderData*)private_data;
+
+    std::vector<uint8_t> indices(data->palette.empty() ? 0 : width);
+
+    for (int i = 0;i < height;i++) {
+        int row = data->top_to_bottom ? i : height - 1 - i;
+        uint8_t *out = (uint8_t*)buffer + row * row_stride;
+        // file pixels are decoded in place, except palette indices which expand
+        uint8_t *in = indices.empty() ? out : indices.data();
+        tga_decode_row(*data, width, in);
+        tga_convert_row(*data, in, out, width, components);
+    }
+
+}
+
+void TGAReader::read_rows(const RowFunction &row_function) {
+
+    TGAReaderData *data = (TGAReaderData*)private_data;
+
+    std::vector<uint8_t> samples((size_t)width * components);
+    std::vector<uint8_t> indices(data->palette.empty() ? 0 : width);
+
+    for (int i = 0;i < height;i++) {
+        int row = data->top_to_bottom ? i : height - 1 - i;
+        uint8_t *in = indices.empty() ? samples.data() : indices.data();
+        tga_decode_row(*data, width, in);
+        tga_convert_row(*data, in, samples.data(), width, components);
+        row_function(row, samples.data());
+    }
 
 }
 
 TGAWriter::~TGAWriter() {
 
+    TGAWriterData *data = (TGAWriterData*)private_data;
+
+    if (data != nullptr) {
+        fclose(data->fid);
+    }
+
+    delete data;
+
 }
 
 TGAWriter::TGAWriter(const std::string &path) {
 
+    private_data = new TGAWriterData();
+
+    TGAWriterData *data = (TGAWriterData*)private_data;
+
+    data->fid = fopen(path.c_str(), "wb");
+    if (data->fid == nullptr)
+        mFatal() << "Could not open file";
+
+}
+
+void TGAWriter::set_rle(bool rle) {
+    ((TGAWriterData*)private_data)->rle = rle;
 }
 
-void TGAWriter::write(const WriteFunction &write_function) {
+void TGAWriter::write_rows(const RowFunction &row_function) {
+
+    TGAWriterData *data = (TGAWriterData*)private_data;
+
+    // gray and alpha has no TGA equivalent, it is stored as RGBA
+    int file_components;
+    if (components == 1 || components == 3 || components == 4) {
+        file_components = components;
+    } else if (components == 2) {
+        file_components = 4;
+    } else {
+        mFatal() << "Unsupported TGA pixel format";
+        return;
+    }
+
+    if (width > 0xffff || height > 0xffff)
+        mFatal() << "Image is too large for TGA";
+
+    uint8_t header[tga_header_size] = {};
+    header[2] = (uint8_t)(((file_components == 1) ? TGA_GRAY : TGA_TRUE_COLOR) + (data->rle ? TGA_RLE : 0));
+    write_le16(header + 12, width);
+    write_le16(header + 14, height);
+    header[16] = (uint8_t)(8 * file_components);
+    // rows are stored top to bottom, in the order they are produced
+    header[17] = (uint8_t)(tga_top_to_bottom | ((file_components == 4) ? 8 : 0));
+
+    if (fwrite(header, sizeof(header), 1, data->fid) != 1)
+        mFatal() << "Could not write TGA header";
+
+    std::vector<uint8_t> samples((size_t)width * components);
+    std::vector<uint8_t> pixels((size_t)width * file_components);
+    std::vector<uint8_t> packets;
+
+    for (int row = 0;row < height;row++) {
+
+        row_function(row, samples.data());
+
+        if (components == 2) {
+            for (int i = 0;i < width;i++) {
+                uint8_t gray = samples[2 * i], alpha = samples[2 * i + 1];
+                uint8_t *p = &pixels[4 * i];
+                p[0] = p[1] = p[2] = gray;
+                p[3] = alpha;
+            }
+        } else {
+            swap_red_blue(samples.data(), pixels.data(), width, file_components);
+        }
+
+        bool ok;
+        if (data->rle) {
+            packets.clear();
+            tga_encode_rle_row(pixels.data(), width, file_components, packets);
+            ok = fwrite(packets.data(), 1, packets.size(), data->fid) == packets.size();
+        } else {
+            ok = fwrite(pixels.data(), 1, pixels.size(), data->fid) == pixels.size();
+        }
+
+        if (!ok)
+            mFatal() << "Could not write TGA pixel data";
+
+    }
 
 }
 
@@ -0,0 +1,259 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <algorithm>
+
+#include "DepthMesher.h"
+
+#include <OpenGP/util/parallel_for.h>
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+namespace {
+
+/// Flags of `DepthMesher::pixel_used`
+const uint8_t CellCorner = 1;
+const uint8_t Referenced = 2;
+
+/// Whether the depth range of a triangle is small compared to its distance
+inline bool is_continuous(Scalar z0, Scalar z1, Scalar z2, Scalar threshold) {
+    Scalar z_min = std::min(z0, std::min(z1, z2));
+    Scalar z_max = std::max(z0, std::max(z1, z2));
+    return z_max - z_min <= threshold * z_min;
+}
+
+/// Run `f(block)` over all blocks, such that blocks sharing a boundary row never run concurrently
+template <typename Function>
+void parallel_for_interleaved(int n_blocks, const Function &f, int n_threads) {
+    parallel_for(0, (n_blocks + 1) / 2, [&](int k) { f(2 * k); }, 1, n_threads);
+    parallel_for(0, n_blocks / 2, [&](int k) { f(2 * k + 1); }, 1, n_threads);
+}
+
+}
+
+bool DepthMesher::is_flat(int x, int y, int size) const {
+
+    int width = map.width;
+    auto z = [&](int i, int j) { return map.points(2, j * width + i); };
+
+    for (int j = y;j <= y + size;j++) {
+        for (int i = x;i <= x + size;i++) {
+            if (!map.mask(j * width + i)) return false;
+        }
+    }
+
+    // inverse depth is affine in the pixel coordinates on a plane, so flat cells are
+    // reproduced exactly by the bilinear interpolation of the corners
+    Scalar w00 = 1 / z(x, y), w10 = 1 / z(x + size, y);
+    Scalar w01 = 1 / z(x, y + size), w11 = 1 / z(x + size, y + size);
+    Scalar inv_size = Scalar(1) / size;
+
+    for (int j = 0;j <= size;j++) {
+        Scalar v = j * inv_size;
+        Scalar w0 = w00 + v * (w01 - w00);
+        Scalar w1 = w10 + v * (w11 - w10);
+        for (int i = 0;i <= size;i++) {
+            Scalar u = i * inv_size;
+            Scalar w = w0 + u * (w1 - w0);
+            if (std::abs(1 - z(x + i, y + j) * w) > flatness_threshold) return false;
+        }
+    }
+
+    return true;
+
+}
+
+void DepthMesher::subdivide(int x, int y, int size, std::vector<Cell> &cells) const {
+
+    int n_quads_x = map.width - 1, n_quads_y = map.height - 1;
+    if (x >= n_quads_x || y >= n_quads_y) return;
+
+    if (size == 1 || (x + size <= n_quads_x && y + size <= n_quads_y && is_flat(x, y, size))) {
+        cells.push_back({ x, y, size });
+        return;
+    }
+
+    int half = size / 2;
+    subdivide(x, y, half, cells);
+    subdivide(x + half, y, half, cells);
+    subdivide(x, y + half, half, cells);
+    subdivide(x + half, y + half, half, cells);
+
+}
+
+void DepthMesher::emit_quad(int x, int y, std::vector<int> &out) const {
+
+    int width = map.width;
+
+    // corners in winding order, so any three of them in this order face the camera
+    int c[4] = { y * width + x, (y + 1) * width + x, (y + 1) * width + x + 1, y * width + x + 1 };
+    Scalar z[4];
+    int n_valid = 0, invalid = -1;
+    for (int k = 0;k < 4;k++) {
+        z[k] = map.points(2, c[k]);
+        if (map.mask(c[k])) n_valid++; else invalid = k;
+    }
+    if (n_valid < 3) return;
+
+    auto emit = [&](int a, int b, int d) {
+        if (!is_continuous(z[a], z[b], z[d], depth_edge_threshold)) return;
+        out.push_back(c[a]);
+        out.push_back(c[b]);
+        out.push_back(c[d]);
+    };
+
+    if (n_valid == 3) {
+        emit((invalid + 1) % 4, (invalid + 2) % 4, (invalid + 3) % 4);
+    } else if (std::abs(z[0] - z[2]) <= std::abs(z[1] - z[3])) {
+        // split along the diagonal with the smaller depth change
+        emit(0, 1, 2);
+        emit(0, 2, 3);
+    } else {
+        emit(0, 1, 3);
+        emit(1, 2, 3);
+    }
+
+}
+
+void DepthMesher::emit_fan(const Cell &cell, std::vector<int> &boundary, std::vector<int> &out) const {
+
+    int width = map.width;
+    int x = cell.x, y = cell.y, size = cell.size;
+
+    // walk the border in winding order, keeping the corners of neighbouring cells
+    boundary.clear();
+    auto visit = [&](int i, int j) { if (pixel_used[j * width + i] & CellCorner) boundary.push_back(j * width + i); };
+    for (int j = y;j < y + size;j++) visit(x, j);
+    for (int i = x;i < x + size;i++) visit(i, y + size);
+    for (int j = y + size;j > y;j--) visit(x + size, j);
+    for (int i = x + size;i > x;i--) visit(i, y);
+
+    int center = (y + size / 2) * width + x + size / 2;
+    for (size_t k = 0;k < boundary.size();k++) {
+        out.push_back(center);
+        out.push_back(boundary[k]);
+        out.push_back(boundary[(k + 1) % boundary.size()]);
+    }
+
+}
+
+void DepthMesher::triangulate(const uint16_t *depth, float depth_scale) {
+
+    unprojector.min_depth = min_depth;
+    unprojector.max_depth = max_depth;
+    unprojector.n_threads = n_threads;
+    unprojector.unproject(depth, depth_scale, map, false);
+
+    int width = map.width, height = map.height;
+
+    vertices.clear();
+    triangles.clear();
+    if (width < 2 || height < 2) return;
+
+    int cell_size = 1;
+    if (decimate) while (2 * cell_size <= max_cell_size) cell_size *= 2;
+
+    // each block covers one row of top-level cells
+    int n_quads_x = width - 1, n_quads_y = height - 1;
+    int n_blocks = (n_quads_y + cell_size - 1) / cell_size;
+
+    block_cells.resize(n_blocks);
+    block_triangles.resize(n_blocks);
+    pixel_used.assign(width * height, 0);
+
+    if (decimate) {
+
+        parallel_for(0, n_blocks, [&](int b) {
+            block_cells[b].clear();
+            for (int x = 0;x < n_quads_x;x += cell_size) subdivide(x, b * cell_size, cell_size, block_cells[b]);
+        }, 1, n_threads);
+
+        parallel_for_interleaved(n_blocks, [&](int b) {
+            for (const Cell &cell : block_cells[b]) {
+                pixel_used[cell.y * width + cell.x] |= CellCorner;
+                pixel_used[cell.y * width + cell.x + cell.size] |= CellCorner;
+                pixel_used[(cell.y + cell.size) * width + cell.x] |= CellCorner;
+                pixel_used[(cell.y + cell.size) * width + cell.x + cell.size] |= CellCorner;
+            }
+        }, n_threads);
+
+        parallel_for(0, n_blocks, [&](int b) {
+            std::vector<int> boundary;
+            std::vector<int> &out = block_triangles[b];
+            out.clear();
+            for (const Cell &cell : block_cells[b]) {
+                if (cell.size == 1) emit_quad(cell.x, cell.y, out);
+                else emit_fan(cell, boundary, out);
+            }
+        }, 1, n_threads);
+
+    } else {
+
+        parallel_for(0, n_blocks, [&](int y) {
+            std::vector<int> &out = block_triangles[y];
+            out.clear();
+            for (int x = 0;x < n_quads_x;x++) emit_quad(x, y, out);
+        }, 1, n_threads);
+
+    }
+
+    parallel_for_interleaved(n_blocks, [&](int b) {
+        for (int p : block_triangles[b]) pixel_used[p] |= Referenced;
+    }, n_threads);
+
+    // number the referenced pixels row by row
+    row_offsets.resize(height + 1);
+    row_offsets[0] = 0;
+    parallel_for(0, height, [&](int j) {
+        int count = 0;
+        for (int i = 0;i < width;i++) count += (pixel_used[j * width + i] & Referenced) ? 1 : 0;
+        row_offsets[j + 1] = count;
+    }, 8, n_threads);
+    for (int j = 0;j < height;j++) row_offsets[j + 1] += row_offsets[j];
+
+    pixel_vertex.resize(width * height);
+    vertices.resize(row_offsets[height]);
+    parallel_for(0, height, [&](int j) {
+        int index = row_offsets[j];
+        for (int p = j * width;p < (j + 1) * width;p++) {
+            if (pixel_used[p] & Referenced) {
+                vertices[index] = map.points.col(p);
+                pixel_vertex[p] = index++;
+            } else {
+                pixel_vertex[p] = -1;
+            }
+        }
+    }, 8, n_threads);
+
+    std::vector<size_t> block_offsets(n_blocks + 1, 0);
+    for (int b = 0;b < n_blocks;b++) block_offsets[b + 1] = block_offsets[b] + block_triangles[b].size();
+
+    triangles.resize(block_offsets[n_blocks]);
+    parallel_for(0, n_blocks, [&](int b) {
+        unsigned int *out = triangles.data() + block_offsets[b];
+        for (int p : block_triangles[b]) *out++ = (unsigned int)pixel_vertex[p];
+    }, 1, n_threads);
+
+}
+
+void DepthMesher::triangulate(const uint16_t *depth, float depth_scale, SurfaceMesh &mesh) {
+
+    triangulate(depth, depth_scale);
+
+    mesh.clear();
+    mesh.reserve((unsigned int)vertices.size(), (unsigned int)(vertices.size() + triangles.size() / 3), (unsigned int)(triangles.size() / 3));
+
+    for (const Vec3 &p : vertices) mesh.add_vertex(p);
+    for (size_t k = 0;k < triangles.size();k += 3) {
+        mesh.add_triangle(SurfaceMesh::Vertex(triangles[k]), SurfaceMesh::Vertex(triangles[k + 1]), SurfaceMesh::Vertex(triangles[k + 2]));
+    }
+
+}
+
+//=============================================================================
+} // OpenGP::
+//=============================================================================
@@ -0,0 +1,116 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <OpenGP/headeronly.h>
+#include <OpenGP/types.h>
+#include <OpenGP/Image/ImageType.h>
+#include <OpenGP/RGBD/Stream.h>
+#include <OpenGP/RGBD/DepthUnprojector.h>
+#include <OpenGP/SurfaceMesh/SurfaceMesh.h>
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+/// @brief Triangulates organized depth frames into camera-space meshes
+/// @note Neighbouring pixels are connected into two triangles per 2x2 block, and
+/// triangles spanning a depth discontinuity are dropped. With `decimate` enabled, flat
+/// regions are merged into quadtree cells, which are fanned around their center so that
+/// they stay crack-free against smaller neighbours. Triangles face the camera.
+///
+/// The vertex and index buffers are kept between calls, so meshing a stream of frames
+/// of the same resolution does not reallocate them.
+class DepthMesher {
+private:
+
+    /// Quadtree cell covering `size` x `size` pixel quads starting at pixel (x, y)
+    struct Cell {
+        int x, y, size;
+    };
+
+    DepthUnprojector unprojector;
+    PointMap map;
+
+    /// Per block of rows: surviving cells and the triangles they emit (as pixel indices)
+    std::vector<std::vector<Cell>> block_cells;
+    std::vector<std::vector<int>> block_triangles;
+
+    /// Per pixel: cell corner / referenced flags, and the vertex index (-1 if unreferenced)
+    std::vector<uint8_t> pixel_used;
+    std::vector<int> pixel_vertex;
+    std::vector<int> row_offsets;
+
+    std::vector<Vec3> vertices;
+    std::vector<unsigned int> triangles;
+
+    HEADERONLY_INLINE bool is_flat(int x, int y, int size) const;
+    HEADERONLY_INLINE void subdivide(int x, int y, int size, std::vector<Cell> &cells) const;
+    HEADERONLY_INLINE void emit_quad(int x, int y, std::vector<int> &out) const;
+    HEADERONLY_INLINE void emit_fan(const Cell &cell, std::vector<int> &boundary, std::vector<int> &out) const;
+
+public:
+
+    /// Drop triangles whose depth range exceeds this fraction of their nearest depth
+    Scalar depth_edge_threshold = 0.05f;
+
+    /// Merge flat regions into larger triangles
+    bool decimate = false;
+
+    /// Largest quadtree cell in pixels (rounded down to a power of two)
+    int max_cell_size = 16;
+
+    /// A cell is flat if the bilinear interpolation of its corners' inverse depth
+    /// reproduces all its samples to within this fraction of their depth
+    Scalar flatness_threshold = 0.002f;
+
+    /// Ignore depth samples outside of [min_depth, max_depth] (after scaling)
+    Scalar min_depth = 0.1f;
+    Scalar max_depth = 4.0f;
+
+    /// Worker threads (0 uses all hardware threads)
+    int n_threads = 0;
+
+    DepthMesher() {}
+    explicit DepthMesher(const StreamIntrinsics &intrinsics) { set_intrinsics(intrinsics); }
+
+    void set_intrinsics(const StreamIntrinsics &intrinsics) { unprojector.set_intrinsics(intrinsics); }
+    const StreamIntrinsics &get_intrinsics() const { return unprojector.get_intrinsics(); }
+
+    /// @brief Triangulate a row-major raw depth image into the vertex/index buffers
+    /// @see get_vertices(), get_triangles()
+    HEADERONLY_INLINE void triangulate(const uint16_t *depth, float depth_scale);
+
+    /// Triangulate a depth image and replace the contents of `mesh` with the result
+    HEADERONLY_INLINE void triangulate(const uint16_t *depth, float depth_scale, SurfaceMesh &mesh);
+
+    void triangulate(const Image<uint16_t> &depth, float depth_scale, SurfaceMesh &mesh) {
+        assert(depth.cols() == get_intrinsics().width && depth.rows() == get_intrinsics().height);
+        triangulate(depth.data(), depth_scale, mesh);
+    }
+
+    void triangulate(const SensorStream &depth_stream, float depth_scale, SurfaceMesh &mesh) {
+        triangulate((const uint16_t*)depth_stream.get_data(), depth_scale, mesh);
+    }
+
+    /// Camera-space vertex positions of the last frame
+    const std::vector<Vec3> &get_vertices() const { return vertices; }
+
+    /// Triangle index buffer of the last frame (e.g. for `GPUMesh::set_triangles`)
+    const std::vector<unsigned int> &get_triangles() const { return triangles; }
+
+};
+
+//=============================================================================
+} // OpenGP::
+//=============================================================================
+
+#ifdef HEADERONLY
+    #include "DepthMesher.cpp"
+#endif
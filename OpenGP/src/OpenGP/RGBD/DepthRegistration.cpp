@@ -0,0 +1,212 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <algorithm>
+#include <cstring>
+
+#include "DepthRegistration.h"
+
+#include <OpenGP/util/parallel_for.h>
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+void DepthRegistration::set_streams(const SensorStream &depth, const SensorStream &color) {
+    set_calibration(depth.get_intrinsics(), depth.get_extrinsics(), color.get_intrinsics(), color.get_extrinsics());
+}
+
+void DepthRegistration::set_calibration(const StreamIntrinsics &depth_intrinsics, const StreamExtrinsics &depth_extrinsics,
+                                        const StreamIntrinsics &color_intrinsics, const StreamExtrinsics &color_extrinsics) {
+
+    this->depth_intrinsics = depth_intrinsics;
+    this->color_intrinsics = color_intrinsics;
+
+    rotation = color_extrinsics.rotation.transpose() * depth_extrinsics.rotation;
+    translation = color_extrinsics.rotation.transpose() * (depth_extrinsics.translation - color_extrinsics.translation);
+
+    int width = depth_intrinsics.width, height = depth_intrinsics.height;
+    const StreamIntrinsics &K = depth_intrinsics;
+
+    corner_x.resize((width + 1) * (height + 1));
+    corner_y.resize((width + 1) * (height + 1));
+    corner_z.resize((width + 1) * (height + 1));
+
+    for (int j = 0;j <= height;j++) {
+        for (int i = 0;i <= width;i++) {
+            Vec3 ray((i - Scalar(0.5) - K.pixel_center(0)) / K.focal_length(0), (j - Scalar(0.5) - K.pixel_center(1)) / K.focal_length(1), 1);
+            Vec3 r = rotation * ray;
+            int k = j * (width + 1) + i;
+            corner_x(k) = r(0);
+            corner_y(k) = r(1);
+            corner_z(k) = r(2);
+        }
+    }
+
+}
+
+void DepthRegistration::project(const uint16_t *depth, float depth_scale) {
+
+    int width = depth_intrinsics.width, height = depth_intrinsics.height;
+    const StreamIntrinsics &C = color_intrinsics;
+    Scalar inv_scale = 1 / depth_scale;
+
+    footprint_x0.resize(width * height);
+    footprint_x1.resize(width * height);
+    footprint_y0.resize(width * height);
+    footprint_y1.resize(width * height);
+    center_x.resize(width * height);
+    center_y.resize(width * height);
+    color_depth.resize(width * height);
+    row_y0.resize(height);
+    row_y1.resize(height);
+
+    // calibration as locals for the packet expressions
+    const Scalar fx = C.focal_length(0), fy = C.focal_length(1), cx = C.pixel_center(0), cy = C.pixel_center(1);
+    const Scalar tx = translation(0), ty = translation(1), tz = translation(2);
+    const int color_width = C.width, color_height = C.height;
+    const Scalar max_x = (Scalar)color_width, max_y = (Scalar)color_height;
+    const Scalar min_depth = Scalar(1e-4);
+
+    // rows are processed in packets of up to 64 pixels, which stay on the stack
+    using Packet = Eigen::Array<Scalar, Eigen::Dynamic, 1, Eigen::ColMajor, 64, 1>;
+    using Span = Eigen::Map<const Eigen::Array<Scalar, Eigen::Dynamic, 1>>;
+
+    parallel_for(0, height, [&](int j) {
+
+        // top-left corner (i, j) and bottom-right corner (i + 1, j + 1) of every pixel in the row
+        const int top = j * (width + 1), bottom = (j + 1) * (width + 1) + 1;
+
+        for (int i = 0;i < width;i += 64) {
+
+            const int n = std::min(64, width - i), p = j * width + i;
+
+            Packet z = Eigen::Map<const Eigen::Array<uint16_t, Eigen::Dynamic, 1>>(depth + p, n).cast<Scalar>() * depth_scale;
+            Packet Z0 = z * Span(corner_z.data() + top + i, n) + tz;
+            Packet Z1 = z * Span(corner_z.data() + bottom + i, n) + tz;
+
+            // no selects (they do not vectorize): pixels without depth or behind the color
+            // camera are pushed far outside the color image, where their footprint is empty
+            Packet invalid = (min_depth - z.min(Z0).min(Z1)).max(Scalar(0)) * Scalar(1e12);
+            Packet w0 = Z0.max(min_depth).inverse(), w1 = Z1.max(min_depth).inverse();
+
+            Packet u0 = fx * (z * Span(corner_x.data() + top + i, n) + tx) * w0 + cx + invalid;
+            Packet u1 = fx * (z * Span(corner_x.data() + bottom + i, n) + tx) * w1 + cx + invalid;
+            Packet v0 = fy * (z * Span(corner_y.data() + top + i, n) + ty) * w0 + cy;
+            Packet v1 = fy * (z * Span(corner_y.data() + bottom + i, n) + ty) * w1 + cy;
+
+            // the footprint covers the color pixels whose centers lie between the corners,
+            // ceil(min) .. ceil(max) - 1, clamped so that it is empty outside the color image;
+            // coordinates are clamped and offset to be positive so that truncation rounds up
+            const Scalar up = 2 + Scalar(0.99999);
+            Eigen::Map<Eigen::Array<int16_t, Eigen::Dynamic, 1>>(footprint_x0.data() + p, n) =
+                ((u0.min(u1).max(Scalar(-2)).min(max_x) + up).cast<int>() - 2).max(0).cast<int16_t>();
+            Eigen::Map<Eigen::Array<int16_t, Eigen::Dynamic, 1>>(footprint_x1.data() + p, n) =
+                ((u0.max(u1).max(Scalar(-2)).min(max_x) + up).cast<int>() - 3).min(color_width - 1).cast<int16_t>();
+            Eigen::Map<Eigen::Array<int16_t, Eigen::Dynamic, 1>>(footprint_y0.data() + p, n) =
+                ((v0.min(v1).max(Scalar(-2)).min(max_y) + up).cast<int>() - 2).max(0).cast<int16_t>();
+            Eigen::Map<Eigen::Array<int16_t, Eigen::Dynamic, 1>>(footprint_y1.data() + p, n) =
+                ((v0.max(v1).max(Scalar(-2)).min(max_y) + up).cast<int>() - 3).min(color_height - 1).cast<int16_t>();
+
+            // rounded center, -1 or the width / height when outside
+            Eigen::Map<Eigen::Array<int16_t, Eigen::Dynamic, 1>>(center_x.data() + p, n) =
+                ((((u0 + u1) * Scalar(0.5)).max(Scalar(-1)).min(max_x) + Scalar(1.5)).cast<int>() - 1).cast<int16_t>();
+            Eigen::Map<Eigen::Array<int16_t, Eigen::Dynamic, 1>>(center_y.data() + p, n) =
+                ((((v0 + v1) * Scalar(0.5)).max(Scalar(-1)).min(max_y) + Scalar(1.5)).cast<int>() - 1).cast<int16_t>();
+
+            // the center ray is the mean of the corner rays, so its depth is the mean depth
+            Eigen::Map<Eigen::Array<uint16_t, Eigen::Dynamic, 1>>(color_depth.data() + p, n) =
+                ((Z0 + Z1) * (Scalar(0.5) * inv_scale) + Scalar(0.5)).max(Scalar(0)).min(Scalar(65535)).cast<int>().cast<uint16_t>();
+
+        }
+
+        const int16_t *x0 = footprint_x0.data() + j * width, *x1 = footprint_x1.data() + j * width;
+        const int16_t *y0 = footprint_y0.data() + j * width, *y1 = footprint_y1.data() + j * width;
+        int r0 = color_height, r1 = -1;
+        for (int i = 0;i < width;i++) {
+            if (x1[i] < x0[i]) continue;
+            r0 = std::min(r0, (int)y0[i]);
+            r1 = std::max(r1, (int)y1[i]);
+        }
+        row_y0[j] = r0;
+        row_y1[j] = r1;
+
+    }, 8, n_threads);
+
+}
+
+void DepthRegistration::splat(uint16_t *aligned) const {
+
+    int width = depth_intrinsics.width, height = depth_intrinsics.height;
+    int color_width = color_intrinsics.width, color_height = color_intrinsics.height;
+
+    // each band of color rows is owned by one task, which collects the depth rows reaching it
+    int band_height = 16;
+    int n_bands = (color_height + band_height - 1) / band_height;
+
+    parallel_for(0, n_bands, [&](int b) {
+
+        int b0 = b * band_height, b1 = std::min(b0 + band_height, color_height) - 1;
+        std::fill(aligned + b0 * color_width, aligned + (b1 + 1) * color_width, 0);
+
+        for (int j = 0;j < height;j++) {
+
+            if (row_y1[j] < b0 || row_y0[j] > b1) continue;
+
+            for (int p = j * width;p < (j + 1) * width;p++) {
+
+                int x0 = footprint_x0[p], x1 = footprint_x1[p];
+                if (x1 < x0) continue;
+                int y0 = std::max((int)footprint_y0[p], b0), y1 = std::min((int)footprint_y1[p], b1);
+
+                uint16_t z = color_depth[p];
+                for (int y = y0;y <= y1;y++) {
+                    uint16_t *out = aligned + y * color_width;
+                    for (int x = x0;x <= x1;x++) {
+                        if (out[x] == 0 || z < out[x]) out[x] = z;
+                    }
+                }
+
+            }
+
+        }
+
+    }, 1, n_threads);
+
+}
+
+void DepthRegistration::align_depth_to_color(const uint16_t *depth, float depth_scale, uint16_t *aligned) {
+    project(depth, depth_scale);
+    splat(aligned);
+}
+
+void DepthRegistration::align_color_to_depth(const uint16_t *depth, float depth_scale, const uint8_t *color, int channels, uint8_t *aligned) {
+
+    project(depth, depth_scale);
+
+    zbuffer.resize(color_intrinsics.width * color_intrinsics.height);
+    splat(zbuffer.data());
+
+    int width = depth_intrinsics.width, height = depth_intrinsics.height;
+    int color_width = color_intrinsics.width, color_height = color_intrinsics.height;
+    Scalar tolerance = 1 + occlusion_tolerance;
+
+    parallel_for(0, height, [&](int j) {
+        for (int p = j * width;p < (j + 1) * width;p++) {
+            int x = center_x[p], y = center_y[p], c = y * color_width + x;
+            uint8_t *out = aligned + p * channels;
+            if (x < 0 || x >= color_width || y < 0 || y >= color_height || color_depth[p] > zbuffer[c] * tolerance) {
+                std::memset(out, 0, channels);
+            } else {
+                std::memcpy(out, color + c * channels, channels);
+            }
+        }
+    }, 8, n_threads);
+
+}
+
+//=============================================================================
+} // OpenGP::
+//=============================================================================
@@ -0,0 +1,105 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <OpenGP/headeronly.h>
+#include <OpenGP/types.h>
+#include <OpenGP/Image/ImageType.h>
+#include <OpenGP/RGBD/Stream.h>
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+/// @brief Registers a depth stream to a color stream of the same rig
+/// @note `StreamExtrinsics` are taken as the pose of each stream's camera in a common device
+/// frame (p_device = rotation * p_stream + translation, in metres).
+///
+/// The viewing rays of the depth pixel corners, rotated into the color camera, are
+/// precomputed per rig. Per frame, every depth pixel is projected as the footprint between
+/// two opposite corners, rows at a time with packet math, and splatted into the color
+/// image keeping the nearest depth (z-buffer). Both steps run on all threads.
+class DepthRegistration {
+private:
+
+    StreamIntrinsics depth_intrinsics;
+    StreamIntrinsics color_intrinsics;
+
+    /// Depth camera to color camera
+    Mat3x3 rotation = Mat3x3::Identity();
+    Vec3 translation = Vec3::Zero();
+
+    /// Rotated rays through the depth pixel corners, (width + 1) x (height + 1) row-major
+    Eigen::Array<Scalar, Eigen::Dynamic, 1> corner_x, corner_y, corner_z;
+
+    /// Per depth pixel: footprint in the color image (empty if x1 < x0, always for invalid
+    /// pixels), color pixel under its center (out of range if outside the image) and raw
+    /// depth in the color camera
+    std::vector<int16_t> footprint_x0, footprint_x1, footprint_y0, footprint_y1;
+    std::vector<int16_t> center_x, center_y;
+    std::vector<uint16_t> color_depth;
+
+    /// Range of color rows touched by each depth row
+    std::vector<int> row_y0, row_y1;
+
+    /// Color resolution z-buffer used for occlusion tests
+    std::vector<uint16_t> zbuffer;
+
+    HEADERONLY_INLINE void project(const uint16_t *depth, float depth_scale);
+    HEADERONLY_INLINE void splat(uint16_t *aligned) const;
+
+public:
+
+    /// Color samples whose color camera depth exceeds the nearest depth by this fraction are occluded
+    Scalar occlusion_tolerance = 0.02f;
+
+    /// Worker threads (0 uses all hardware threads)
+    int n_threads = 0;
+
+    DepthRegistration() {}
+    DepthRegistration(const SensorStream &depth, const SensorStream &color) { set_streams(depth, color); }
+
+    HEADERONLY_INLINE void set_streams(const SensorStream &depth, const SensorStream &color);
+
+    /// Rebuild the reprojection tables for a new calibration
+    HEADERONLY_INLINE void set_calibration(const StreamIntrinsics &depth_intrinsics, const StreamExtrinsics &depth_extrinsics,
+                                           const StreamIntrinsics &color_intrinsics, const StreamExtrinsics &color_extrinsics);
+
+    /// @brief Depth as seen from the color camera, at color resolution
+    /// @param aligned color width x height raw depth (same scale as the input, 0 where unknown)
+    HEADERONLY_INLINE void align_depth_to_color(const uint16_t *depth, float depth_scale, uint16_t *aligned);
+
+    /// @brief Color sampled at every depth pixel, at depth resolution
+    /// @param aligned depth width x height pixels of `channels` bytes (0 where occluded or outside the color image)
+    HEADERONLY_INLINE void align_color_to_depth(const uint16_t *depth, float depth_scale, const uint8_t *color, int channels, uint8_t *aligned);
+
+    void align_depth_to_color(const Image<uint16_t> &depth, float depth_scale, Image<uint16_t> &aligned) {
+        aligned.resize(color_intrinsics.height, color_intrinsics.width);
+        align_depth_to_color(depth.data(), depth_scale, aligned.data());
+    }
+
+    template <typename Pixel>
+    void align_color_to_depth(const Image<uint16_t> &depth, float depth_scale, const Image<Pixel> &color, Image<Pixel> &aligned) {
+        static_assert(sizeof(Pixel) <= 4, "8-bit color pixels expected");
+        aligned.resize(depth_intrinsics.height, depth_intrinsics.width);
+        align_color_to_depth(depth.data(), depth_scale, (const uint8_t*)color.data(), sizeof(Pixel), (uint8_t*)aligned.data());
+    }
+
+    const StreamIntrinsics &get_depth_intrinsics() const { return depth_intrinsics; }
+    const StreamIntrinsics &get_color_intrinsics() const { return color_intrinsics; }
+
+};
+
+//=============================================================================
+} // OpenGP::
+//=============================================================================
+
+#ifdef HEADERONLY
+    #include "DepthRegistration.cpp"
+#endif
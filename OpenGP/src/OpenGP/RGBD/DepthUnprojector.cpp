@@ -0,0 +1,159 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "DepthUnprojector.h"
+
+#include <OpenGP/util/parallel_for.h>
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+int PointMap::valid_points(Mat3xN &out) const {
+
+    int n = (int)(mask != 0).count();
+    out.resize(3, n);
+
+    int k = 0;
+    for (int p = 0;p < (int)mask.size();p++) {
+        if (mask(p)) out.col(k++) = points.col(p);
+    }
+
+    return n;
+
+}
+
+int PointMap::valid_points(Mat3xN &points_out, Mat3xN &normals_out) const {
+
+    int n = 0;
+    for (int p = 0;p < (int)normals.cols();p++) {
+        if (!std::isnan(normals(0, p))) n++;
+    }
+
+    points_out.resize(3, n);
+    normals_out.resize(3, n);
+
+    int k = 0;
+    for (int p = 0;p < (int)normals.cols();p++) {
+        if (std::isnan(normals(0, p))) continue;
+        points_out.col(k) = points.col(p);
+        normals_out.col(k) = normals.col(p);
+        k++;
+    }
+
+    return n;
+
+}
+
+void DepthUnprojector::set_intrinsics(const StreamIntrinsics &intrinsics) {
+
+    this->intrinsics = intrinsics;
+
+    ray_x.resize(intrinsics.width);
+    ray_y.resize(intrinsics.height);
+
+    for (int i = 0;i < intrinsics.width;i++) {
+        ray_x(i) = (i - intrinsics.pixel_center(0)) / intrinsics.focal_length(0);
+    }
+    for (int j = 0;j < intrinsics.height;j++) {
+        ray_y(j) = (j - intrinsics.pixel_center(1)) / intrinsics.focal_length(1);
+    }
+
+}
+
+template <typename DepthType>
+void DepthUnprojector::unproject_impl(const DepthType *depth, float depth_scale, PointMap &out, bool with_normals) const {
+
+    int width = intrinsics.width, height = intrinsics.height;
+
+    out.width = width;
+    out.height = height;
+    out.points.resize(3, width * height);
+    out.mask.resize(width * height);
+
+    const Scalar invalid = nan();
+
+    parallel_for(0, height, [&](int j) {
+
+        Eigen::Map<const Eigen::Array<DepthType, Eigen::Dynamic, 1>> raw(depth + j * width, width);
+        auto x = out.points.row(0).segment(j * width, width).array();
+        auto y = out.points.row(1).segment(j * width, width).array();
+        auto z = out.points.row(2).segment(j * width, width).array();
+
+        // scale in place, then NaN marks invalid samples so that normals computed from them are invalid as well
+        z = raw.template cast<Scalar>() * depth_scale;
+        out.mask.segment(j * width, width) = ((z >= min_depth) && (z <= max_depth)).template cast<uint8_t>();
+        z = ((z >= min_depth) && (z <= max_depth)).select(z, invalid);
+
+        x = z * ray_x.transpose();
+        y = z * ray_y(j);
+
+    }, 8, n_threads);
+
+    if (with_normals) {
+        compute_normals(out);
+    } else {
+        out.normals.resize(3, 0);
+    }
+
+}
+
+void DepthUnprojector::unproject(const uint16_t *depth, float depth_scale, PointMap &out, bool with_normals) const {
+    unproject_impl(depth, depth_scale, out, with_normals);
+}
+
+void DepthUnprojector::unproject(const float *depth, PointMap &out, bool with_normals) const {
+    unproject_impl(depth, 1.0f, out, with_normals);
+}
+
+void DepthUnprojector::compute_normals(PointMap &out) const {
+
+    int width = out.width, height = out.height;
+    const Scalar invalid = nan();
+
+    out.normals.resize(3, width * height);
+
+    parallel_for(0, height, [&](int j) {
+
+        int row = j * width;
+
+        // no lower/right neighbour on the last row and column
+        if (j == height - 1) {
+            out.normals.middleCols(row, width).setConstant(invalid);
+            return;
+        }
+
+        int n = width - 1;
+
+        using Row = Eigen::Array<Scalar, Eigen::Dynamic, 1>;
+        auto P = [&](int c, int offset) { return out.points.row(c).segment(offset, n).array(); };
+
+        // a = lower neighbour - p, b = right neighbour - p
+        Row ax = P(0, row + width) - P(0, row);
+        Row ay = P(1, row + width) - P(1, row);
+        Row az = P(2, row + width) - P(2, row);
+        Row bx = P(0, row + 1) - P(0, row);
+        Row by = P(1, row + 1) - P(1, row);
+        Row bz = P(2, row + 1) - P(2, row);
+
+        // a x b points towards the camera. NaN inputs propagate, and a zero-length
+        // normal gives 0 * rsqrt(0) = NaN, so invalid normals need no branches
+        Row nx = ay * bz - az * by;
+        Row ny = az * bx - ax * bz;
+        Row nz = ax * by - ay * bx;
+        Row inv_norm = (nx * nx + ny * ny + nz * nz).rsqrt();
+
+        out.normals.row(0).segment(row, n).array() = nx * inv_norm;
+        out.normals.row(1).segment(row, n).array() = ny * inv_norm;
+        out.normals.row(2).segment(row, n).array() = nz * inv_norm;
+        out.normals.col(row + n).setConstant(invalid);
+
+    }, 8, n_threads);
+
+}
+
+//=============================================================================
+} // OpenGP::
+//=============================================================================
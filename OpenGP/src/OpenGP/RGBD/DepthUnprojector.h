@@ -0,0 +1,107 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <cstdint>
+
+#include <OpenGP/headeronly.h>
+#include <OpenGP/types.h>
+#include <OpenGP/Image/ImageType.h>
+#include <OpenGP/RGBD/Stream.h>
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+/// @brief Organized point cloud and normal map of a depth frame
+/// @note Stored as x/y/z planes (one contiguous row per coordinate) so whole image
+/// rows can be processed with packet math. Pixel (i, j) is column `j * width + i`,
+/// invalid samples are NaN.
+struct PointMap {
+
+    using Planes = Eigen::Matrix<Scalar, 3, Eigen::Dynamic, Eigen::RowMajor>;
+
+    int width = 0, height = 0;
+
+    Planes points;
+    Planes normals;
+
+    /// 1 where the depth sample was inside the accepted range
+    Eigen::Array<uint8_t, Eigen::Dynamic, 1> mask;
+
+    Vec3 point(int i, int j) const { return points.col(j * width + i); }
+    Vec3 normal(int i, int j) const { return normals.col(j * width + i); }
+
+    bool is_valid(int i, int j) const { return mask(j * width + i) != 0; }
+    bool has_normal(int i, int j) const { return !std::isnan(normals(0, j * width + i)); }
+
+    /// Copy the valid points into `out` (e.g. for `PointsRenderer`), returns the number of points
+    HEADERONLY_INLINE int valid_points(Mat3xN &out) const;
+
+    /// Copy the points that have a normal into `points_out` and `normals_out`, returns the number of points
+    HEADERONLY_INLINE int valid_points(Mat3xN &points_out, Mat3xN &normals_out) const;
+
+};
+
+/// @brief Bulk conversion of depth images into organized point clouds and normal maps
+/// @note The per-pixel viewing rays are precomputed when the intrinsics are set. For
+/// a pinhole model they are separable, so the table is one x factor per column and one
+/// y factor per row.
+class DepthUnprojector {
+private:
+
+    StreamIntrinsics intrinsics;
+
+    Eigen::Array<Scalar, Eigen::Dynamic, 1> ray_x; ///< (i - cx) / fx for every column
+    Eigen::Array<Scalar, Eigen::Dynamic, 1> ray_y; ///< (j - cy) / fy for every row
+
+    template <typename DepthType>
+    void unproject_impl(const DepthType *depth, float depth_scale, PointMap &out, bool with_normals) const;
+
+public:
+
+    /// Ignore depth samples outside of [min_depth, max_depth] (after scaling)
+    Scalar min_depth = 0.1f;
+    Scalar max_depth = 4.0f;
+
+    /// Worker threads (0 uses all hardware threads)
+    int n_threads = 0;
+
+    DepthUnprojector() {}
+    explicit DepthUnprojector(const StreamIntrinsics &intrinsics) { set_intrinsics(intrinsics); }
+
+    /// Rebuild the ray lookup table for new intrinsics
+    HEADERONLY_INLINE void set_intrinsics(const StreamIntrinsics &intrinsics);
+
+    const StreamIntrinsics &get_intrinsics() const { return intrinsics; }
+
+    /// Convert a row-major raw depth image (e.g. a depth stream frame)
+    HEADERONLY_INLINE void unproject(const uint16_t *depth, float depth_scale, PointMap &out, bool with_normals = true) const;
+
+    /// Convert a row-major metric depth image (0 marks missing samples)
+    HEADERONLY_INLINE void unproject(const float *depth, PointMap &out, bool with_normals = true) const;
+
+    void unproject(const Image<uint16_t> &depth, float depth_scale, PointMap &out, bool with_normals = true) const {
+        assert(depth.cols() == intrinsics.width && depth.rows() == intrinsics.height);
+        unproject(depth.data(), depth_scale, out, with_normals);
+    }
+
+    void unproject(const SensorStream &depth_stream, float depth_scale, PointMap &out, bool with_normals = true) const {
+        unproject((const uint16_t*)depth_stream.get_data(), depth_scale, out, with_normals);
+    }
+
+    /// Fill in `out.normals` from the points (cross product of the right and lower neighbours)
+    HEADERONLY_INLINE void compute_normals(PointMap &out) const;
+
+};
+
+//=============================================================================
+} // OpenGP::
+//=============================================================================
+
+#ifdef HEADERONLY
+    #include "DepthUnprojector.cpp"
+#endif
@@ -0,0 +1,117 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <cstring>
+#include <cassert>
+#include <thread>
+#include <unordered_map>
+
+#include "FrameChannel.h"
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+FrameChannel::FrameChannel(const std::vector<size_t> &stream_sizes) {
+    allocate(stream_sizes);
+}
+
+FrameChannel::FrameChannel(const SensorDevice &device) : depth_scale(device.get_depth_scale()) {
+
+    std::vector<size_t> stream_sizes;
+    for (const SensorStream &stream : device.get_streams()) {
+        if (stream.get_frame_size() == 0) continue;
+        streams.push_back(&stream);
+        stream_sizes.push_back(stream.get_frame_size());
+    }
+
+    allocate(stream_sizes);
+
+}
+
+void FrameChannel::allocate(const std::vector<size_t> &stream_sizes) {
+
+    for (Frame &frame : buffers) {
+        frame.data.resize(stream_sizes.size());
+        for (size_t s = 0;s < stream_sizes.size();s++) frame.data[s].assign(stream_sizes[s], 0);
+    }
+
+    front_data.resize(stream_sizes.size());
+    for (size_t s = 0;s < stream_sizes.size();s++) front_data[s] = buffers[front].get_data(s);
+
+}
+
+int FrameChannel::find_stream(const char *name) const {
+    for (size_t s = 0;s < streams.size();s++) {
+        if (std::strcmp(streams[s]->get_name(), name) == 0) return (int)s;
+    }
+    return -1;
+}
+
+uint64_t FrameChannel::publish() {
+
+    Frame &frame = buffers[back];
+    frame.sequence = ++sequence;
+
+    // release makes the frame contents visible to the consumer that picks up this index
+    uint8_t previous = ready.exchange((uint8_t)(back | fresh_bit), std::memory_order_acq_rel);
+    back = previous & 3;
+
+    return frame.sequence;
+
+}
+
+uint64_t FrameChannel::publish(const SensorDevice &device) {
+
+    assert(!streams.empty());
+
+    Frame &frame = buffers[back];
+    for (size_t s = 0;s < streams.size();s++) {
+        std::memcpy(frame.get_data(s), device.get_stream(streams[s]->get_name()).get_data(), frame.data[s].size());
+    }
+
+    return publish();
+
+}
+
+const FrameChannel::Frame *FrameChannel::acquire() {
+
+    if (!has_new_frame()) return nullptr;
+
+    uint8_t previous = ready.exchange((uint8_t)front, std::memory_order_acq_rel);
+    front = previous & 3;
+
+    for (size_t s = 0;s < front_data.size();s++) front_data[s] = buffers[front].get_data(s);
+
+    return &buffers[front];
+
+}
+
+SensorDevice FrameChannel::get_device() {
+
+    std::unordered_map<std::string, SensorStream> device_streams;
+
+    for (size_t s = 0;s < streams.size();s++) {
+        const SensorStream &stream = *streams[s];
+        device_streams.emplace(
+            std::piecewise_construct,
+            std::forward_as_tuple(stream.get_name()),
+            std::forward_as_tuple(stream.get_name(), &front_data[s], stream.get_intrinsics(), stream.get_extrinsics(), stream.get_framerate(), stream.get_format())
+        );
+    }
+
+    return SensorDevice(depth_scale, device_streams, [this](bool block) {
+        while (!acquire()) {
+            if (!block) return false;
+            std::this_thread::yield();
+        }
+        return true;
+    });
+
+}
+
+//=============================================================================
+} // OpenGP::
+//=============================================================================
@@ -0,0 +1,123 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <cstdint>
+
+#include <OpenGP/headeronly.h>
+#include <OpenGP/RGBD/Stream.h>
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+/// @brief Lock-free triple-buffered handoff of sensor frames between two threads
+/// @note One producer thread fills the back buffer and publishes it, one consumer thread
+/// acquires the newest published frame. Neither ever waits for the other: frames the
+/// consumer was too slow to see are overwritten (visible as gaps in the sequence numbers),
+/// and an acquired frame stays valid until the consumer's next `acquire()`.
+///
+/// Chain channels to decouple capture, processing and rendering threads:
+///
+///     FrameChannel channel(device);                    // capture thread
+///     while (...) { device.advance_frame(); channel.publish(device); }
+///
+///     SensorDevice frames = channel.get_device();      // processing thread
+///     while (...) { frames.advance_frame(); process(frames.get_stream("DEPTH")); }
+///
+class FrameChannel {
+public:
+
+    struct Frame {
+        uint64_t sequence = 0; ///< 1 for the first published frame, 0 before any
+        std::vector<std::vector<uint8_t>> data; ///< one buffer per stream
+
+        const void *get_data(size_t stream) const { return data[stream].data(); }
+        void *get_data(size_t stream) { return data[stream].data(); }
+    };
+
+private:
+
+    static const uint8_t fresh_bit = 4;
+
+    Frame buffers[3];
+
+    /// Index of the published buffer, plus `fresh_bit` while the consumer has not taken it
+    std::atomic<uint8_t> ready{0};
+
+    int back = 1;  ///< owned by the producer
+    int front = 2; ///< owned by the consumer
+
+    uint64_t sequence = 0;
+
+    /// Source streams, and the consumer's view of them for `get_device()`
+    std::vector<const SensorStream*> streams;
+    std::vector<const void*> front_data;
+    float depth_scale = 1;
+
+    HEADERONLY_INLINE void allocate(const std::vector<size_t> &stream_sizes);
+
+public:
+
+    /// A channel for arbitrary buffers of the given sizes
+    HEADERONLY_INLINE explicit FrameChannel(const std::vector<size_t> &stream_sizes);
+
+    /// A channel for the streams of `device` (streams of unknown format are skipped)
+    HEADERONLY_INLINE explicit FrameChannel(const SensorDevice &device);
+
+    FrameChannel(const FrameChannel&) = delete;
+    FrameChannel &operator=(const FrameChannel&) = delete;
+
+    size_t get_n_streams() const { return buffers[0].data.size(); }
+
+    /// Stream index of a device stream by name (-1 if not in the channel)
+    HEADERONLY_INLINE int find_stream(const char *name) const;
+
+    /// @name Producer
+    /// @{
+
+    /// The buffer to fill before the next `publish()`
+    Frame &get_back_buffer() { return buffers[back]; }
+
+    /// Hand the back buffer to the consumer, returns its sequence number
+    HEADERONLY_INLINE uint64_t publish();
+
+    /// Copy the current frame of the device's streams (matched by name) into the back buffer and publish it
+    HEADERONLY_INLINE uint64_t publish(const SensorDevice &device);
+
+    /// @}
+
+    /// @name Consumer
+    /// @{
+
+    /// Whether a frame newer than the acquired one has been published
+    bool has_new_frame() const { return (ready.load(std::memory_order_acquire) & fresh_bit) != 0; }
+
+    /// The newest published frame, or nullptr if none was published since the last call
+    HEADERONLY_INLINE const Frame *acquire();
+
+    /// The most recently acquired frame
+    const Frame &get_front_buffer() const { return buffers[front]; }
+
+    /// @brief A device whose streams show the acquired frames (built from the source device's streams)
+    /// @note `advance_frame()` yields until a new frame is published, `try_advance_frame()`
+    /// returns false if there is none. The device refers to the channel and must not outlive it.
+    HEADERONLY_INLINE SensorDevice get_device();
+
+    /// @}
+
+};
+
+//=============================================================================
+} // OpenGP::
+//=============================================================================
+
+#ifdef HEADERONLY
+    #include "FrameChannel.cpp"
+#endif
@@ -0,0 +1,320 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <limits>
+
+#include "ICP.h"
+
+#include <OpenGP/util/parallel_for.h>
+#include <OpenGP/external/nanoflann/nanoflann.hpp>
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+struct PointToPlaneICP::KDTree {
+
+    std::vector<Vec3> points;
+    std::vector<Vec3> normals;
+
+    // nanoflann dataset interface
+    size_t kdtree_get_point_count() const { return points.size(); }
+    Scalar kdtree_get_pt(const size_t idx, int dim) const { return points[idx](dim); }
+    Scalar kdtree_distance(const Scalar *p, const size_t idx, size_t) const { return (Eigen::Map<const Vec3>(p) - points[idx]).squaredNorm(); }
+    template <class BBox> bool kdtree_get_bbox(BBox &) const { return false; }
+
+    using Index = nanoflann::KDTreeSingleIndexAdaptor<nanoflann::L2_Simple_Adaptor<Scalar, KDTree>, KDTree, 3, int>;
+
+    std::unique_ptr<Index> index;
+
+};
+
+struct PointToPlaneICP::NormalEquations {
+
+    using Vec6d = Eigen::Matrix<double, 6, 1, Eigen::DontAlign>;
+    using Mat6x6d = Eigen::Matrix<double, 6, 6, Eigen::DontAlign>;
+
+    Mat6x6d A = Mat6x6d::Zero();
+    Vec6d b = Vec6d::Zero();
+    double error = 0;
+    int count = 0;
+
+};
+
+namespace {
+
+inline Vec3 transform_point(const Mat4x4 &T, const Vec3 &p) {
+    return T.block<3, 3>(0, 0) * p + T.block<3, 1>(0, 3);
+}
+
+inline Mat4x4 inverse_rigid(const Mat4x4 &T) {
+    Mat4x4 inv = Mat4x4::Identity();
+    inv.block<3, 3>(0, 0) = T.block<3, 3>(0, 0).transpose();
+    inv.block<3, 1>(0, 3) = -inv.block<3, 3>(0, 0) * T.block<3, 1>(0, 3);
+    return inv;
+}
+
+}
+
+PointToPlaneICP::PointToPlaneICP() {}
+
+void PointToPlaneICP::build_pyramid(const uint16_t *depth, const StreamIntrinsics &intrinsics, float depth_scale, std::vector<Level> &levels, bool keep_finest) const {
+
+    int n_levels = (int)iterations.size();
+    levels.resize(n_levels);
+
+    std::vector<Scalar> level_depth(intrinsics.width * intrinsics.height);
+    for (size_t k = 0;k < level_depth.size();k++) {
+        Scalar d = depth[k] * depth_scale;
+        level_depth[k] = (d >= min_depth && d <= max_depth) ? d : 0;
+    }
+
+    // levels without iterations only need their depth, to feed the next coarser level
+    auto needed = [&](int l) { return iterations[l] > 0 || (l == 0 && keep_finest); };
+
+    auto unproject = [&](const std::vector<Scalar> &depth, Level &level) {
+        DepthUnprojector unprojector(level.intrinsics);
+        unprojector.min_depth = std::max(min_depth, std::numeric_limits<Scalar>::min());
+        unprojector.max_depth = max_depth;
+        unprojector.n_threads = n_threads;
+        unprojector.unproject(depth.data(), level.map);
+    };
+
+    levels[0].intrinsics = intrinsics;
+    if (needed(0)) unproject(level_depth, levels[0]);
+
+    for (int l = 1;l < n_levels;l++) {
+
+        const StreamIntrinsics &fine = levels[l - 1].intrinsics;
+        StreamIntrinsics &coarse = levels[l].intrinsics;
+        coarse.width = fine.width / 2;
+        coarse.height = fine.height / 2;
+        coarse.focal_length = fine.focal_length / 2;
+        coarse.pixel_center = (fine.pixel_center + Vec2(0.5f, 0.5f)) / 2 - Vec2(0.5f, 0.5f);
+
+        // average the valid samples of each 2x2 block that lie close to the nearest one,
+        // so depth discontinuities are not smeared into floating points
+        std::vector<Scalar> coarse_depth(coarse.width * coarse.height, 0);
+        for (int j = 0;j < coarse.height;j++) {
+            for (int i = 0;i < coarse.width;i++) {
+                Scalar samples[4] = {
+                    level_depth[(2 * j) * fine.width + 2 * i], level_depth[(2 * j) * fine.width + 2 * i + 1],
+                    level_depth[(2 * j + 1) * fine.width + 2 * i], level_depth[(2 * j + 1) * fine.width + 2 * i + 1],
+                };
+                Scalar nearest = std::numeric_limits<Scalar>::max();
+                for (Scalar d : samples) if (d > 0) nearest = std::min(nearest, d);
+                Scalar sum = 0;
+                int count = 0;
+                for (Scalar d : samples) {
+                    if (d > 0 && d - nearest < max_distance) {
+                        sum += d;
+                        count++;
+                    }
+                }
+                coarse_depth[j * coarse.width + i] = count > 0 ? sum / count : 0;
+            }
+        }
+
+        if (needed(l)) unproject(coarse_depth, levels[l]);
+        level_depth.swap(coarse_depth);
+
+    }
+
+}
+
+void PointToPlaneICP::build_kdtree(std::vector<Vec3> &&points, std::vector<Vec3> &&normals) {
+
+    kdtree = std::make_shared<KDTree>();
+    kdtree->points = std::move(points);
+    kdtree->normals = std::move(normals);
+    kdtree->index.reset(new KDTree::Index(3, *kdtree, nanoflann::KDTreeSingleIndexAdaptorParams(10)));
+    kdtree->index->buildIndex();
+
+}
+
+void PointToPlaneICP::set_target(const uint16_t *depth, const StreamIntrinsics &intrinsics, float depth_scale, const Mat4x4 &camera_to_world) {
+
+    if (iterations.empty()) return;
+
+    // kd-tree targets are built from the full resolution points
+    build_pyramid(depth, intrinsics, depth_scale, target_levels, association == Association::KDTree);
+    target_pose = camera_to_world;
+    target_is_frame = true;
+
+    if (association == Association::KDTree) {
+        std::vector<Vec3> points, normals;
+        const PointMap &map = target_levels[0].map;
+        for (int k = 0;k < map.normals.cols();k++) {
+            if (std::isnan(map.normals(0, k))) continue;
+            points.push_back(transform_point(camera_to_world, map.points.col(k)));
+            normals.push_back(camera_to_world.block<3, 3>(0, 0) * map.normals.col(k));
+        }
+        build_kdtree(std::move(points), std::move(normals));
+    } else {
+        kdtree.reset();
+    }
+
+}
+
+void PointToPlaneICP::set_target(const SurfaceMesh &mesh, const Mat4x4 &model) {
+
+    target_levels.clear();
+    target_is_frame = false;
+
+    auto vpoint = mesh.get_vertex_property<Vec3>("v:point");
+
+    std::vector<Vec3> points, normals;
+    points.reserve(mesh.n_vertices());
+    normals.reserve(mesh.n_vertices());
+
+    for (auto v : mesh.vertices()) {
+        Vec3 n = mesh.compute_vertex_normal(v);
+        if (!(n.squaredNorm() > 0)) continue;
+        points.push_back(transform_point(model, vpoint[v]));
+        normals.push_back((model.block<3, 3>(0, 0) * n).normalized());
+    }
+
+    build_kdtree(std::move(points), std::move(normals));
+
+}
+
+ICPResult PointToPlaneICP::align(const uint16_t *depth, const StreamIntrinsics &intrinsics, float depth_scale, const Mat4x4 &initial_pose) const {
+
+    ICPResult result;
+    result.pose = initial_pose;
+
+    bool projective = target_is_frame && association == Association::Projective;
+    if (iterations.empty() || (!projective && !kdtree)) return result;
+
+    // the target pyramid follows `iterations` as it was in `set_target`, a stale one is rejected
+    if (projective) {
+        if (target_levels.size() != iterations.size()) return result;
+        for (size_t l = 0;l < iterations.size();l++) {
+            if (iterations[l] > 0 && target_levels[l].map.normals.cols() == 0) return result;
+        }
+    }
+
+    std::vector<Level> levels;
+    build_pyramid(depth, intrinsics, depth_scale, levels, false);
+
+    // solve in the target camera frame for projective association, so target samples
+    // can be used as-is, and in world space for the kd-tree
+    Mat4x4 to_frame = projective ? inverse_rigid(target_pose) : Mat4x4::Identity();
+    Mat4x4 from_frame = projective ? target_pose : Mat4x4::Identity();
+    Mat4x4 frame_pose = to_frame * initial_pose;
+
+    Scalar max_distance2 = max_distance * max_distance;
+
+    int n = n_threads > 0 ? n_threads : hardware_threads();
+    std::vector<NormalEquations> partial(n);
+
+    for (int l = (int)levels.size() - 1;l >= 0;l--) {
+
+        const Level &source = levels[l];
+        const Level *target = projective ? &target_levels[l] : nullptr;
+        int n_pixels = (int)source.map.normals.cols();
+
+        result.converged = false;
+
+        for (int it = 0;it < iterations[l];it++) {
+
+            Mat3x3 pose_rotation = frame_pose.block<3, 3>(0, 0);
+            Vec3 pose_translation = frame_pose.block<3, 1>(0, 3);
+
+            for (auto &p : partial) p = NormalEquations();
+
+            parallel_ranges(0, n_pixels, [&](int thread, int begin, int end) {
+
+                NormalEquations sums;
+
+                for (int k = begin;k < end;k++) {
+
+                    if (std::isnan(source.map.normals(0, k))) continue;
+
+                    Vec3 p = pose_rotation * source.map.points.col(k) + pose_translation;
+                    Vec3 np = pose_rotation * source.map.normals.col(k);
+
+                    Vec3 q, nq;
+
+                    if (projective) {
+                        if (p(2) <= 0) continue;
+                        const StreamIntrinsics &K = target->intrinsics;
+                        Scalar inv_z = 1 / p(2);
+                        int u = (int)std::floor(p(0) * inv_z * K.focal_length(0) + K.pixel_center(0) + 0.5f);
+                        int v = (int)std::floor(p(1) * inv_z * K.focal_length(1) + K.pixel_center(1) + 0.5f);
+                        if (u < 0 || v < 0 || u >= K.width || v >= K.height) continue;
+                        nq = target->map.normals.col(v * K.width + u);
+                        if (std::isnan(nq(0))) continue;
+                        q = target->map.points.col(v * K.width + u);
+                    } else {
+                        int index;
+                        Scalar distance2;
+                        kdtree->index->knnSearch(p.data(), 1, &index, &distance2);
+                        q = kdtree->points[index];
+                        nq = kdtree->normals[index];
+                    }
+
+                    if ((p - q).squaredNorm() > max_distance2) continue;
+                    if (np.dot(nq) < min_normal_dot) continue;
+
+                    double r = nq.dot(p - q);
+                    NormalEquations::Vec6d J;
+                    J.head<3>() = p.cross(nq).cast<double>();
+                    J.tail<3>() = nq.cast<double>();
+
+                    sums.A.noalias() += J * J.transpose();
+                    sums.b -= J * r;
+                    sums.error += r * r;
+                    sums.count++;
+
+                }
+
+                partial[thread] = sums;
+
+            }, n);
+
+            NormalEquations total;
+            for (auto &p : partial) {
+                total.A += p.A;
+                total.b += p.b;
+                total.error += p.error;
+                total.count += p.count;
+            }
+
+            result.iterations++;
+            result.correspondences = total.count;
+            result.rms_error = total.count > 0 ? (Scalar)std::sqrt(total.error / total.count) : 0;
+
+            // need at least enough constraints for the six degrees of freedom
+            if (total.count < 6) break;
+
+            Eigen::Matrix<double, 6, 1> x = Eigen::Matrix<double, 6, 6>(total.A).ldlt().solve(Eigen::Matrix<double, 6, 1>(total.b));
+            if (!x.allFinite()) break;
+
+            Vec3 omega = x.head<3>().cast<Scalar>();
+            Mat4x4 update = Mat4x4::Identity();
+            Scalar angle = omega.norm();
+            if (angle > 0) update.block<3, 3>(0, 0) = Eigen::AngleAxis<Scalar>(angle, omega / angle).toRotationMatrix();
+            update.block<3, 1>(0, 3) = x.tail<3>().cast<Scalar>();
+
+            frame_pose = update * frame_pose;
+            result.pose = from_frame * frame_pose;
+
+            if (x.norm() < convergence_threshold) {
+                result.converged = true;
+                break;
+            }
+
+        }
+
+    }
+
+    return result;
+
+}
+
+//=============================================================================
+} // OpenGP::
+//=============================================================================
@@ -0,0 +1,122 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include <OpenGP/headeronly.h>
+#include <OpenGP/types.h>
+#include <OpenGP/Image/ImageType.h>
+#include <OpenGP/RGBD/Stream.h>
+#include <OpenGP/RGBD/DepthUnprojector.h>
+#include <OpenGP/SurfaceMesh/SurfaceMesh.h>
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+/// Outcome of a `PointToPlaneICP::align()` call
+struct ICPResult {
+    Mat4x4 pose = Mat4x4::Identity(); ///< estimated camera_to_world pose of the source frame
+    int iterations = 0;               ///< Gauss-Newton steps taken over all pyramid levels
+    int correspondences = 0;          ///< inlier correspondences in the last step
+    Scalar rms_error = 0;             ///< point-to-plane rms residual in the last step
+    bool converged = false;           ///< whether the finest level converged before running out of iterations
+};
+
+/// @brief Rigid point-to-plane ICP registering depth frames against a previous frame or a mesh
+/// @note Projective association only works for depth frame targets, mesh targets always
+/// use the kd-tree
+class PointToPlaneICP {
+public:
+
+    enum class Association { Projective, KDTree };
+
+    /// Organized camera-space points and normals of one pyramid level
+    struct Level {
+        StreamIntrinsics intrinsics;
+        PointMap map;
+    };
+
+private:
+
+    struct KDTree;
+
+    /// Per-thread partial sums of the point-to-plane normal equations
+    struct NormalEquations;
+
+    std::vector<Level> target_levels;
+    Mat4x4 target_pose = Mat4x4::Identity();
+
+    /// World-space target points and normals for kd-tree association
+    std::shared_ptr<KDTree> kdtree;
+
+    bool target_is_frame = false;
+
+    HEADERONLY_INLINE void build_pyramid(const uint16_t *depth, const StreamIntrinsics &intrinsics, float depth_scale, std::vector<Level> &levels, bool keep_finest) const;
+
+    HEADERONLY_INLINE void build_kdtree(std::vector<Vec3> &&points, std::vector<Vec3> &&normals);
+
+public:
+
+    Association association = Association::Projective;
+
+    /// @brief Gauss-Newton iterations per pyramid level, finest level first (also sets the number of levels)
+    /// @note Frame targets are built for these, after changing the levels or enabling a level
+    /// call `set_target` again, `align` does not move the pose until then
+    std::vector<int> iterations = { 4, 5, 10 };
+
+    /// Reject correspondences further apart than this (world units)
+    Scalar max_distance = 0.1f;
+
+    /// Reject correspondences whose normals disagree more than this (cosine of the angle)
+    Scalar min_normal_dot = 0.8f;
+
+    /// A level stops early once the update is smaller than this
+    Scalar convergence_threshold = 1e-6f;
+
+    /// Ignore depth samples outside of [min_depth, max_depth]
+    Scalar min_depth = 0.1f;
+    Scalar max_depth = 4.0f;
+
+    /// Worker threads for the normal equation reduction (0 uses all hardware threads)
+    int n_threads = 0;
+
+    HEADERONLY_INLINE PointToPlaneICP();
+
+    /// Use a depth frame with pose `camera_to_world` as the registration target
+    HEADERONLY_INLINE void set_target(const uint16_t *depth, const StreamIntrinsics &intrinsics, float depth_scale, const Mat4x4 &camera_to_world);
+
+    void set_target(const Image<uint16_t> &depth, const StreamIntrinsics &intrinsics, float depth_scale, const Mat4x4 &camera_to_world) {
+        set_target(depth.data(), intrinsics, depth_scale, camera_to_world);
+    }
+
+    /// Use the vertices and vertex normals of `mesh` (transformed by `model`) as the registration target
+    HEADERONLY_INLINE void set_target(const SurfaceMesh &mesh, const Mat4x4 &model = Mat4x4::Identity());
+
+    /// @brief Estimate the pose of a depth frame
+    /// @param initial_pose starting guess for the camera_to_world pose (e.g. the previous frame's)
+    HEADERONLY_INLINE ICPResult align(const uint16_t *depth, const StreamIntrinsics &intrinsics, float depth_scale, const Mat4x4 &initial_pose) const;
+
+    ICPResult align(const Image<uint16_t> &depth, const StreamIntrinsics &intrinsics, float depth_scale, const Mat4x4 &initial_pose) const {
+        return align(depth.data(), intrinsics, depth_scale, initial_pose);
+    }
+
+    ICPResult align(const SensorStream &depth_stream, float depth_scale, const Mat4x4 &initial_pose) const {
+        return align((const uint16_t*)depth_stream.get_data(), depth_stream.get_intrinsics(), depth_scale, initial_pose);
+    }
+
+};
+
+//=============================================================================
+} // OpenGP::
+//=============================================================================
+
+#ifdef HEADERONLY
+    #include "ICP.cpp"
+#endif
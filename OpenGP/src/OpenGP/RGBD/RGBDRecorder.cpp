@@ -0,0 +1,198 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <cstring>
+
+#include "RGBDRecorder.h"
+
+#include <OpenGP/MLogger.h>
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+bool RGBDRecorder::open(const std::string &path, const SensorDevice &device) {
+
+    close();
+
+    header = recording::FileHeader();
+    header.depth_scale = device.get_depth_scale();
+    streams.clear();
+
+    for (const SensorStream &stream : device.get_streams()) {
+
+        if (stream.get_frame_size() == 0) {
+            mWarning() << "RGBDRecorder: skipping stream" << stream.get_name() << "with unknown format";
+            continue;
+        }
+
+        recording::StreamHeader stream_header;
+        stream_header.name = stream.get_name();
+        stream_header.format = stream.get_format();
+        stream_header.codec = recording::default_codec(stream.get_format());
+        stream_header.intrinsics = stream.get_intrinsics();
+        stream_header.extrinsics = stream.get_extrinsics();
+        stream_header.framerate = stream.get_framerate();
+
+        header.streams.push_back(stream_header);
+        streams.push_back(&stream);
+
+    }
+
+    if (streams.empty()) return false;
+
+    file = fopen(path.c_str(), "wb");
+    if (!file) return false;
+
+    // all frame memory is allocated up front
+    slots.resize(std::max(ring_capacity, 1));
+    for (Slot &slot : slots) {
+        slot.data.resize(streams.size());
+        for (size_t s = 0;s < streams.size();s++) slot.data[s].resize(header.streams[s].frame_size());
+    }
+
+    head = 0;
+    tail = 0;
+    stopping = false;
+    file_offset = 0;
+    index.clear();
+    n_offered = 0;
+    n_recorded = 0;
+    n_dropped = 0;
+    failed = false;
+    start_time = std::chrono::steady_clock::now();
+
+    std::vector<uint8_t> bytes;
+    recording::write_header(header, bytes);
+    if (!write(bytes)) {
+        fclose(file);
+        file = nullptr;
+        return false;
+    }
+
+    writer = std::thread(&RGBDRecorder::writer_loop, this);
+
+    return true;
+
+}
+
+void RGBDRecorder::close() {
+
+    if (!file) return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    writer.join();
+
+    std::vector<uint8_t> bytes;
+    recording::write_index(index, file_offset, bytes);
+    write(bytes);
+
+    fclose(file);
+    file = nullptr;
+
+}
+
+bool RGBDRecorder::record() {
+    auto elapsed = std::chrono::steady_clock::now() - start_time;
+    return record(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+}
+
+bool RGBDRecorder::record(int64_t timestamp) {
+
+    if (!file) return false;
+
+    uint32_t frame = n_offered++;
+
+    size_t h = head.load(std::memory_order_relaxed);
+    if (failed || h - tail.load(std::memory_order_acquire) >= slots.size()) {
+        n_dropped++;
+        return false;
+    }
+
+    Slot &slot = slots[h % slots.size()];
+    slot.frame = frame;
+    slot.timestamp = timestamp;
+    for (size_t s = 0;s < streams.size();s++) {
+        std::memcpy(slot.data[s].data(), streams[s]->get_data(), slot.data[s].size());
+    }
+
+    head.store(h + 1, std::memory_order_release);
+
+    // the writer only holds the lock while it is idle, so this never waits on disk IO
+    { std::lock_guard<std::mutex> lock(mutex); }
+    wake.notify_one();
+
+    return true;
+
+}
+
+bool RGBDRecorder::write(const std::vector<uint8_t> &bytes) {
+    if (fwrite(bytes.data(), 1, bytes.size(), file) != bytes.size()) return false;
+    file_offset += bytes.size();
+    return true;
+}
+
+void RGBDRecorder::writer_loop() {
+
+    std::vector<uint8_t> chunk;
+
+    while (true) {
+
+        size_t t = tail.load(std::memory_order_relaxed);
+
+        if (t == head.load(std::memory_order_acquire)) {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&]() { return stopping || t != head.load(std::memory_order_acquire); });
+            if (t == head.load(std::memory_order_acquire)) break; // stopping, and all frames written
+            continue;
+        }
+
+        const Slot &slot = slots[t % slots.size()];
+
+        if (!failed) {
+
+            chunk.clear();
+            recording::append(chunk, recording::frame_tag);
+            recording::append(chunk, slot.frame);
+            recording::append(chunk, slot.timestamp);
+
+            for (size_t s = 0;s < streams.size();s++) {
+                size_t size_position = chunk.size();
+                recording::append(chunk, (uint64_t)0);
+                recording::encode(header.streams[s], slot.data[s].data(), chunk);
+                uint64_t size = chunk.size() - size_position - sizeof(uint64_t);
+                std::memcpy(chunk.data() + size_position, &size, sizeof(size));
+            }
+
+            recording::IndexEntry entry;
+            entry.offset = file_offset;
+            entry.timestamp = slot.timestamp;
+
+            if (write(chunk)) {
+                index.push_back(entry);
+                n_recorded++;
+            } else {
+                mWarning() << "RGBDRecorder: write failed, dropping further frames";
+                failed = true;
+                n_dropped++;
+            }
+
+        } else {
+            n_dropped++;
+        }
+
+        tail.store(t + 1, std::memory_order_release);
+
+    }
+
+}
+
+//=============================================================================
+} // OpenGP::
+//=============================================================================
@@ -0,0 +1,125 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <condition_variable>
+
+#include <OpenGP/headeronly.h>
+#include <OpenGP/RGBD/Stream.h>
+#include <OpenGP/RGBD/RecordingFormat.h>
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+/// @brief Records the streams of a `SensorDevice` to disk without stalling the frame loop
+/// @note `record()` only copies the current stream data into a preallocated ring buffer;
+/// compression (RVL for depth, QOI for color) and file IO happen on a writer thread. If the
+/// writer falls behind and the ring buffer is full, the frame is dropped instead of waiting.
+/// The device must outlive the recording. See `recording::` for the file layout.
+///
+/// Usage:
+///
+///     RGBDRecorder recorder;
+///     recorder.open("capture.rgbd", device);
+///     while (...) {
+///         device.advance_frame();
+///         if (!recorder.record()) { /* frame dropped */ }
+///     }
+///     recorder.close();
+///
+class RGBDRecorder {
+private:
+
+    struct Slot {
+        uint32_t frame;
+        int64_t timestamp;
+        std::vector<std::vector<uint8_t>> data; ///< one buffer per stream
+    };
+
+    recording::FileHeader header;
+    std::vector<const SensorStream*> streams;
+
+    std::vector<Slot> slots;
+
+    /// Slots [tail, head) are waiting for the writer, both only ever increase
+    std::atomic<size_t> head{0};
+    std::atomic<size_t> tail{0};
+
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    FILE *file = nullptr;
+    uint64_t file_offset = 0;
+    std::vector<recording::IndexEntry> index;
+
+    std::chrono::steady_clock::time_point start_time;
+    uint32_t n_offered = 0;
+
+    std::atomic<size_t> n_recorded{0};
+    std::atomic<size_t> n_dropped{0};
+    std::atomic<bool> failed{false};
+
+    HEADERONLY_INLINE void writer_loop();
+    HEADERONLY_INLINE bool write(const std::vector<uint8_t> &bytes);
+
+public:
+
+    /// Frames that can wait for the writer before new ones are dropped (applied by `open()`)
+    int ring_capacity = 8;
+
+    RGBDRecorder() {}
+    RGBDRecorder(const RGBDRecorder&) = delete;
+    RGBDRecorder &operator=(const RGBDRecorder&) = delete;
+
+    ~RGBDRecorder() { close(); }
+
+    /// @brief Start recording the streams of `device` into a new file
+    /// @return false if the file could not be created or no stream has a known format
+    HEADERONLY_INLINE bool open(const std::string &path, const SensorDevice &device);
+
+    /// Finish writing the queued frames, write the index and close the file
+    HEADERONLY_INLINE void close();
+
+    bool is_open() const { return file != nullptr; }
+
+    /// @brief Queue the device's current frame, timestamped with the time of the call
+    /// @return false if the frame was dropped (ring buffer full, write error or not open)
+    HEADERONLY_INLINE bool record();
+
+    /// Queue the device's current frame with a timestamp in microseconds
+    HEADERONLY_INLINE bool record(int64_t timestamp);
+
+    /// Frames written to disk so far
+    size_t get_frames_recorded() const { return n_recorded; }
+
+    /// Frames offered to `record()` that were not queued
+    size_t get_frames_dropped() const { return n_dropped; }
+
+    /// Frames waiting for the writer thread
+    size_t get_frames_pending() const { return head - tail; }
+
+    /// Whether writing to the file failed (later frames are dropped)
+    bool has_error() const { return failed; }
+
+};
+
+//=============================================================================
+} // OpenGP::
+//=============================================================================
+
+#ifdef HEADERONLY
+    #include "RGBDRecorder.cpp"
+#endif
@@ -0,0 +1,199 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <algorithm>
+
+#include "RecordingFormat.h"
+
+#include <OpenGP/RGBD/codecs.h>
+
+
+//=============================================================================
+namespace OpenGP {
+namespace recording {
+//=============================================================================
+
+Codec default_codec(StreamFormat format) {
+    switch (format) {
+    case StreamFormat::Z16: return Codec::RVL;
+    case StreamFormat::RGB8:
+    case StreamFormat::RGBA8: return Codec::QOI;
+    default: return Codec::Raw;
+    }
+}
+
+void encode(const StreamHeader &stream, const void *data, std::vector<uint8_t> &out) {
+
+    size_t n_pixels = (size_t)stream.intrinsics.width * stream.intrinsics.height;
+
+    switch (stream.codec) {
+    case Codec::RVL:
+        rvl_compress((const uint16_t*)data, n_pixels, out);
+        break;
+    case Codec::QOI:
+        qoi_compress((const uint8_t*)data, n_pixels, bytes_per_pixel(stream.format), out);
+        break;
+    default:
+        out.insert(out.end(), (const uint8_t*)data, (const uint8_t*)data + stream.frame_size());
+        break;
+    }
+
+}
+
+bool decode(const StreamHeader &stream, const uint8_t *encoded, size_t size, void *data) {
+
+    size_t n_pixels = (size_t)stream.intrinsics.width * stream.intrinsics.height;
+
+    switch (stream.codec) {
+    case Codec::RVL:
+        return rvl_decompress(encoded, size, (uint16_t*)data, n_pixels);
+    case Codec::QOI:
+        return qoi_decompress(encoded, size, (uint8_t*)data, n_pixels, bytes_per_pixel(stream.format));
+    case Codec::Raw:
+        if (size != stream.frame_size()) return false;
+        std::memcpy(data, encoded, size);
+        return true;
+    default:
+        return false;
+    }
+
+}
+
+void write_header(const FileHeader &header, std::vector<uint8_t> &out) {
+
+    out.insert(out.end(), magic, magic + sizeof(magic));
+    append(out, version);
+    append(out, header.depth_scale);
+    append(out, (uint32_t)header.streams.size());
+
+    for (const StreamHeader &stream : header.streams) {
+        append(out, (uint32_t)stream.name.size());
+        out.insert(out.end(), stream.name.begin(), stream.name.end());
+        append(out, (uint32_t)stream.format);
+        append(out, (uint32_t)stream.codec);
+        append(out, (int32_t)stream.intrinsics.width);
+        append(out, (int32_t)stream.intrinsics.height);
+        append(out, stream.intrinsics.pixel_center);
+        append(out, stream.intrinsics.focal_length);
+        append(out, stream.extrinsics.translation);
+        append(out, stream.extrinsics.rotation);
+        append(out, stream.framerate);
+    }
+
+}
+
+size_t read_header(const uint8_t *data, size_t size, FileHeader &header) {
+
+    const uint8_t *begin = data, *end = data + size;
+
+    char file_magic[8];
+    uint32_t file_version, n_streams;
+    if (!extract(data, end, file_magic) || std::memcmp(file_magic, magic, sizeof(magic)) != 0) return 0;
+    if (!extract(data, end, file_version) || file_version != version) return 0;
+    if (!extract(data, end, header.depth_scale) || !extract(data, end, n_streams)) return 0;
+
+    header.streams.clear();
+    for (uint32_t s = 0;s < n_streams;s++) {
+
+        StreamHeader stream;
+        uint32_t name_length, format, codec;
+        int32_t width, height;
+
+        if (!extract(data, end, name_length) || (size_t)(end - data) < name_length) return 0;
+        stream.name.assign((const char*)data, name_length);
+        data += name_length;
+
+        bool ok = extract(data, end, format) && extract(data, end, codec) &&
+                  extract(data, end, width) && extract(data, end, height) &&
+                  extract(data, end, stream.intrinsics.pixel_center) &&
+                  extract(data, end, stream.intrinsics.focal_length) &&
+                  extract(data, end, stream.extrinsics.translation) &&
+                  extract(data, end, stream.extrinsics.rotation) &&
+                  extract(data, end, stream.framerate);
+        if (!ok || width < 0 || height < 0) return 0;
+
+        stream.format = (StreamFormat)format;
+        stream.codec = (Codec)codec;
+        stream.intrinsics.width = width;
+        stream.intrinsics.height = height;
+        header.streams.push_back(stream);
+
+    }
+
+    return data - begin;
+
+}
+
+void write_index(const std::vector<IndexEntry> &index, uint64_t index_offset, std::vector<uint8_t> &out) {
+
+    append(out, index_tag);
+    append(out, (uint64_t)index.size());
+    for (const IndexEntry &entry : index) {
+        append(out, entry.offset);
+        append(out, entry.timestamp);
+    }
+
+    append(out, index_offset);
+    out.insert(out.end(), magic, magic + sizeof(magic));
+
+}
+
+bool read_index(const uint8_t *data, size_t size, size_t header_size, const FileHeader &header, std::vector<IndexEntry> &index) {
+
+    const uint8_t *end = data + size;
+    index.clear();
+
+    // index written on close
+    const size_t trailer_size = sizeof(uint64_t) + sizeof(magic);
+    if (size >= header_size + trailer_size && std::memcmp(end - sizeof(magic), magic, sizeof(magic)) == 0) {
+
+        const uint8_t *trailer = end - trailer_size;
+        uint64_t index_offset, n_frames;
+        uint32_t tag;
+        extract(trailer, end, index_offset);
+
+        const uint8_t *ptr = data + std::min<uint64_t>(index_offset, size);
+        if (extract(ptr, end, tag) && tag == index_tag && extract(ptr, end, n_frames) &&
+            (uint64_t)(end - ptr) / sizeof(IndexEntry) >= n_frames) {
+            index.resize(n_frames);
+            for (IndexEntry &entry : index) {
+                extract(ptr, end, entry.offset);
+                extract(ptr, end, entry.timestamp);
+            }
+            return true;
+        }
+
+    }
+
+    // unfinished recording: walk the complete frame chunks
+    const uint8_t *ptr = data + header_size;
+    while (ptr < end) {
+
+        IndexEntry entry;
+        entry.offset = ptr - data;
+
+        uint32_t tag, frame;
+        if (!extract(ptr, end, tag) || tag != frame_tag) break;
+        if (!extract(ptr, end, frame) || !extract(ptr, end, entry.timestamp)) break;
+
+        bool complete = true;
+        for (size_t s = 0;s < header.streams.size() && complete;s++) {
+            uint64_t chunk_size;
+            complete = extract(ptr, end, chunk_size) && (uint64_t)(end - ptr) >= chunk_size;
+            if (complete) ptr += chunk_size;
+        }
+        if (!complete) break;
+
+        index.push_back(entry);
+
+    }
+
+    return !index.empty();
+
+}
+
+//=============================================================================
+} // recording::
+} // OpenGP::
+//=============================================================================
@@ -0,0 +1,113 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+
+#include <OpenGP/headeronly.h>
+#include <OpenGP/RGBD/Stream.h>
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+/// @brief Layout of the RGBD recording files written by `RGBDRecorder`
+/// @note All values are little-endian.
+///
+///     file header   magic "OGPRGBD\0", uint32 version, float depth_scale, uint32 n_streams,
+///                   n_streams x stream header
+///     stream header uint32 name length, name, uint32 format, uint32 codec, int32 width, height,
+///                   float cx, cy, fx, fy, float translation[3], rotation[9] (column-major),
+///                   float framerate
+///     frame chunk   uint32 tag "FRAM", uint32 frame number, int64 timestamp (us),
+///                   n_streams x (uint64 size, encoded data)
+///     index chunk   uint32 tag "INDX", uint64 n_frames, n_frames x (uint64 offset, int64 timestamp)
+///     trailer       uint64 offset of the index chunk, magic "OGPRGBD\0"
+///
+/// Frame numbers count every frame offered to the recorder, so dropped frames show up as gaps.
+/// A file without trailer (e.g. after a crash) can still be read by walking the frame chunks.
+namespace recording {
+
+const char magic[8] = { 'O', 'G', 'P', 'R', 'G', 'B', 'D', '\0' };
+const uint32_t version = 1;
+const uint32_t frame_tag = 0x4d415246; // "FRAM"
+const uint32_t index_tag = 0x58444e49; // "INDX"
+
+/// Compression of one stream's frames
+enum class Codec : uint32_t {
+    Raw = 0,
+    RVL = 1, ///< `rvl_compress()`, for Z16
+    QOI = 2, ///< `qoi_compress()`, for RGB8 and RGBA8
+};
+
+struct StreamHeader {
+    std::string name;
+    StreamFormat format = StreamFormat::Unknown;
+    Codec codec = Codec::Raw;
+    StreamIntrinsics intrinsics;
+    StreamExtrinsics extrinsics;
+    float framerate = 0;
+
+    size_t frame_size() const { return (size_t)intrinsics.width * intrinsics.height * bytes_per_pixel(format); }
+};
+
+struct FileHeader {
+    float depth_scale = 1;
+    std::vector<StreamHeader> streams;
+};
+
+struct IndexEntry {
+    uint64_t offset;
+    int64_t timestamp;
+};
+
+/// Codec used for a stream format when recording
+HEADERONLY_INLINE Codec default_codec(StreamFormat format);
+
+/// Encode one frame of a stream, appending to `out`
+HEADERONLY_INLINE void encode(const StreamHeader &stream, const void *data, std::vector<uint8_t> &out);
+
+/// Decode one frame of a stream into `data` (`stream.frame_size()` bytes), returns false on corrupt data
+HEADERONLY_INLINE bool decode(const StreamHeader &stream, const uint8_t *encoded, size_t size, void *data);
+
+HEADERONLY_INLINE void write_header(const FileHeader &header, std::vector<uint8_t> &out);
+
+/// Parse the file header, returns its size in bytes (0 if the data is not a valid recording)
+HEADERONLY_INLINE size_t read_header(const uint8_t *data, size_t size, FileHeader &header);
+
+HEADERONLY_INLINE void write_index(const std::vector<IndexEntry> &index, uint64_t index_offset, std::vector<uint8_t> &out);
+
+/// Read the index from the file trailer, or rebuild it from the frame chunks if there is none
+HEADERONLY_INLINE bool read_index(const uint8_t *data, size_t size, size_t header_size, const FileHeader &header, std::vector<IndexEntry> &index);
+
+/// Append a plain value to a byte buffer
+template <typename T>
+void append(std::vector<uint8_t> &out, const T &value) {
+    const uint8_t *bytes = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+/// Read a plain value from `data`, returns false if fewer than sizeof(T) bytes remain
+template <typename T>
+bool extract(const uint8_t *&data, const uint8_t *end, T &value) {
+    if ((size_t)(end - data) < sizeof(T)) return false;
+    std::memcpy((void*)&value, data, sizeof(T));
+    data += sizeof(T);
+    return true;
+}
+
+} // recording::
+
+//=============================================================================
+} // OpenGP::
+//=============================================================================
+
+#ifdef HEADERONLY
+    #include "RecordingFormat.cpp"
+#endif
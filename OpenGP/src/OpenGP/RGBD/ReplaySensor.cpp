@@ -0,0 +1,179 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <unordered_map>
+
+#include "ReplaySensor.h"
+
+#include <OpenGP/MLogger.h>
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+bool ReplaySensor::open(const std::string &path) {
+
+    close();
+
+    if (!file.open(path)) return false;
+
+    size_t header_size = recording::read_header(file.data(), file.size(), header);
+    // a recording without frames is rejected, there would be nothing to replay (or loop over)
+    if (header_size == 0 || !recording::read_index(file.data(), file.size(), header_size, header, index) || index.empty()) {
+        close();
+        return false;
+    }
+
+    // one slot more than the prefetch depth, for the frame being presented
+    slots.resize(std::max(prefetch_frames, 1) + 1);
+    for (Slot &slot : slots) {
+        slot.data.resize(header.streams.size());
+        for (size_t s = 0;s < header.streams.size();s++) slot.data[s].assign(header.streams[s].frame_size(), 0);
+    }
+
+    // until the first advance, the streams show the (blank) slot preceding frame 0
+    current_data.resize(header.streams.size());
+    for (size_t s = 0;s < header.streams.size();s++) current_data[s] = slots.back().data[s].data();
+
+    decoded = 0;
+    consumed = 0;
+    finished = false;
+    stopping = false;
+    anchored = false;
+    current_frame = 0;
+
+    prefetcher = std::thread(&ReplaySensor::prefetch_loop, this);
+
+    return true;
+
+}
+
+void ReplaySensor::close() {
+
+    if (prefetcher.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        frame_consumed.notify_all();
+        frame_decoded.notify_all();
+        prefetcher.join();
+    }
+
+    file.close();
+    index.clear();
+    header = recording::FileHeader();
+
+}
+
+SensorDevice ReplaySensor::get_device() {
+
+    std::unordered_map<std::string, SensorStream> streams;
+
+    for (size_t s = 0;s < header.streams.size();s++) {
+        const recording::StreamHeader &stream = header.streams[s];
+        streams.emplace(
+            std::piecewise_construct,
+            std::forward_as_tuple(stream.name),
+            std::forward_as_tuple(stream.name.c_str(), &current_data[s], stream.intrinsics, stream.extrinsics, stream.framerate, stream.format)
+        );
+    }
+
+    return SensorDevice(header.depth_scale, streams, [this](bool block) {
+        return advance(block);
+    });
+
+}
+
+void ReplaySensor::prefetch_loop() {
+
+    const uint8_t *end = file.data() + file.size();
+    size_t n_frames = index.size();
+
+    for (size_t k = 0;;k++) {
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            frame_consumed.wait(lock, [&]() { return stopping || decoded - consumed + 1 < slots.size(); });
+            if (stopping) return;
+            if (!loop && k >= n_frames) {
+                finished = true;
+                break;
+            }
+        }
+
+        // the slot is neither ready nor presented, so it can be filled without the lock
+        Slot &slot = slots[k % slots.size()];
+        slot.frame = k % n_frames;
+        slot.timestamp = index[slot.frame].timestamp;
+        slot.restart = (k > 0 && slot.frame == 0);
+
+        // skip tag, frame number and timestamp
+        const uint8_t *ptr = file.data() + index[slot.frame].offset + 2 * sizeof(uint32_t) + sizeof(int64_t);
+        for (size_t s = 0;s < header.streams.size();s++) {
+            uint64_t size;
+            if (!recording::extract(ptr, end, size) || (uint64_t)(end - ptr) < size ||
+                !recording::decode(header.streams[s], ptr, (size_t)size, slot.data[s].data())) {
+                mWarning() << "ReplaySensor: corrupt frame" << slot.frame;
+                break;
+            }
+            ptr += size;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            decoded = k + 1;
+        }
+        frame_decoded.notify_all();
+
+    }
+
+    frame_decoded.notify_all();
+
+}
+
+bool ReplaySensor::advance(bool block) {
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    if (block) frame_decoded.wait(lock, [&]() { return stopping || finished || decoded > consumed; });
+    if (decoded <= consumed) return false; // not decoded yet, or end of the recording
+
+    Slot &slot = slots[consumed % slots.size()];
+
+    if (pacing == Pacing::RealTime) {
+
+        auto now = std::chrono::steady_clock::now();
+        if (!anchored || slot.restart) {
+            anchor_time = now;
+            anchor_timestamp = slot.timestamp;
+            anchored = true;
+        }
+
+        // late frames are presented right away rather than skipped
+        auto due = anchor_time + std::chrono::microseconds(slot.timestamp - anchor_timestamp);
+        if (now < due) {
+            if (!block) return false;
+            lock.unlock();
+            std::this_thread::sleep_until(due);
+            lock.lock();
+        }
+
+    }
+
+    for (size_t s = 0;s < current_data.size();s++) current_data[s] = slot.data[s].data();
+    current_frame = slot.frame;
+    consumed++;
+
+    lock.unlock();
+    frame_consumed.notify_one();
+
+    return true;
+
+}
+
+//=============================================================================
+} // OpenGP::
+//=============================================================================
@@ -0,0 +1,124 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+
+#include <OpenGP/headeronly.h>
+#include <OpenGP/RGBD/Stream.h>
+#include <OpenGP/RGBD/RecordingFormat.h>
+#include <OpenGP/util/MappedFile.h>
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+/// @brief Plays back a file written by `RGBDRecorder` as a `SensorDevice`
+/// @note The file is memory mapped and a prefetch thread decodes frames ahead of the
+/// consumer. `SensorDevice::advance_frame()` waits for the next frame, while
+/// `try_advance_frame()` returns false if it is not decoded yet or, with real-time
+/// pacing, not due yet. Both return false once the recording has ended (unless looping).
+///
+/// The devices returned by `get_device()` refer to this object and must not outlive it.
+class ReplaySensor {
+public:
+
+    enum class Pacing {
+        RealTime,       ///< present frames at the rate they were recorded
+        AsFastAsPossible,
+    };
+
+private:
+
+    struct Slot {
+        size_t frame;  ///< position in the recording
+        int64_t timestamp;
+        bool restart;  ///< first frame after looping around
+        std::vector<std::vector<uint8_t>> data;
+    };
+
+    MappedFile file;
+    recording::FileHeader header;
+    std::vector<recording::IndexEntry> index;
+
+    /// Current frame of every stream, pointed to by the `SensorStream`s
+    std::vector<const void*> current_data;
+
+    std::vector<Slot> slots;
+
+    /// Frames [consumed, decoded) are ready in the ring, the slot before `consumed` is being presented
+    size_t decoded = 0;
+    size_t consumed = 0;
+    bool finished = false;
+    bool stopping = false;
+
+    std::thread prefetcher;
+    std::mutex mutex;
+    std::condition_variable frame_decoded;
+    std::condition_variable frame_consumed;
+
+    /// Wall clock time at which the recording timestamp `anchor_timestamp` is presented
+    std::chrono::steady_clock::time_point anchor_time;
+    int64_t anchor_timestamp = 0;
+    bool anchored = false;
+
+    size_t current_frame = 0;
+
+    HEADERONLY_INLINE void prefetch_loop();
+    HEADERONLY_INLINE bool advance(bool block);
+
+public:
+
+    Pacing pacing = Pacing::RealTime;
+
+    /// Start over at the first frame after the last one
+    bool loop = false;
+
+    /// Frames decoded ahead of the consumer (applied by `open()`)
+    int prefetch_frames = 4;
+
+    ReplaySensor() {}
+    explicit ReplaySensor(const std::string &path) { open(path); }
+
+    ReplaySensor(const ReplaySensor&) = delete;
+    ReplaySensor &operator=(const ReplaySensor&) = delete;
+
+    ~ReplaySensor() { close(); }
+
+    /// Map a recording and start prefetching, returns false if it is not a valid recording
+    /// or has no frames
+    HEADERONLY_INLINE bool open(const std::string &path);
+    HEADERONLY_INLINE void close();
+
+    bool is_open() const { return file.is_open(); }
+
+    /// A device presenting the recorded streams, with the recorded depth scale
+    HEADERONLY_INLINE SensorDevice get_device();
+
+    size_t get_n_frames() const { return index.size(); }
+
+    /// Position of the presented frame in the recording
+    size_t get_current_frame() const { return current_frame; }
+
+    /// Recording timestamp of the presented frame in microseconds
+    int64_t get_current_timestamp() const { return index.empty() ? 0 : index[current_frame].timestamp; }
+
+    const recording::FileHeader &get_header() const { return header; }
+
+};
+
+//=============================================================================
+} // OpenGP::
+//=============================================================================
+
+#ifdef HEADERONLY
+    #include "ReplaySensor.cpp"
+#endif
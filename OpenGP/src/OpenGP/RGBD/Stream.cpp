@@ -9,12 +9,13 @@
 namespace OpenGP {
 //=============================================================================
 
-SensorStream::SensorStream(const char *name, const void *const *data_ptr, const StreamIntrinsics &intrinsics, const StreamExtrinsics &extrinsics, float framerate) :
+SensorStream::SensorStream(const char *name, const void *const *data_ptr, const StreamIntrinsics &intrinsics, const StreamExtrinsics &extrinsics, float framerate, StreamFormat format) :
     data_ptr(data_ptr),
     intrinsics(intrinsics),
     extrinsics(extrinsics),
+    framerate(framerate),
     name(name),
-    framerate(framerate) {}
+    format(format) {}
 
 const void *SensorStream::get_data() const {
     return *data_ptr;
@@ -33,15 +34,8 @@ const SensorStream &SensorDevice::get_stream(const char *name) const {
     return streams.at(name);
 }
 
-GenericIterable<const SensorStream> SensorDevice::get_streams() const {
-
-    using ptype = typename decltype(streams)::value_type;
-
-    auto pred = [](const ptype &pair) -> const SensorStream* {
-        return &(pair.second);
-    };
-
-    return GenericIterable<const ptype>::adaptor(streams).map(pred);
+SensorDevice::StreamRange SensorDevice::get_streams() const {
+    return make_range(streams).map(PairSecond());
 }
 
 size_t SensorDevice::get_streams_size() const {
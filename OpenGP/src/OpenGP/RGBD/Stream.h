@@ -9,7 +9,7 @@
 
 #include <OpenGP/headeronly.h>
 #include <OpenGP/types.h>
-#include <OpenGP/util/GenericIterable.h>
+#include <OpenGP/util/Range.h>
 #include <OpenGP/util/cuda_support.h>
 
 
@@ -43,6 +43,26 @@ struct StreamExtrinsics {
     Mat3x3 rotation;
 };
 
+/// Pixel layout of the data behind a `SensorStream`
+enum class StreamFormat {
+    Unknown,
+    Z16,   ///< 16-bit depth, scaled by `SensorDevice::get_depth_scale()`
+    Y8,    ///< 8-bit grayscale (e.g. infrared)
+    RGB8,
+    RGBA8,
+};
+
+/// Size of one pixel in bytes (0 for unknown formats)
+inline int bytes_per_pixel(StreamFormat format) {
+    switch (format) {
+    case StreamFormat::Z16: return 2;
+    case StreamFormat::Y8: return 1;
+    case StreamFormat::RGB8: return 3;
+    case StreamFormat::RGBA8: return 4;
+    default: return 0;
+    }
+}
+
 class SensorStream {
 private:
 
@@ -54,9 +74,11 @@ private:
 
     std::string name;
 
+    StreamFormat format;
+
 public:
 
-    HEADERONLY_INLINE SensorStream(const char *name, const void *const *data_ptr, const StreamIntrinsics &intrinsics, const StreamExtrinsics &extrinsics, float framerate);
+    HEADERONLY_INLINE SensorStream(const char *name, const void *const *data_ptr, const StreamIntrinsics &intrinsics, const StreamExtrinsics &extrinsics, float framerate, StreamFormat format = StreamFormat::Unknown);
 
     HEADERONLY_INLINE const void *get_data() const;
 
@@ -66,6 +88,11 @@ public:
 
     const char *get_name() const { return name.c_str(); }
 
+    StreamFormat get_format() const { return format; }
+
+    /// Size of one frame in bytes (0 for unknown formats)
+    size_t get_frame_size() const { return (size_t)intrinsics.width * intrinsics.height * bytes_per_pixel(format); }
+
 };
 
 class SensorDevice {
@@ -88,11 +115,13 @@ public:
     HEADERONLY_INLINE void advance_frame();
     HEADERONLY_INLINE bool try_advance_frame();
 
-    HEADERONLY_INLINE float get_depth_scale() { return depth_scale; }
+    float get_depth_scale() const { return depth_scale; }
 
     HEADERONLY_INLINE const SensorStream &get_stream(const char *name) const;
 
-    HEADERONLY_INLINE GenericIterable<const SensorStream> get_streams() const;
+    using StreamRange = Range<MapIterator<std::unordered_map<std::string, SensorStream>::const_iterator, PairSecond>>;
+
+    HEADERONLY_INLINE StreamRange get_streams() const;
     HEADERONLY_INLINE size_t get_streams_size() const;
 
 };
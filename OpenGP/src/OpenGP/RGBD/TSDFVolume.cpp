@@ -0,0 +1,327 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <unordered_set>
+
+#include "TSDFVolume.h"
+
+#include <OpenGP/util/parallel_for.h>
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+namespace {
+
+inline int floor_div(int a, int b) {
+    return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
+
+inline int voxel_offset(int x, int y, int z) {
+    return x + TSDFVolume::block_size * (y + TSDFVolume::block_size * z);
+}
+
+}
+
+#ifndef HEADERONLY
+// out of line definitions for uses by reference (header only builds would have one per unit,
+// the products with Eigen vectors below take a copy instead)
+constexpr int TSDFVolume::block_size;
+constexpr int TSDFVolume::block_voxels;
+#endif
+
+TSDFVolume::TSDFVolume(Scalar voxel_size, Scalar truncation) :
+    voxel_size(voxel_size),
+    truncation(truncation > 0 ? truncation : 4 * voxel_size) {}
+
+void TSDFVolume::clear() {
+    block_index.clear();
+    blocks.clear();
+    block_coords.clear();
+}
+
+const TSDFVolume::Voxel *TSDFVolume::find_voxel(const Eigen::Vector3i &g) const {
+
+    Eigen::Vector3i b(floor_div(g.x(), block_size), floor_div(g.y(), block_size), floor_div(g.z(), block_size));
+
+    auto it = block_index.find(block_key(b));
+    if (it == block_index.end()) return nullptr;
+
+    Eigen::Vector3i l = g - b * int(block_size);
+    return &blocks[it->second][voxel_offset(l.x(), l.y(), l.z())];
+
+}
+
+void TSDFVolume::allocate_blocks(const uint16_t *depth, const StreamIntrinsics &intrinsics, float depth_scale, const Mat4x4 &camera_to_world, std::vector<int> &visible) {
+
+    int width = intrinsics.width, height = intrinsics.height;
+
+    Mat3x3 R = camera_to_world.block<3, 3>(0, 0);
+    Vec3 t = camera_to_world.block<3, 1>(0, 3);
+
+    Scalar block_extent = block_size * voxel_size;
+    Scalar step = block_extent / 2;
+
+    // each thread collects the blocks touched by its rows, duplicates are mostly
+    // caught by the per-thread set so the serial merge below stays small
+    int n = std::min(n_threads > 0 ? n_threads : hardware_threads(), height);
+    std::vector<std::unordered_set<uint64_t>> touched(std::max(n, 1));
+    std::vector<std::vector<Eigen::Vector3i>> touched_coords(std::max(n, 1));
+
+    parallel_ranges(0, height, [&](int thread, int row_begin, int row_end) {
+
+        auto &keys = touched[thread];
+        auto &coords = touched_coords[thread];
+
+        for (int j = row_begin;j < row_end;j++) {
+            for (int i = 0;i < width;i++) {
+
+                Scalar d = depth[j * width + i] * depth_scale;
+                if (d < min_depth || d > max_depth) continue;
+
+                Vec3 ray = R * intrinsics.unproject(i, j, Scalar(1));
+                Vec3 p0 = t + (d - truncation) * ray;
+                Vec3 p1 = t + (d + truncation) * ray;
+
+                int n_steps = (int)std::ceil((p1 - p0).norm() / step);
+                for (int s = 0;s <= n_steps;s++) {
+                    Vec3 p = p0 + (p1 - p0) * (Scalar(s) / std::max(n_steps, 1));
+                    Eigen::Vector3i b = (p / block_extent).array().floor().cast<int>();
+                    if (keys.insert(block_key(b)).second) coords.push_back(b);
+                }
+
+            }
+        }
+
+    }, n);
+
+    visible.clear();
+
+    for (size_t k = 0;k < touched.size();k++) {
+        for (auto &b : touched_coords[k]) {
+            auto result = block_index.emplace(block_key(b), (int)blocks.size());
+            if (result.second) {
+                blocks.emplace_back();
+                block_coords.push_back(b);
+            }
+            visible.push_back(result.first->second);
+        }
+    }
+
+    // blocks touched by several threads appear more than once
+    std::sort(visible.begin(), visible.end());
+    visible.erase(std::unique(visible.begin(), visible.end()), visible.end());
+
+}
+
+void TSDFVolume::integrate_block(int index, const uint16_t *depth, const StreamIntrinsics &intrinsics, float depth_scale, const Mat4x4 &world_to_camera) {
+
+    using Lane = Eigen::Array<float, block_size, 1>;
+
+    const Lane lanes = Lane::LinSpaced(block_size, 0, block_size - 1);
+
+    int width = intrinsics.width, height = intrinsics.height;
+    float fx = intrinsics.focal_length(0), fy = intrinsics.focal_length(1);
+    float cx = intrinsics.pixel_center(0), cy = intrinsics.pixel_center(1);
+
+    Mat3x3 R = world_to_camera.block<3, 3>(0, 0);
+    Vec3 t = world_to_camera.block<3, 1>(0, 3);
+
+    Block &block = blocks[index];
+    Vec3 origin = block_coords[index].cast<Scalar>() * (block_size * voxel_size);
+
+    // camera-space offset between consecutive voxels along x
+    Vec3 step = R.col(0) * voxel_size;
+
+    float inv_truncation = 1.0f / truncation;
+
+    for (int z = 0;z < block_size;z++) {
+        for (int y = 0;y < block_size;y++) {
+
+            // project a whole row of voxels at once
+            Vec3 row = R * (origin + Vec3(0, y, z) * voxel_size) + t;
+            Lane X = row.x() + lanes * step.x();
+            Lane Y = row.y() + lanes * step.y();
+            Lane Z = row.z() + lanes * step.z();
+            Lane inv_z = Z.inverse();
+            Eigen::Array<int, block_size, 1> u = (X * inv_z * fx + cx + 0.5f).floor().cast<int>();
+            Eigen::Array<int, block_size, 1> v = (Y * inv_z * fy + cy + 0.5f).floor().cast<int>();
+
+            Voxel *voxels = &block[voxel_offset(0, y, z)];
+
+            for (int x = 0;x < block_size;x++) {
+
+                if (Z(x) <= 0 || u(x) < 0 || v(x) < 0 || u(x) >= width || v(x) >= height) continue;
+
+                float d = depth[v(x) * width + u(x)] * depth_scale;
+                if (d < min_depth || d > max_depth) continue;
+
+                float sdf = d - Z(x);
+                if (sdf < -truncation) continue;
+
+                float tsdf = std::min(1.0f, sdf * inv_truncation);
+
+                Voxel &voxel = voxels[x];
+                voxel.sdf = (voxel.sdf * voxel.weight + tsdf) / (voxel.weight + 1);
+                voxel.weight = std::min(voxel.weight + 1, (float)max_weight);
+
+            }
+
+        }
+    }
+
+}
+
+void TSDFVolume::integrate(const uint16_t *depth, const StreamIntrinsics &intrinsics, float depth_scale, const Mat4x4 &camera_to_world) {
+
+    std::vector<int> visible;
+    allocate_blocks(depth, intrinsics, depth_scale, camera_to_world, visible);
+
+    Mat4x4 world_to_camera = Mat4x4::Identity();
+    world_to_camera.block<3, 3>(0, 0) = camera_to_world.block<3, 3>(0, 0).transpose();
+    world_to_camera.block<3, 1>(0, 3) = -world_to_camera.block<3, 3>(0, 0) * camera_to_world.block<3, 1>(0, 3);
+
+    parallel_for(0, (int)visible.size(), [&](int k) {
+        integrate_block(visible[k], depth, intrinsics, depth_scale, world_to_camera);
+    }, 4, n_threads);
+
+}
+
+void TSDFVolume::extract_mesh(SurfaceMesh &mesh) const {
+
+    struct EdgeVertex {
+        uint64_t key;
+        Vec3 position;
+    };
+
+    using Triangle = std::array<EdgeVertex, 3>;
+
+    // corner c of a cube sits at offset (c & 1, (c >> 1) & 1, (c >> 2) & 1)
+    static const int tetrahedra[6][4] = {
+        { 0, 1, 3, 7 }, { 0, 1, 5, 7 }, { 0, 2, 3, 7 },
+        { 0, 2, 6, 7 }, { 0, 4, 5, 7 }, { 0, 4, 6, 7 },
+    };
+
+    auto corner_offset = [](int c) { return Eigen::Vector3i(c & 1, (c >> 1) & 1, (c >> 2) & 1); };
+
+    // every tetrahedron edge joins corners a < b with b a superset of a's bits,
+    // so (grid position of a, b - a) names the edge uniquely across cubes
+    auto edge_key = [](const Eigen::Vector3i &g, int direction) {
+        return ((((uint64_t)(g.x() & 0xFFFFF) << 40) | ((uint64_t)(g.y() & 0xFFFFF) << 20) | (uint64_t)(g.z() & 0xFFFFF)) << 3) | (uint64_t)(direction - 1);
+    };
+
+    std::vector<std::vector<Triangle>> block_triangles(blocks.size());
+
+    parallel_for(0, (int)blocks.size(), [&](int index) {
+
+        auto &triangles = block_triangles[index];
+        const Block &block = blocks[index];
+        Eigen::Vector3i base = block_coords[index] * int(block_size);
+
+        for (int z = 0;z < block_size;z++) {
+            for (int y = 0;y < block_size;y++) {
+                for (int x = 0;x < block_size;x++) {
+
+                    Eigen::Vector3i g = base + Eigen::Vector3i(x, y, z);
+
+                    const Voxel *corners[8];
+                    bool complete = true, has_inside = false, has_outside = false;
+
+                    for (int c = 0;c < 8 && complete;c++) {
+                        Eigen::Vector3i o = corner_offset(c);
+                        if (x + o.x() < block_size && y + o.y() < block_size && z + o.z() < block_size) {
+                            corners[c] = &block[voxel_offset(x + o.x(), y + o.y(), z + o.z())];
+                        } else {
+                            corners[c] = find_voxel(g + o);
+                        }
+                        complete = corners[c] != nullptr && corners[c]->weight > 0;
+                        if (complete) {
+                            has_inside |= corners[c]->sdf < 0;
+                            has_outside |= corners[c]->sdf >= 0;
+                        }
+                    }
+
+                    if (!complete || !has_inside || !has_outside) continue;
+
+                    for (auto &tet : tetrahedra) {
+
+                        int inside[4], outside[4];
+                        int n_inside = 0, n_outside = 0;
+                        for (int k = 0;k < 4;k++) {
+                            if (corners[tet[k]]->sdf < 0) inside[n_inside++] = tet[k];
+                            else outside[n_outside++] = tet[k];
+                        }
+
+                        if (n_inside == 0 || n_outside == 0) continue;
+
+                        auto vertex = [&](int a, int b) {
+                            if (a > b) std::swap(a, b);
+                            float sa = corners[a]->sdf, sb = corners[b]->sdf;
+                            Vec3 pa = (g + corner_offset(a)).cast<Scalar>();
+                            Vec3 pb = (g + corner_offset(b)).cast<Scalar>();
+                            Scalar s = sa / (sa - sb);
+                            return EdgeVertex{ edge_key(g + corner_offset(a), b - a), (pa + s * (pb - pa)) * voxel_size };
+                        };
+
+                        // approximate sdf gradient, points from the inside to the outside
+                        Vec3 centroid = Vec3::Zero();
+                        for (int k = 0;k < 4;k++) {
+                            centroid += 0.25f * corner_offset(tet[k]).cast<Scalar>();
+                        }
+                        Vec3 gradient = Vec3::Zero();
+                        for (int k = 0;k < 4;k++) {
+                            gradient += corners[tet[k]]->sdf * (corner_offset(tet[k]).cast<Scalar>() - centroid);
+                        }
+
+                        auto emit = [&](EdgeVertex a, EdgeVertex b, EdgeVertex c) {
+                            Vec3 normal = (b.position - a.position).cross(c.position - a.position);
+                            if (normal.squaredNorm() == 0) return;
+                            if (normal.dot(gradient) < 0) std::swap(b, c);
+                            triangles.push_back(Triangle{{ a, b, c }});
+                        };
+
+                        if (n_inside == 1) {
+                            emit(vertex(inside[0], outside[0]), vertex(inside[0], outside[1]), vertex(inside[0], outside[2]));
+                        } else if (n_outside == 1) {
+                            emit(vertex(outside[0], inside[0]), vertex(outside[0], inside[1]), vertex(outside[0], inside[2]));
+                        } else {
+                            EdgeVertex v00 = vertex(inside[0], outside[0]);
+                            EdgeVertex v01 = vertex(inside[0], outside[1]);
+                            EdgeVertex v10 = vertex(inside[1], outside[0]);
+                            EdgeVertex v11 = vertex(inside[1], outside[1]);
+                            emit(v00, v01, v11);
+                            emit(v00, v11, v10);
+                        }
+
+                    }
+
+                }
+            }
+        }
+
+    }, 1, n_threads);
+
+    // stitch the per-block triangles together, sharing vertices on common edges
+    std::unordered_map<uint64_t, SurfaceMesh::Vertex> vertices;
+
+    for (auto &triangles : block_triangles) {
+        for (auto &triangle : triangles) {
+            SurfaceMesh::Vertex v[3];
+            for (int k = 0;k < 3;k++) {
+                auto it = vertices.find(triangle[k].key);
+                if (it == vertices.end()) {
+                    it = vertices.emplace(triangle[k].key, mesh.add_vertex(triangle[k].position)).first;
+                }
+                v[k] = it->second;
+            }
+            mesh.add_triangle(v[0], v[1], v[2]);
+        }
+    }
+
+}
+
+//=============================================================================
+} // OpenGP::
+//=============================================================================
@@ -0,0 +1,121 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <vector>
+#include <array>
+#include <unordered_map>
+#include <cstdint>
+
+#include <OpenGP/headeronly.h>
+#include <OpenGP/types.h>
+#include <OpenGP/Image/ImageType.h>
+#include <OpenGP/RGBD/Stream.h>
+#include <OpenGP/SurfaceMesh/SurfaceMesh.h>
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+/// @brief Truncated signed distance volume stored as a sparse hash of voxel blocks
+/// @note Blocks are only allocated around observed depth samples, so memory scales
+/// with the observed surface rather than the bounding volume
+class TSDFVolume {
+public:
+
+    /// Number of voxels along each side of a block
+    static constexpr int block_size = 8;
+    static constexpr int block_voxels = block_size * block_size * block_size;
+
+    struct Voxel {
+        float sdf = 1;    ///< truncated distance, normalized to [-1, 1]
+        float weight = 0; ///< 0 means unobserved
+    };
+
+    using Block = std::array<Voxel, block_voxels>;
+
+private:
+
+    Scalar voxel_size;
+    Scalar truncation;
+
+    std::unordered_map<uint64_t, int> block_index;
+    std::vector<Block> blocks;
+    std::vector<Eigen::Vector3i> block_coords;
+
+    static uint64_t block_key(const Eigen::Vector3i &b) {
+        return ((uint64_t)(b.x() & 0x1FFFFF) << 42) | ((uint64_t)(b.y() & 0x1FFFFF) << 21) | (uint64_t)(b.z() & 0x1FFFFF);
+    }
+
+    HEADERONLY_INLINE const Voxel *find_voxel(const Eigen::Vector3i &g) const;
+
+    HEADERONLY_INLINE void allocate_blocks(const uint16_t *depth, const StreamIntrinsics &intrinsics, float depth_scale, const Mat4x4 &camera_to_world, std::vector<int> &visible);
+
+    HEADERONLY_INLINE void integrate_block(int index, const uint16_t *depth, const StreamIntrinsics &intrinsics, float depth_scale, const Mat4x4 &world_to_camera);
+
+public:
+
+    /// Ignore depth samples outside of [min_depth, max_depth] (in depth_scale units, usually meters)
+    Scalar min_depth = 0.1f;
+    Scalar max_depth = 4.0f;
+
+    /// Running average weight is clamped to this value so the model can adapt to change
+    Scalar max_weight = 64;
+
+    /// Worker threads for integration and extraction (0 uses all hardware threads)
+    int n_threads = 0;
+
+    /// @brief Construct an empty volume
+    /// @param voxel_size edge length of a voxel
+    /// @param truncation distance band around the surface that gets updated (defaults to 4 voxels)
+    HEADERONLY_INLINE TSDFVolume(Scalar voxel_size = 0.01f, Scalar truncation = 0);
+
+    /// Remove all blocks
+    HEADERONLY_INLINE void clear();
+
+    /// @brief Fuse a depth frame into the volume
+    /// @param depth row-major depth image of `intrinsics.width` x `intrinsics.height` samples
+    /// @param depth_scale multiplier converting raw depth values into world units
+    /// @param camera_to_world sensor pose (camera looks down +z, y pointing down)
+    HEADERONLY_INLINE void integrate(const uint16_t *depth, const StreamIntrinsics &intrinsics, float depth_scale, const Mat4x4 &camera_to_world);
+
+    /// Fuse a depth image into the volume
+    void integrate(const Image<uint16_t> &depth, const StreamIntrinsics &intrinsics, float depth_scale, const Mat4x4 &camera_to_world) {
+        assert(depth.cols() == intrinsics.width && depth.rows() == intrinsics.height);
+        integrate(depth.data(), intrinsics, depth_scale, camera_to_world);
+    }
+
+    /// Fuse the current frame of a depth stream (e.g. `device.get_stream("DEPTH")`) into the volume
+    void integrate(const SensorStream &depth_stream, float depth_scale, const Mat4x4 &camera_to_world) {
+        integrate((const uint16_t*)depth_stream.get_data(), depth_stream.get_intrinsics(), depth_scale, camera_to_world);
+    }
+
+    /// @brief Extract the zero level set as a triangle mesh
+    /// @note Uses marching tetrahedra over a Kuhn subdivision of each voxel cube, so
+    /// neighbouring cubes (and blocks) share vertices and the output is crack-free
+    HEADERONLY_INLINE void extract_mesh(SurfaceMesh &mesh) const;
+
+    /// Get the TSDF voxel at integer grid coordinate `g`, or nullptr if its block is unallocated
+    const Voxel *get_voxel(const Eigen::Vector3i &g) const { return find_voxel(g); }
+
+    Scalar get_voxel_size() const { return voxel_size; }
+    Scalar get_truncation() const { return truncation; }
+
+    /// Number of allocated voxel blocks
+    size_t n_blocks() const { return blocks.size(); }
+
+    /// Approximate memory used by voxel storage (in bytes)
+    size_t memory_usage() const { return blocks.size() * (sizeof(Block) + sizeof(Eigen::Vector3i)); }
+
+};
+
+//=============================================================================
+} // OpenGP::
+//=============================================================================
+
+#ifdef HEADERONLY
+    #include "TSDFVolume.cpp"
+#endif
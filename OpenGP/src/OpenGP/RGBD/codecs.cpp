@@ -0,0 +1,408 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <cstring>
+#include <algorithm>
+
+#include "codecs.h"
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+namespace {
+
+/// Packs 3-bit groups (plus a continuation bit) into 32-bit words, most significant nibble first
+class NibbleWriter {
+private:
+
+    std::vector<uint8_t> &out;
+    uint32_t word = 0;
+    int n_nibbles = 0;
+
+    void flush_word() {
+        uint8_t bytes[4];
+        std::memcpy(bytes, &word, 4);
+        out.insert(out.end(), bytes, bytes + 4);
+        word = 0;
+        n_nibbles = 0;
+    }
+
+public:
+
+    explicit NibbleWriter(std::vector<uint8_t> &out) : out(out) {}
+
+    void write(uint32_t value) {
+        do {
+            uint32_t nibble = value & 0x7;
+            value >>= 3;
+            if (value) nibble |= 0x8;
+            word = (word << 4) | nibble;
+            if (++n_nibbles == 8) flush_word();
+        } while (value);
+    }
+
+    void finish() {
+        if (n_nibbles == 0) return;
+        word <<= 4 * (8 - n_nibbles);
+        flush_word();
+    }
+
+};
+
+class NibbleReader {
+private:
+
+    const uint8_t *data, *end;
+    uint32_t word = 0;
+    int n_nibbles = 0;
+
+public:
+
+    NibbleReader(const uint8_t *data, size_t size) : data(data), end(data + size) {}
+
+    bool read(uint32_t &value) {
+        value = 0;
+        for (int shift = 0;shift < 32;shift += 3) {
+            if (n_nibbles == 0) {
+                if (end - data < 4) return false;
+                std::memcpy(&word, data, 4);
+                data += 4;
+                n_nibbles = 8;
+            }
+            uint32_t nibble = word >> 28;
+            word <<= 4;
+            n_nibbles--;
+            value |= (nibble & 0x7) << shift;
+            if (!(nibble & 0x8)) return true;
+        }
+        return false;
+    }
+
+};
+
+inline uint32_t qoi_hash(const uint8_t *px) {
+    return (px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64;
+}
+
+const uint8_t QOI_OP_INDEX = 0x00;
+const uint8_t QOI_OP_DIFF = 0x40;
+const uint8_t QOI_OP_LUMA = 0x80;
+const uint8_t QOI_OP_RUN = 0xc0;
+const uint8_t QOI_OP_RGB = 0xfe;
+const uint8_t QOI_OP_RGBA = 0xff;
+const uint8_t QOI_MASK = 0xc0;
+
+const int LZ4_MIN_MATCH = 4;
+const size_t LZ4_LAST_LITERALS = 5;   ///< the block ends with at least this many literals
+const size_t LZ4_MATCH_LIMIT = 12;    ///< no match starts in the last bytes of the block
+const size_t LZ4_MAX_OFFSET = 65535;
+const int LZ4_HASH_BITS = 14;
+
+inline uint32_t lz4_read32(const uint8_t *p) {
+    uint32_t value;
+    std::memcpy(&value, p, 4);
+    return value;
+}
+
+inline uint32_t lz4_hash(uint32_t value) {
+    return (value * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+/// Lengths of 15 and more continue in bytes of 255 and a remainder
+inline void lz4_write_length(size_t length, std::vector<uint8_t> &out) {
+    for (;length >= 255;length -= 255) out.push_back(255);
+    out.push_back((uint8_t)length);
+}
+
+inline bool lz4_read_length(const uint8_t *&data, const uint8_t *end, size_t &length) {
+    uint8_t byte;
+    do {
+        if (data == end) return false;
+        byte = *data++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+/// One sequence: literals, then a match of `match_length` bytes `offset` bytes back (none at the end)
+inline void lz4_write_sequence(const uint8_t *literals, size_t n_literals, size_t offset, size_t match_length, std::vector<uint8_t> &out) {
+    size_t match_code = match_length ? match_length - LZ4_MIN_MATCH : 0;
+    out.push_back((uint8_t)((std::min(n_literals, (size_t)15) << 4) | std::min(match_code, (size_t)15)));
+    if (n_literals >= 15) lz4_write_length(n_literals - 15, out);
+    out.insert(out.end(), literals, literals + n_literals);
+    if (match_length == 0) return;
+    out.push_back((uint8_t)(offset & 0xff));
+    out.push_back((uint8_t)(offset >> 8));
+    if (match_code >= 15) lz4_write_length(match_code - 15, out);
+}
+
+}
+
+size_t rvl_compress(const uint16_t *depth, size_t n_pixels, std::vector<uint8_t> &out) {
+
+    size_t start = out.size();
+    NibbleWriter writer(out);
+
+    const uint16_t *end = depth + n_pixels;
+    int previous = 0;
+
+    while (depth != end) {
+
+        const uint16_t *run = depth;
+        while (depth != end && *depth == 0) depth++;
+        writer.write((uint32_t)(depth - run));
+
+        run = depth;
+        while (depth != end && *depth != 0) depth++;
+        writer.write((uint32_t)(depth - run));
+
+        for (;run != depth;run++) {
+            int delta = *run - previous;
+            writer.write(((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31)); // zigzag
+            previous = *run;
+        }
+
+    }
+
+    writer.finish();
+    return out.size() - start;
+
+}
+
+bool rvl_decompress(const uint8_t *data, size_t size, uint16_t *depth, size_t n_pixels) {
+
+    NibbleReader reader(data, size);
+    uint16_t *end = depth + n_pixels;
+    int previous = 0;
+
+    while (depth != end) {
+
+        uint32_t zeros, nonzeros;
+        if (!reader.read(zeros) || zeros > (size_t)(end - depth)) return false;
+        std::fill(depth, depth + zeros, 0);
+        depth += zeros;
+
+        if (!reader.read(nonzeros) || nonzeros > (size_t)(end - depth)) return false;
+        for (uint32_t k = 0;k < nonzeros;k++) {
+            uint32_t zigzag;
+            if (!reader.read(zigzag)) return false;
+            previous += (int)(zigzag >> 1) ^ -(int)(zigzag & 1);
+            *depth++ = (uint16_t)previous;
+        }
+
+    }
+
+    return true;
+
+}
+
+size_t qoi_compress(const uint8_t *pixels, size_t n_pixels, int channels, std::vector<uint8_t> &out) {
+
+    size_t start = out.size();
+
+    uint8_t index[64][4] = {};
+    uint8_t previous[4] = { 0, 0, 0, 255 };
+    uint8_t px[4] = { 0, 0, 0, 255 };
+    int run = 0;
+
+    for (size_t i = 0;i < n_pixels;i++) {
+
+        std::memcpy(px, pixels + i * channels, channels);
+
+        if (std::memcmp(px, previous, 4) == 0) {
+            if (++run == 62 || i == n_pixels - 1) {
+                out.push_back(QOI_OP_RUN | (uint8_t)(run - 1));
+                run = 0;
+            }
+            continue;
+        }
+
+        if (run > 0) {
+            out.push_back(QOI_OP_RUN | (uint8_t)(run - 1));
+            run = 0;
+        }
+
+        uint32_t hash = qoi_hash(px);
+
+        if (std::memcmp(index[hash], px, 4) == 0) {
+            out.push_back(QOI_OP_INDEX | (uint8_t)hash);
+        } else {
+
+            std::memcpy(index[hash], px, 4);
+
+            if (px[3] == previous[3]) {
+
+                int8_t vr = (int8_t)(px[0] - previous[0]);
+                int8_t vg = (int8_t)(px[1] - previous[1]);
+                int8_t vb = (int8_t)(px[2] - previous[2]);
+                int8_t vg_r = (int8_t)(vr - vg);
+                int8_t vg_b = (int8_t)(vb - vg);
+
+                if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+                    out.push_back(QOI_OP_DIFF | (uint8_t)((vr + 2) << 4 | (vg + 2) << 2 | (vb + 2)));
+                } else if (vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 && vg_b > -9 && vg_b < 8) {
+                    out.push_back(QOI_OP_LUMA | (uint8_t)(vg + 32));
+                    out.push_back((uint8_t)((vg_r + 8) << 4 | (vg_b + 8)));
+                } else {
+                    out.insert(out.end(), { QOI_OP_RGB, px[0], px[1], px[2] });
+                }
+
+            } else {
+                out.insert(out.end(), { QOI_OP_RGBA, px[0], px[1], px[2], px[3] });
+            }
+
+        }
+
+        std::memcpy(previous, px, 4);
+
+    }
+
+    return out.size() - start;
+
+}
+
+bool qoi_decompress(const uint8_t *data, size_t size, uint8_t *pixels, size_t n_pixels, int channels) {
+
+    const uint8_t *end = data + size;
+
+    uint8_t index[64][4] = {};
+    uint8_t px[4] = { 0, 0, 0, 255 };
+    int run = 0;
+
+    for (size_t i = 0;i < n_pixels;i++) {
+
+        if (run > 0) {
+            run--;
+        } else {
+
+            if (data == end) return false;
+            uint8_t op = *data++;
+
+            if (op == QOI_OP_RGB) {
+                if (end - data < 3) return false;
+                std::memcpy(px, data, 3);
+                data += 3;
+            } else if (op == QOI_OP_RGBA) {
+                if (end - data < 4) return false;
+                std::memcpy(px, data, 4);
+                data += 4;
+            } else if ((op & QOI_MASK) == QOI_OP_INDEX) {
+                std::memcpy(px, index[op], 4);
+            } else if ((op & QOI_MASK) == QOI_OP_DIFF) {
+                px[0] += ((op >> 4) & 0x03) - 2;
+                px[1] += ((op >> 2) & 0x03) - 2;
+                px[2] += (op & 0x03) - 2;
+            } else if ((op & QOI_MASK) == QOI_OP_LUMA) {
+                if (data == end) return false;
+                uint8_t next = *data++;
+                int vg = (op & 0x3f) - 32;
+                px[0] += vg - 8 + ((next >> 4) & 0x0f);
+                px[1] += vg;
+                px[2] += vg - 8 + (next & 0x0f);
+            } else {
+                run = op & 0x3f;
+            }
+
+            std::memcpy(index[qoi_hash(px)], px, 4);
+
+        }
+
+        std::memcpy(pixels + i * channels, px, channels);
+
+    }
+
+    return true;
+
+}
+
+size_t lz4_compress(const uint8_t *data, size_t size, std::vector<uint8_t> &out) {
+
+    size_t start = out.size();
+    size_t anchor = 0;
+
+    if (size > LZ4_MATCH_LIMIT) {
+
+        // positions + 1 of the last occurrences of 4-byte sequences, 0 for none
+        std::vector<uint32_t> table(1 << LZ4_HASH_BITS, 0);
+        const size_t match_limit = size - LZ4_MATCH_LIMIT, copy_limit = size - LZ4_LAST_LITERALS;
+
+        for (size_t i = 0;i < match_limit;) {
+
+            uint32_t value = lz4_read32(data + i);
+            uint32_t &entry = table[lz4_hash(value)];
+            size_t candidate = entry;
+            entry = (uint32_t)(i + 1);
+
+            if (candidate == 0 || i - (candidate - 1) > LZ4_MAX_OFFSET || lz4_read32(data + candidate - 1) != value) {
+                // step faster through data that does not compress
+                i += 1 + ((i - anchor) >> 6);
+                continue;
+            }
+
+            size_t match = candidate - 1, length = LZ4_MIN_MATCH;
+            while (i + length < copy_limit && data[match + length] == data[i + length]) length++;
+
+            lz4_write_sequence(data + anchor, i - anchor, i - match, length, out);
+            i += length;
+            anchor = i;
+
+        }
+
+    }
+
+    lz4_write_sequence(data + anchor, size - anchor, 0, 0, out);
+
+    return out.size() - start;
+
+}
+
+bool lz4_decompress(const uint8_t *data, size_t data_size, uint8_t *out, size_t size) {
+
+    const uint8_t *end = data + data_size;
+    size_t written = 0;
+
+    while (data != end) {
+
+        uint8_t token = *data++;
+
+        size_t n_literals = token >> 4;
+        if (n_literals == 15 && !lz4_read_length(data, end, n_literals)) return false;
+        if ((size_t)(end - data) < n_literals || size - written < n_literals) return false;
+        std::memcpy(out + written, data, n_literals);
+        data += n_literals;
+        written += n_literals;
+
+        // the last sequence has no match
+        if (data == end) break;
+
+        if (end - data < 2) return false;
+        size_t offset = data[0] | (data[1] << 8);
+        data += 2;
+        size_t length = (token & 0x0f);
+        if (length == 15 && !lz4_read_length(data, end, length)) return false;
+        length += LZ4_MIN_MATCH;
+
+        if (offset == 0 || offset > written || size - written < length) return false;
+
+        // matches may overlap the bytes they produce
+        const uint8_t *from = out + written - offset;
+        uint8_t *to = out + written;
+        if (offset >= length) {
+            std::memcpy(to, from, length);
+        } else {
+            for (size_t k = 0;k < length;k++) to[k] = from[k];
+        }
+        written += length;
+
+    }
+
+    return written == size;
+
+}
+
+//=============================================================================
+} // OpenGP::
+//=============================================================================
@@ -0,0 +1,46 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include <OpenGP/headeronly.h>
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+/// @brief Lossless RVL compression of 16-bit depth (Wilson, "Fast Lossless Depth Image Compression", 2017)
+/// @note Runs of zero (missing) samples and the deltas between consecutive valid samples
+/// are stored as variable-length nibbles. Appends to `out`, returns the number of bytes appended.
+HEADERONLY_INLINE size_t rvl_compress(const uint16_t *depth, size_t n_pixels, std::vector<uint8_t> &out);
+
+/// Decompress `n_pixels` samples, returns false if the data is truncated or malformed
+HEADERONLY_INLINE bool rvl_decompress(const uint8_t *data, size_t size, uint16_t *depth, size_t n_pixels);
+
+/// @brief Lossless compression of 8-bit RGB or RGBA pixels with the QOI scheme (headerless)
+/// @note Appends to `out`, returns the number of bytes appended.
+HEADERONLY_INLINE size_t qoi_compress(const uint8_t *pixels, size_t n_pixels, int channels, std::vector<uint8_t> &out);
+
+/// Decompress `n_pixels` pixels, returns false if the data is truncated or malformed
+HEADERONLY_INLINE bool qoi_decompress(const uint8_t *data, size_t size, uint8_t *pixels, size_t n_pixels, int channels);
+
+/// @brief Fast general purpose compression in the LZ4 block format (greedy matching, single pass)
+/// @note Appends to `out`, returns the number of bytes appended.
+HEADERONLY_INLINE size_t lz4_compress(const uint8_t *data, size_t size, std::vector<uint8_t> &out);
+
+/// Decompress exactly `size` bytes, returns false if the data is truncated or malformed
+HEADERONLY_INLINE bool lz4_decompress(const uint8_t *data, size_t data_size, uint8_t *out, size_t size);
+
+//=============================================================================
+} // OpenGP::
+//=============================================================================
+
+#ifdef HEADERONLY
+    #include "codecs.cpp"
+#endif
@@ -67,7 +67,7 @@ inline SensorDevice get_realsense_device() {
         streams.emplace(
             std::piecewise_construct,
             std::forward_as_tuple(name),
-            std::forward_as_tuple(name.c_str(), const_cast<const void**>(&stream_data_ptrs->at(name)), intrinsics, extrinsics, framerate)
+            std::forward_as_tuple(name.c_str(), const_cast<const void**>(&stream_data_ptrs->at(name)), intrinsics, extrinsics, framerate, StreamFormat::Z16)
         );
     }
 
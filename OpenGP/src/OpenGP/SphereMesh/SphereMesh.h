@@ -5,6 +5,7 @@
 #pragma once
 
 #include <vector>
+#include <algorithm>
 #include <regex>
 #include <iostream>
 #include <fstream>
@@ -262,6 +263,21 @@ private:
 
     bool has_garbage;
 
+    /// Optional vertex -> primitive incidence lists (see `enable_incidence_index()`)
+    VertexProperty<std::vector<Sphere>> vspheres;
+    VertexProperty<std::vector<Edge>>   vedges;
+    VertexProperty<std::vector<Face>>   vfaces;
+
+    /// Remove a single occurrence of `h` from `list` (order is not preserved)
+    template <typename H>
+    static void remove_incident(std::vector<H> &list, H h) {
+        auto it = std::find(list.begin(), list.end(), h);
+        if (it != list.end()) {
+            *it = list.back();
+            list.pop_back();
+        }
+    }
+
 public:
 
     /// Default constructor for an empty Sphere Mesh
@@ -270,8 +286,14 @@ public:
         econn  = add_edge_property<EdgeConnectivity>("e:connectivity");
         fconn  = add_face_property<FaceConnectivity>("f:connectivity");
         vpoint = add_vertex_property<Point>("v:point");
-        
+
+        vdeleted = add_vertex_property<bool>("v:deleted", false);
+        sdeleted = add_sphere_property<bool>("s:deleted", false);
+        edeleted = add_edge_property<bool>("e:deleted", false);
+        fdeleted = add_face_property<bool>("f:deleted", false);
+
         deleted_vertices = deleted_spheres = deleted_edges = deleted_faces = 0;
+        has_garbage = false;
     }
 
     virtual ~SphereMesh() {}
@@ -328,28 +350,42 @@ public:
     /// Add a singular sphere at vertex `vertex`
     Sphere add_sphere(Vertex vertex) {
         sprops.push_back();
-        sconn[*(--(spheres_end()))] = vertex.idx();
-        return *(--spheres_end());
+        Sphere s = *(--spheres_end());
+        sconn[s] = vertex.idx();
+        if (vspheres) vspheres[vertex].push_back(s);
+        return s;
     }
 
     /// Add an edge (pill) between vertices `v0` and `v1`
     Edge add_edge(Vertex v0, Vertex v1) {
         eprops.push_back();
-        econn[*(--(edges_end()))] = EdgeConnectivity(v0.idx(), v1.idx());
-        return *(--edges_end());
+        Edge e = *(--edges_end());
+        econn[e] = EdgeConnectivity(v0.idx(), v1.idx());
+        if (vedges) {
+            vedges[v0].push_back(e);
+            vedges[v1].push_back(e);
+        }
+        return e;
     }
 
     /// Add a face (wedge) between vertices `v0`, `v1`, and `v2`
     Face add_face(Vertex v0, Vertex v1, Vertex v2) {
         fprops.push_back();
-        fconn[*(--(faces_end()))] = FaceConnectivity(v0.idx(), v1.idx(), v2.idx());
-        return *(--faces_end());
+        Face f = *(--faces_end());
+        fconn[f] = FaceConnectivity(v0.idx(), v1.idx(), v2.idx());
+        if (vfaces) {
+            vfaces[v0].push_back(f);
+            vfaces[v1].push_back(f);
+            vfaces[v2].push_back(f);
+        }
+        return f;
     }
 
     /// Delete vertex `v` from the mesh
     void delete_vertex(Vertex v) {
 
         /// @note This will also delete any primitives that include `v`
+        /// @note Without an incidence index this scans every primitive in the mesh
 
         if (vdeleted[v]) return;
 
@@ -357,22 +393,33 @@ public:
         std::vector<Edge> edges_to_delete;
         std::vector<Face> faces_to_delete;
 
-        for (auto s : spheres()) {
-            if (Vertex(sconn[s]) == v) {
-                spheres_to_delete.push_back(s);
+        if (has_incidence_index()) {
+
+            // copies, since deleting a primitive removes it from these lists
+            spheres_to_delete = vspheres[v];
+            edges_to_delete = vedges[v];
+            faces_to_delete = vfaces[v];
+
+        } else {
+
+            for (auto s : spheres()) {
+                if (Vertex(sconn[s]) == v) {
+                    spheres_to_delete.push_back(s);
+                }
             }
-        }
 
-        for (auto e : edges()) {
-            if (Vertex(econn[e](0)) == v || Vertex(econn[e](1)) == v) {
-                edges_to_delete.push_back(e);
+            for (auto e : edges()) {
+                if (Vertex(econn[e](0)) == v || Vertex(econn[e](1)) == v) {
+                    edges_to_delete.push_back(e);
+                }
             }
-        }
 
-        for (auto f : faces()) {
-            if (Vertex(fconn[f](0)) == v || Vertex(fconn[f](1)) == v || Vertex(fconn[f](2)) == v) {
-                faces_to_delete.push_back(f);
+            for (auto f : faces()) {
+                if (Vertex(fconn[f](0)) == v || Vertex(fconn[f](1)) == v || Vertex(fconn[f](2)) == v) {
+                    faces_to_delete.push_back(f);
+                }
             }
+
         }
 
         for (auto s : spheres_to_delete) {
@@ -398,6 +445,8 @@ public:
 
         if (sdeleted[s]) return;
 
+        if (vspheres) remove_incident(vspheres[vertex(s)], s);
+
         sdeleted[s] = true;
         deleted_spheres++;
         has_garbage = true;
@@ -409,6 +458,11 @@ public:
 
         if (edeleted[e]) return;
 
+        if (vedges) {
+            remove_incident(vedges[vertex(e, 0)], e);
+            remove_incident(vedges[vertex(e, 1)], e);
+        }
+
         edeleted[e] = true;
         deleted_edges++;
         has_garbage = true;
@@ -420,6 +474,12 @@ public:
 
         if (fdeleted[f]) return;
 
+        if (vfaces) {
+            remove_incident(vfaces[vertex(f, 0)], f);
+            remove_incident(vfaces[vertex(f, 1)], f);
+            remove_incident(vfaces[vertex(f, 2)], f);
+        }
+
         fdeleted[f] = true;
         deleted_faces++;
         has_garbage = true;
@@ -435,6 +495,66 @@ public:
     /// Get the ith vertex in face (wedge) `f`
     Vertex vertex(Face f, int i) const { assert(i < 3 && i > -1); return Vertex(fconn[f](i)); }
 
+    /// @brief Build and start maintaining the vertex -> sphere/edge/face incidence lists
+    /// @note With the index enabled `delete_vertex()` only touches the primitives
+    /// incident to the vertex, at the cost of some memory and slower `add_*()`
+    void enable_incidence_index() {
+        if (!vspheres) vspheres = add_vertex_property<std::vector<Sphere>>("v:incident-spheres");
+        if (!vedges)   vedges   = add_vertex_property<std::vector<Edge>>("v:incident-edges");
+        if (!vfaces)   vfaces   = add_vertex_property<std::vector<Face>>("v:incident-faces");
+        rebuild_incidence_index();
+    }
+
+    /// Stop maintaining the incidence lists and release their memory
+    void disable_incidence_index() {
+        if (vspheres) remove_vertex_property(vspheres);
+        if (vedges)   remove_vertex_property(vedges);
+        if (vfaces)   remove_vertex_property(vfaces);
+    }
+
+    /// Check if the vertex -> primitive incidence lists are being maintained
+    bool has_incidence_index() const { return vspheres && vedges && vfaces; }
+
+    /// Recompute the incidence lists from scratch (called by `garbage_collection()`)
+    void rebuild_incidence_index() {
+
+        if (!has_incidence_index()) return;
+
+        for (auto v : vertices()) {
+            vspheres[v].clear();
+            vedges[v].clear();
+            vfaces[v].clear();
+        }
+
+        for (auto s : spheres()) {
+            if (sdeleted[s]) continue;
+            vspheres[vertex(s)].push_back(s);
+        }
+
+        for (auto e : edges()) {
+            if (edeleted[e]) continue;
+            vedges[vertex(e, 0)].push_back(e);
+            vedges[vertex(e, 1)].push_back(e);
+        }
+
+        for (auto f : faces()) {
+            if (fdeleted[f]) continue;
+            vfaces[vertex(f, 0)].push_back(f);
+            vfaces[vertex(f, 1)].push_back(f);
+            vfaces[vertex(f, 2)].push_back(f);
+        }
+
+    }
+
+    /// Get the singular spheres at vertex `v` (requires the incidence index)
+    const std::vector<Sphere> &incident_spheres(Vertex v) const { assert(has_incidence_index()); return vspheres[v]; }
+
+    /// Get the edges (pills) that include vertex `v` (requires the incidence index)
+    const std::vector<Edge> &incident_edges(Vertex v) const { assert(has_incidence_index()); return vedges[v]; }
+
+    /// Get the faces (wedges) that include vertex `v` (requires the incidence index)
+    const std::vector<Face> &incident_faces(Vertex v) const { assert(has_incidence_index()); return vfaces[v]; }
+
     /// Get an iterator pointing at the first vertex
     VertexIterator vertices_begin() const { return VertexIterator(Vertex(0), this); }
 
@@ -684,6 +804,8 @@ public:
 
         }
 
+        rebuild_incidence_index();
+
         return true;
 
     }
@@ -847,7 +969,7 @@ public:
             nF = fdeleted[Face(i0)] ? i0 : i0+1;
         }
 
-        for (i = 0;i < nV;i++) {
+        for (i = 0;i < nS;i++) {
 
             Sphere s(i);
 
@@ -885,6 +1007,9 @@ public:
         deleted_vertices = deleted_spheres = deleted_edges = deleted_faces = 0;
         has_garbage = false;
 
+        // primitive indices changed, so the incidence lists are recompacted
+        rebuild_incidence_index();
+
     }
 
 };
@@ -83,15 +83,15 @@ const char *SurfaceMeshRenderer::fshader() {
     )GLSL";
 }
 
-SurfaceMeshRenderer::SurfaceMeshRenderer() {
+SurfaceMeshRenderer::SurfaceMeshRenderer() : gpu_mesh(new GPUMesh()) {
     rebuild();
 }
 
-void SurfaceMeshRenderer::render(const RenderContext &context) {
+void SurfaceMeshRenderer::draw(Shader &shader, const RenderContext &context, GLsizei instances) {
 
     shader.bind();
 
-    gpu_mesh.set_attributes(shader);
+    gpu_mesh->set_attributes(shader);
     update_shader(shader, context);
 
     if (wireframe_mode == WireframeMode::WiresOnly)
@@ -100,10 +100,10 @@ void SurfaceMeshRenderer::render(const RenderContext &context) {
     if (!depth_test)
         glDisable(GL_DEPTH_TEST);
 
-    if (instancing.enabled)
-        gpu_mesh.draw_instanced(instancing.count);
+    if (instances > 0)
+        gpu_mesh->draw_instanced(instances);
     else
-        gpu_mesh.draw();
+        gpu_mesh->draw();
 
     if (!depth_test)
         glEnable(GL_DEPTH_TEST);
@@ -114,28 +114,80 @@ void SurfaceMeshRenderer::render(const RenderContext &context) {
     shader.unbind();
 }
 
+void SurfaceMeshRenderer::render(const RenderContext &context) {
+    draw(shader, context, instancing.enabled ? instancing.count : 0);
+}
+
+InstanceBatchKey SurfaceMeshRenderer::get_instance_batch_key() const {
+
+    InstanceBatchKey key;
+
+    // wireframes carry a color, which is not part of the key; draws without depth test depend
+    // on their order, which batching changes; only the vertex stage has per instance models
+    if (instancing.enabled || wireframe_mode != WireframeMode::None || !depth_test)
+        return key;
+    if (material.uses_model_after_vertex_stage())
+        return key;
+
+    key.geometry = gpu_mesh.get();
+    key.material = material.get_revision();
+
+    return key;
+
+}
+
+void SurfaceMeshRenderer::render_instanced(const RenderContext &context, const Mat4x4 *models, size_t count) {
+
+    if (!instanced_shader_built) {
+        build_shader(instanced_shader, vshader(), fshader(), gshader(), true);
+        instanced_shader_built = true;
+    }
+
+    gpu_mesh->stream_vbo_raw<Mat4x4>("_instance_M", models, count, 1);
+
+    draw(instanced_shader, context, (GLsizei)count);
+
+}
+
 void SurfaceMeshRenderer::rebuild() {
 
     build_shader(shader, vshader(), fshader(), gshader());
+    instanced_shader_built = false;
 
     shader.bind();
-    gpu_mesh.set_attributes(shader);
+    gpu_mesh->set_attributes(shader);
     shader.unbind();
 
 }
 
+Box3 SurfaceMeshRenderer::get_bounding_box() const {
+    // instances are placed by attributes the mesh bounds know nothing of
+    if (instancing.enabled) return Box3();
+    return gpu_mesh->get_bounding_box();
+}
+
 void SurfaceMeshRenderer::upload_mesh(const SurfaceMesh &mesh) {
 
-    gpu_mesh.init_from_mesh(mesh);
+    gpu_mesh->init_from_mesh(mesh);
 
     shader.bind();
-    gpu_mesh.set_attributes(shader);
+    gpu_mesh->set_attributes(shader);
     shader.unbind();
 
 }
 
 GPUMesh &SurfaceMeshRenderer::get_gpu_mesh() {
-    return gpu_mesh;
+    return *gpu_mesh;
+}
+
+void SurfaceMeshRenderer::share_gpu_mesh(const SurfaceMeshRenderer &other) {
+
+    gpu_mesh = other.gpu_mesh;
+
+    shader.bind();
+    gpu_mesh->set_attributes(shader);
+    shader.unbind();
+
 }
 
 //=============================================================================
@@ -4,6 +4,8 @@
 
 #pragma once
 
+#include <memory>
+
 #include <OpenGP/GL/MaterialRenderer.h>
 #include <OpenGP/GL/GPUMesh.h>
 #include <OpenGP/SurfaceMesh/SurfaceMesh.h>
@@ -16,14 +18,21 @@ namespace OpenGP {
 class SurfaceMeshRenderer : public MaterialRenderer {
 private:
 
-    GPUMesh gpu_mesh;
+    std::shared_ptr<GPUMesh> gpu_mesh; ///< shared by the renderers of copies of a mesh
 
     Shader shader;
 
+    /// Variant of `shader` for `render_instanced`, built on first use
+    Shader instanced_shader;
+    bool instanced_shader_built = false;
+
     HEADERONLY_INLINE static const char *vshader();
     HEADERONLY_INLINE static const char *gshader();
     HEADERONLY_INLINE static const char *fshader();
 
+    /// Draw `instances` instances of the mesh with `shader` (0: a plain draw)
+    HEADERONLY_INLINE void draw(Shader &shader, const RenderContext &context, GLsizei instances);
+
 public:
 
     bool depth_test = true;
@@ -38,12 +47,26 @@ public:
 
     HEADERONLY_INLINE void render(const RenderContext&);
 
+    /// @brief Renderers drawing the same GPU mesh with the same material batch together, unless
+    /// instanced by hand (`instancing`), in wireframe, without depth test, or with a material
+    /// that `uses_model_after_vertex_stage()`
+    HEADERONLY_INLINE InstanceBatchKey get_instance_batch_key() const;
+
+    /// One draw of the mesh for all of `models`, streamed to the `_instance_M` attribute
+    HEADERONLY_INLINE void render_instanced(const RenderContext &context, const Mat4x4 *models, size_t count);
+
     HEADERONLY_INLINE void rebuild();
 
+    HEADERONLY_INLINE Box3 get_bounding_box() const;
+
     HEADERONLY_INLINE void upload_mesh(const SurfaceMesh &mesh);
 
     HEADERONLY_INLINE GPUMesh &get_gpu_mesh();
 
+    /// @brief Draw the GPU mesh of `other` (uploads to either show in both), so that the two
+    /// can be batched into instanced draws
+    HEADERONLY_INLINE void share_gpu_mesh(const SurfaceMeshRenderer &other);
+
 };
 
 //=============================================================================
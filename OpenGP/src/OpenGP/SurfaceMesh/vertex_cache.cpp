@@ -0,0 +1,304 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include "vertex_cache.h"
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+namespace {
+
+    /// Triangles around each vertex, in compressed rows
+    struct VertexTriangles {
+
+        std::vector<unsigned int> offsets;   ///< n_vertices + 1
+        std::vector<unsigned int> triangles;
+
+        VertexTriangles(const std::vector<unsigned int> &indices, size_t n_vertices) : offsets(n_vertices + 1, 0), triangles(indices.size()) {
+            for (unsigned int v : indices) offsets[v + 1]++;
+            for (size_t v = 0;v < n_vertices;v++) offsets[v + 1] += offsets[v];
+            std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+            for (size_t i = 0;i < indices.size();i++) triangles[fill[indices[i]]++] = (unsigned int)(i / 3);
+        }
+
+        unsigned int count(unsigned int v) const { return offsets[v + 1] - offsets[v]; }
+        const unsigned int *begin(unsigned int v) const { return triangles.data() + offsets[v]; }
+        const unsigned int *end(unsigned int v) const { return triangles.data() + offsets[v + 1]; }
+
+    };
+
+    ///--- Forsyth
+
+    const int forsyth_cache_size = 32;
+
+    const unsigned int forsyth_max_live = 32;
+
+    /// Scores of vertices by cache position (-1 when not cached) and remaining triangle count
+    struct ForsythScores {
+
+        float position_score[forsyth_cache_size + 1];
+        float live_score[forsyth_max_live];
+
+        ForsythScores() {
+            position_score[0] = 0;
+            for (int i = 0;i < forsyth_cache_size;i++) {
+                // the vertices of the last triangle get a fixed score, so that strips are not favoured
+                const float scale = 1.0f / (forsyth_cache_size - 3);
+                position_score[i + 1] = (i < 3) ? 0.75f : std::pow(1.0f - (i - 3) * scale, 1.5f);
+            }
+            // vertices with few triangles left are finished first, so they do not linger
+            live_score[0] = 0;
+            for (unsigned int i = 1;i < forsyth_max_live;i++) live_score[i] = 2.0f / std::sqrt((float)i);
+        }
+
+        float operator()(int cache_position, unsigned int live) const {
+            if (live == 0) return -1; // no triangle needs it anymore
+            return position_score[cache_position + 1] + ((live < forsyth_max_live) ? live_score[live] : 2.0f / std::sqrt((float)live));
+        }
+
+    };
+
+    void forsyth(std::vector<unsigned int> &indices, size_t n_vertices) {
+
+        const size_t n_triangles = indices.size() / 3;
+        const VertexTriangles adjacency(indices, n_vertices);
+        const ForsythScores forsyth_score;
+
+        std::vector<unsigned int> live(n_vertices);
+        std::vector<int> cache_position(n_vertices, -1);
+        std::vector<float> vertex_score(n_vertices);
+        for (size_t v = 0;v < n_vertices;v++) {
+            live[v] = adjacency.count((unsigned int)v);
+            vertex_score[v] = forsyth_score(-1, live[v]);
+        }
+
+        std::vector<float> triangle_score(n_triangles);
+        std::vector<char> emitted(n_triangles, 0);
+        for (size_t t = 0;t < n_triangles;t++) {
+            triangle_score[t] = vertex_score[indices[3 * t]] + vertex_score[indices[3 * t + 1]] + vertex_score[indices[3 * t + 2]];
+        }
+
+        std::vector<unsigned int> result;
+        result.reserve(indices.size());
+
+        // the cache holds 3 more entries while the emitted triangle is pushed in
+        std::vector<unsigned int> cache, next_cache;
+        cache.reserve(forsyth_cache_size + 3);
+        next_cache.reserve(forsyth_cache_size + 3);
+
+        size_t cursor = 0; ///< triangles before it are all emitted
+        long best = -1;
+
+        for (size_t emitted_count = 0;emitted_count < n_triangles;emitted_count++) {
+
+            if (best < 0) {
+                // dead end: the cache has nothing left to offer, restart from the first triangle left
+                while (emitted[cursor]) cursor++;
+                best = (long)cursor;
+            }
+
+            const unsigned int *triangle = indices.data() + 3 * best;
+            emitted[best] = 1;
+            result.insert(result.end(), triangle, triangle + 3);
+
+            next_cache.assign(triangle, triangle + 3);
+            for (unsigned int v : cache) {
+                if (v != triangle[0] && v != triangle[1] && v != triangle[2]) next_cache.push_back(v);
+            }
+            for (int i = 0;i < 3;i++) live[triangle[i]]--;
+
+            // rescore the vertices that moved in the cache (or out of it) and their triangles
+            for (size_t i = 0;i < next_cache.size();i++) {
+                cache_position[next_cache[i]] = (i < (size_t)forsyth_cache_size) ? (int)i : -1;
+            }
+            for (unsigned int v : next_cache) {
+                float score = forsyth_score(cache_position[v], live[v]);
+                float difference = score - vertex_score[v];
+                if (difference == 0) continue;
+                vertex_score[v] = score;
+                for (const unsigned int *t = adjacency.begin(v);t != adjacency.end(v);t++) {
+                    triangle_score[*t] += difference;
+                }
+            }
+            if (next_cache.size() > (size_t)forsyth_cache_size) next_cache.resize(forsyth_cache_size);
+            cache.swap(next_cache);
+
+            // the best triangle around the cached vertices comes next
+            best = -1;
+            float best_score = -std::numeric_limits<float>::max();
+            for (unsigned int v : cache) {
+                if (live[v] == 0) continue;
+                for (const unsigned int *t = adjacency.begin(v);t != adjacency.end(v);t++) {
+                    if (!emitted[*t] && triangle_score[*t] > best_score) {
+                        best_score = triangle_score[*t];
+                        best = *t;
+                    }
+                }
+            }
+
+        }
+
+        indices.swap(result);
+
+    }
+
+    ///--- Tipsify
+
+    void tipsify(std::vector<unsigned int> &indices, size_t n_vertices, int cache_size) {
+
+        const size_t n_triangles = indices.size() / 3;
+        const VertexTriangles adjacency(indices, n_vertices);
+
+        std::vector<unsigned int> live(n_vertices);
+        for (size_t v = 0;v < n_vertices;v++) live[v] = adjacency.count((unsigned int)v);
+
+        std::vector<long> cache_time(n_vertices, std::numeric_limits<long>::min() / 2);
+        std::vector<char> emitted(n_triangles, 0);
+        std::vector<unsigned int> dead_end, candidates;
+
+        std::vector<unsigned int> result;
+        result.reserve(indices.size());
+
+        long time = cache_size + 1;
+        size_t cursor = 0;
+        long fan = n_vertices > 0 ? 0 : -1;
+
+        while (fan >= 0) {
+
+            // emit all the triangles around the fanning vertex
+            candidates.clear();
+            for (const unsigned int *t = adjacency.begin(fan);t != adjacency.end(fan);t++) {
+                if (emitted[*t]) continue;
+                emitted[*t] = 1;
+                for (int i = 0;i < 3;i++) {
+                    unsigned int v = indices[3 * *t + i];
+                    result.push_back(v);
+                    dead_end.push_back(v);
+                    candidates.push_back(v);
+                    live[v]--;
+                    if (time - cache_time[v] > cache_size) {
+                        cache_time[v] = time++;
+                    }
+                }
+            }
+
+            // next, the candidate that will still be in the cache after its fan and is the oldest in it
+            fan = -1;
+            long best_priority = -1;
+            for (unsigned int v : candidates) {
+                if (live[v] == 0) continue;
+                long priority = 0;
+                if (time - cache_time[v] + 2 * (long)live[v] <= cache_size) priority = time - cache_time[v];
+                if (priority > best_priority) {
+                    best_priority = priority;
+                    fan = v;
+                }
+            }
+
+            if (fan < 0) {
+                // dead end: the most recent vertex with triangles left, else the next one in order
+                while (!dead_end.empty() && fan < 0) {
+                    unsigned int v = dead_end.back();
+                    dead_end.pop_back();
+                    if (live[v] > 0) fan = v;
+                }
+                while (fan < 0 && cursor < n_vertices) {
+                    if (live[cursor] > 0) fan = (long)cursor;
+                    cursor++;
+                }
+            }
+
+        }
+
+        indices.swap(result);
+
+    }
+
+}
+
+VertexCacheStatistics analyze_vertex_cache(const std::vector<unsigned int> &indices, size_t n_vertices, int cache_size, VertexCacheModel model) {
+
+    VertexCacheStatistics statistics;
+
+    std::vector<char> referenced(n_vertices, 0);
+    size_t n_referenced = 0;
+
+    if (model == VertexCacheModel::FIFO) {
+
+        // a vertex is cached while fewer than `cache_size` vertices were transformed after it
+        std::vector<size_t> inserted(n_vertices, 0);
+        for (unsigned int v : indices) {
+            if (inserted[v] == 0 || statistics.transformed - inserted[v] >= (size_t)cache_size) {
+                statistics.transformed++;
+                inserted[v] = statistics.transformed;
+            }
+            if (!referenced[v]) { referenced[v] = 1; n_referenced++; }
+        }
+
+    } else {
+
+        std::vector<unsigned int> cache;
+        cache.reserve(cache_size);
+        for (unsigned int v : indices) {
+            auto it = std::find(cache.begin(), cache.end(), v);
+            if (it == cache.end()) {
+                statistics.transformed++;
+                if ((int)cache.size() == cache_size) cache.pop_back();
+                cache.insert(cache.begin(), v);
+            } else {
+                std::rotate(cache.begin(), it, it + 1);
+            }
+            if (!referenced[v]) { referenced[v] = 1; n_referenced++; }
+        }
+
+    }
+
+    size_t n_triangles = indices.size() / 3;
+    statistics.acmr = n_triangles ? (double)statistics.transformed / n_triangles : 0;
+    statistics.atvr = n_referenced ? (double)statistics.transformed / n_referenced : 0;
+
+    return statistics;
+
+}
+
+void optimize_vertex_cache(std::vector<unsigned int> &indices, size_t n_vertices, VertexCacheOptimizer optimizer, int cache_size) {
+
+    switch (optimizer) {
+        case VertexCacheOptimizer::Forsyth: forsyth(indices, n_vertices); break;
+        case VertexCacheOptimizer::Tipsify: tipsify(indices, n_vertices, cache_size); break;
+        default: break;
+    }
+
+}
+
+std::vector<unsigned int> optimize_vertex_fetch(std::vector<unsigned int> &indices, size_t n_vertices) {
+
+    const unsigned int unassigned = std::numeric_limits<unsigned int>::max();
+    std::vector<unsigned int> remap(n_vertices, unassigned), order;
+    order.reserve(n_vertices);
+
+    for (unsigned int &v : indices) {
+        if (remap[v] == unassigned) {
+            remap[v] = (unsigned int)order.size();
+            order.push_back(v);
+        }
+        v = remap[v];
+    }
+
+    for (size_t v = 0;v < n_vertices;v++) {
+        if (remap[v] == unassigned) order.push_back((unsigned int)v);
+    }
+
+    return order;
+
+}
+
+//=============================================================================
+} // namespace OpenGP
+//=============================================================================
@@ -0,0 +1,69 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+#include <OpenGP/headeronly.h>
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+/// @file
+/// Reordering of triangle index buffers for the GPU post-transform vertex cache, and of
+/// vertices for locality of vertex fetches, with a CPU simulation of the cache to measure
+/// the result. Index buffers are lists of triangles (three indices each).
+
+/// Replacement policy of the simulated post-transform cache
+enum class VertexCacheModel {
+    FIFO, ///< fixed function style hardware: hits do not refresh an entry
+    LRU   ///< hits move the vertex to the front
+};
+
+/// Triangle reordering method
+enum class VertexCacheOptimizer {
+    None,
+    Forsyth, ///< Tom Forsyth's "Linear-speed vertex cache optimisation", tuned for LRU caches
+    Tipsify  ///< Sander et al. "Fast triangle reordering for vertex locality and reduced overdraw", for FIFO caches
+};
+
+/// Transformed vertices counted by a simulated cache
+struct VertexCacheStatistics {
+    size_t transformed = 0; ///< cache misses, i.e. vertex shader invocations
+    double acmr = 0;        ///< average cache miss ratio: misses per triangle (0.5 to 0.7 is very good, 3 is the worst)
+    double atvr = 0;        ///< average transformed vertex ratio: misses per referenced vertex (1 is optimal)
+};
+
+/// Simulate a post-transform cache of `cache_size` vertices over the triangles of `indices`
+HEADERONLY_INLINE VertexCacheStatistics analyze_vertex_cache(const std::vector<unsigned int> &indices, size_t n_vertices,
+                                                             int cache_size = 32, VertexCacheModel model = VertexCacheModel::FIFO);
+
+/// @brief Reorder the triangles of `indices` (vertex indices are kept)
+/// @param cache_size cache size Tipsify targets (Forsyth's scoring assumes 32 entries)
+HEADERONLY_INLINE void optimize_vertex_cache(std::vector<unsigned int> &indices, size_t n_vertices,
+                                             VertexCacheOptimizer optimizer = VertexCacheOptimizer::Forsyth, int cache_size = 16);
+
+/// @brief Renumber the vertices in order of first use by `indices` (unused vertices go last)
+/// @return the new order: vertex i is the old vertex `order[i]`, see `reorder_vertices`
+HEADERONLY_INLINE std::vector<unsigned int> optimize_vertex_fetch(std::vector<unsigned int> &indices, size_t n_vertices);
+
+/// Per vertex `data` in the `order` returned by `optimize_vertex_fetch`
+template <typename T>
+std::vector<T> reorder_vertices(const T *data, const std::vector<unsigned int> &order) {
+    std::vector<T> reordered;
+    reordered.reserve(order.size());
+    for (unsigned int v : order) reordered.push_back(data[v]);
+    return reordered;
+}
+
+//=============================================================================
+} // namespace OpenGP
+//=============================================================================
+
+#ifdef HEADERONLY
+    #include "vertex_cache.cpp"
+#endif
@@ -7,11 +7,16 @@
 #include <functional>
 #include <type_traits>
 
+#include <OpenGP/util/Range.h>
+
 
 //=============================================================================
 namespace OpenGP {
 //=============================================================================
 
+/// @brief Type erased iterable, every stage of which is a `std::function` call per element
+/// @deprecated Kept for compatibility, use the templated `Range` (`make_range`) instead;
+/// a `Range` converts to a `GenericIterable` of the same element type.
 template <typename T>
 class GenericIterable {
 public:
@@ -61,6 +66,9 @@ public:
         base_advancer = advancer;
     }
 
+    template <typename I>
+    GenericIterable(const Range<I> &range) : GenericIterable(adaptor(range)) {}
+
     Iterator begin() {
         return Iterator(base_advancer);
     }
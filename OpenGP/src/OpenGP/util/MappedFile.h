@@ -0,0 +1,105 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+#ifdef _WIN32
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+/// Read-only memory mapping of a whole file
+class MappedFile {
+private:
+
+    const uint8_t *ptr = nullptr;
+    size_t length = 0;
+
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+
+public:
+
+    MappedFile() {}
+    explicit MappedFile(const std::string &path) { open(path); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile &operator=(const MappedFile&) = delete;
+
+    ~MappedFile() { close(); }
+
+    /// Map `path`, returns false if it cannot be opened (empty files map to nothing and fail too)
+    bool open(const std::string &path) {
+
+        close();
+
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) { close(); return false; }
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) { close(); return false; }
+        ptr = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!ptr) { close(); return false; }
+        length = (size_t)file_size.QuadPart;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0) { ::close(fd); return false; }
+        void *address = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (address == MAP_FAILED) return false;
+        ptr = (const uint8_t*)address;
+        length = (size_t)info.st_size;
+        madvise(address, length, MADV_SEQUENTIAL);
+#endif
+
+        return true;
+
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (ptr) UnmapViewOfFile(ptr);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (ptr) munmap((void*)ptr, length);
+#endif
+        ptr = nullptr;
+        length = 0;
+    }
+
+    bool is_open() const { return ptr != nullptr; }
+
+    const uint8_t *data() const { return ptr; }
+    size_t size() const { return length; }
+
+};
+
+//=============================================================================
+} // OpenGP::
+//=============================================================================
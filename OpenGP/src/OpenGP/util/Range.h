@@ -0,0 +1,149 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+/// @file
+/// Lazy ranges over iterator pairs, composable like `GenericIterable` but without type
+/// erasure: the filter and map stages are template parameters, so iterating a composed
+/// range inlines into a plain loop, e.g.
+///
+///     for (auto &child : make_range(children).map([](TransformComponent *tc) { return tc; })) ...
+
+template <typename Iterator>
+class Range;
+
+/// Iterator over the elements of `Iterator` for which `Predicate` holds
+template <typename Iterator, typename Predicate>
+class FilterIterator {
+private:
+
+    Iterator it;
+    Iterator last;
+    Predicate predicate;
+
+    void skip() {
+        while (it != last && !predicate(*it)) ++it;
+    }
+
+public:
+
+    using iterator_category = std::forward_iterator_tag;
+    using reference = typename std::iterator_traits<Iterator>::reference;
+    using value_type = typename std::iterator_traits<Iterator>::value_type;
+    using pointer = typename std::iterator_traits<Iterator>::pointer;
+    using difference_type = std::ptrdiff_t;
+
+    FilterIterator(Iterator it, Iterator last, Predicate predicate) : it(it), last(last), predicate(predicate) {
+        skip();
+    }
+
+    reference operator*() const { return *it; }
+
+    FilterIterator &operator++() { ++it; skip(); return *this; }
+
+    bool operator==(const FilterIterator &rhs) const { return it == rhs.it; }
+    bool operator!=(const FilterIterator &rhs) const { return it != rhs.it; }
+
+};
+
+/// @brief Iterator over `*function(element)` for the elements of `Iterator`
+/// @note Like `GenericIterable::map`, the function returns a pointer
+template <typename Iterator, typename Function>
+class MapIterator {
+private:
+
+    Iterator it;
+    Function function;
+
+    using result_pointer = decltype(std::declval<const Function&>()(*std::declval<Iterator&>()));
+
+    static_assert(std::is_pointer<result_pointer>::value, "A map function must return a pointer");
+
+public:
+
+    using iterator_category = std::forward_iterator_tag;
+    using reference = typename std::remove_pointer<result_pointer>::type&;
+    using value_type = typename std::remove_cv<typename std::remove_pointer<result_pointer>::type>::type;
+    using pointer = result_pointer;
+    using difference_type = std::ptrdiff_t;
+
+    MapIterator(Iterator it, Function function) : it(it), function(function) {}
+
+    reference operator*() const { return *function(*it); }
+
+    MapIterator &operator++() { ++it; return *this; }
+
+    bool operator==(const MapIterator &rhs) const { return it == rhs.it; }
+    bool operator!=(const MapIterator &rhs) const { return it != rhs.it; }
+
+};
+
+/// A pair of iterators, which can be lazily filtered and mapped into a new range
+template <typename Iterator>
+class Range {
+private:
+
+    Iterator first;
+    Iterator last;
+
+public:
+
+    using iterator = Iterator;
+    using reference = typename std::iterator_traits<Iterator>::reference;
+
+    Range(Iterator first, Iterator last) : first(first), last(last) {}
+
+    Iterator begin() const { return first; }
+    Iterator end() const { return last; }
+
+    bool empty() const { return !(first != last); }
+
+    /// The elements for which `predicate(element)` holds
+    template <typename Predicate>
+    Range<FilterIterator<Iterator, Predicate>> filter(Predicate predicate) const {
+        using Filtered = FilterIterator<Iterator, Predicate>;
+        return Range<Filtered>(Filtered(first, last, predicate), Filtered(last, last, predicate));
+    }
+
+    /// `*function(element)` for every element, `function` returns a pointer
+    template <typename Function>
+    Range<MapIterator<Iterator, Function>> map(Function function) const {
+        using Mapped = MapIterator<Iterator, Function>;
+        return Range<Mapped>(Mapped(first, function), Mapped(last, function));
+    }
+
+};
+
+/// The range of all elements of `container`
+template <typename Container>
+auto make_range(Container &container) -> Range<decltype(container.begin())> {
+    return Range<decltype(container.begin())>(container.begin(), container.end());
+}
+
+template <typename Iterator>
+Range<Iterator> make_range(Iterator first, Iterator last) {
+    return Range<Iterator>(first, last);
+}
+
+/// Map function to the values of an associative container, e.g. `make_range(map).map(PairSecond())`
+struct PairSecond {
+    template <typename Pair>
+    auto operator()(Pair &pair) const -> decltype(&pair.second) {
+        return &pair.second;
+    }
+};
+
+//=============================================================================
+} // OpenGP::
+//=============================================================================
@@ -53,11 +53,13 @@ public:
 
     Mat4x4 get_transformation_matrix() const {
 
-        Mat4x4 t = get_translation_matrix();
-        Mat4x4 r = get_rotatation_matrix();
-        Mat4x4 s = get_scale_matrix();
+        /// @note Equal to translation * rotation * scale, composed without the 4x4 products
+        Mat4x4 m;
+        m.block<3, 3>(0, 0) = rotation.toRotationMatrix() * scale.asDiagonal();
+        m.block<3, 1>(0, 3) = position;
+        m.row(3) << 0, 0, 0, 1;
 
-        return t * r * s;
+        return m;
 
     }
 
@@ -0,0 +1,167 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+#include <OpenGP/util/parallel_for.h>
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+/// @brief Persistent worker threads with one task deque each
+/// @note A worker pushes the tasks it spawns to the back of its own deque and pops from the
+/// back (the most recent, still in cache), idle workers steal from the front of the others.
+/// The thread that owns the pool is not a worker, but helps through `run_one`.
+class WorkStealingPool {
+public:
+
+    using Task = std::function<void()>;
+
+private:
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+
+    std::atomic<int> pending;        ///< tasks submitted and not started
+    std::atomic<unsigned> next_queue; ///< round robin for tasks from outside threads
+    std::atomic<bool> stopping;
+
+    std::mutex sleep_mutex;
+    std::condition_variable sleep_condition;
+
+    /// Queue of the calling thread if it is one of our workers, -1 otherwise
+    int own_queue() const {
+        return (worker_pool() == this) ? worker_index() : -1;
+    }
+
+    static const WorkStealingPool *&worker_pool() {
+        static thread_local const WorkStealingPool *pool = nullptr;
+        return pool;
+    }
+
+    static int &worker_index() {
+        static thread_local int index = -1;
+        return index;
+    }
+
+    bool pop(int queue, Task &task, bool back) {
+        Queue &q = *queues[queue];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.tasks.empty()) return false;
+        if (back) {
+            task = std::move(q.tasks.back());
+            q.tasks.pop_back();
+        } else {
+            task = std::move(q.tasks.front());
+            q.tasks.pop_front();
+        }
+        pending--;
+        return true;
+    }
+
+    /// Own tasks first (newest first), then steal the oldest task of another queue
+    bool take(int own, Task &task) {
+        if (own >= 0 && pop(own, task, true)) return true;
+        const int n = (int)queues.size();
+        int start = (own >= 0) ? own + 1 : 0;
+        for (int i = 0;i < n;i++) {
+            int victim = (start + i) % n;
+            if (victim != own && pop(victim, task, false)) return true;
+        }
+        return false;
+    }
+
+    void work(int index) {
+        worker_pool() = this;
+        worker_index() = index;
+        Task task;
+        while (true) {
+            if (take(index, task)) {
+                task();
+                task = nullptr;
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+            sleep_condition.wait(lock, [this]() { return stopping || pending > 0; });
+            if (stopping && pending == 0) return;
+        }
+    }
+
+public:
+
+    /// @brief Start `n_threads - 1` workers (`n_threads` 0: one per hardware thread), the
+    /// owning thread being the last one
+    explicit WorkStealingPool(int n_threads = 0) : pending(0), next_queue(0), stopping(false) {
+        if (n_threads <= 0) n_threads = hardware_threads();
+        for (int i = 0;i < n_threads - 1;i++) queues.emplace_back(new Queue());
+        for (int i = 0;i < n_threads - 1;i++) workers.emplace_back([this, i]() { work(i); });
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool&) = delete;
+
+    /// Waits for the queued tasks
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+            stopping = true;
+        }
+        sleep_condition.notify_all();
+        for (auto &worker : workers) worker.join();
+    }
+
+    /// Threads running tasks, including the owning thread
+    int size() const {
+        return (int)workers.size() + 1;
+    }
+
+    /// Queue `task`, which may run on any worker, or on the owning thread in `run_one`
+    void submit(Task task) {
+        if (workers.empty()) {
+            task();
+            return;
+        }
+        int queue = own_queue();
+        if (queue < 0) queue = (int)(next_queue++ % queues.size());
+        {
+            std::lock_guard<std::mutex> lock(queues[queue]->mutex);
+            queues[queue]->tasks.push_back(std::move(task));
+            pending++;
+        }
+        {
+            // taking the lock orders the wake up after a sleeping worker checked `pending`
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+        }
+        sleep_condition.notify_one();
+    }
+
+    /// Run one queued task on the calling thread, false if there was none
+    bool run_one() {
+        Task task;
+        if (!take(own_queue(), task)) return false;
+        task();
+        return true;
+    }
+
+};
+
+//=============================================================================
+} // OpenGP::
+//=============================================================================
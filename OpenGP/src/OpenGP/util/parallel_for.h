@@ -0,0 +1,94 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+/// Number of worker threads used when a thread count of 0 is requested
+inline int hardware_threads() {
+    unsigned int n = std::thread::hardware_concurrency();
+    return n > 0 ? (int)n : 1;
+}
+
+/// @brief Call `f(i)` for every `i` in [`begin`, `end`) on up to `n_threads` threads
+/// @note Indices are handed out dynamically in chunks of `grain`, so iterations may
+/// have uneven cost. With `n_threads == 1` everything runs on the calling thread.
+template <typename Function>
+void parallel_for(int begin, int end, const Function &f, int grain = 1, int n_threads = 0) {
+
+    if (end <= begin) return;
+    if (n_threads <= 0) n_threads = hardware_threads();
+    grain = std::max(grain, 1);
+
+    int n_chunks = (end - begin + grain - 1) / grain;
+    n_threads = std::min(n_threads, n_chunks);
+
+    if (n_threads <= 1) {
+        for (int i = begin;i < end;i++) f(i);
+        return;
+    }
+
+    std::atomic<int> next(begin);
+
+    auto worker = [&]() {
+        while (true) {
+            int chunk_begin = next.fetch_add(grain);
+            if (chunk_begin >= end) break;
+            int chunk_end = std::min(chunk_begin + grain, end);
+            for (int i = chunk_begin;i < chunk_end;i++) f(i);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(n_threads - 1);
+    for (int t = 1;t < n_threads;t++) threads.emplace_back(worker);
+    worker();
+    for (auto &thread : threads) thread.join();
+
+}
+
+/// @brief Split [`begin`, `end`) into one contiguous range per thread and call
+/// `f(thread_index, range_begin, range_end)` for each
+/// @note Meant for reductions: `f` can accumulate into a per-thread slot indexed
+/// by `thread_index`. Returns the number of ranges actually used.
+template <typename Function>
+int parallel_ranges(int begin, int end, const Function &f, int n_threads = 0) {
+
+    if (end <= begin) return 0;
+    if (n_threads <= 0) n_threads = hardware_threads();
+    n_threads = std::min(n_threads, end - begin);
+
+    if (n_threads <= 1) {
+        f(0, begin, end);
+        return 1;
+    }
+
+    int count = end - begin;
+
+    std::vector<std::thread> threads;
+    threads.reserve(n_threads - 1);
+    for (int t = 1;t < n_threads;t++) {
+        int range_begin = begin + (int)((long long)count * t / n_threads);
+        int range_end = begin + (int)((long long)count * (t + 1) / n_threads);
+        threads.emplace_back([&f, t, range_begin, range_end]() { f(t, range_begin, range_end); });
+    }
+    f(0, begin, begin + count / n_threads);
+    for (auto &thread : threads) thread.join();
+
+    return n_threads;
+
+}
+
+//=============================================================================
+} // OpenGP::
+//=============================================================================